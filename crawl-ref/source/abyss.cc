@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <map>
 #include <queue>
 
 #include "act-iter.h"
@@ -71,6 +72,35 @@ static ProceduralLayout *abyssLayout = nullptr, *levelLayout = nullptr;
 typedef priority_queue<ProceduralSample, vector<ProceduralSample>, ProceduralSamplePQCompare> sample_queue;
 
 static sample_queue abyss_sample_queue;
+
+// Layout samples depend only on the absolute position and the abyss depth,
+// and each one says up to which depth its feature holds (its changepoint).
+// Morphing and area shifts revisit the same cells over and over, so keep the
+// last sample for each cell, in tiles keyed by absolute position, and only
+// run the layouts again for cells which are new or past their changepoint.
+#define ABYSS_SAMPLE_TILE_BITS 4
+#define ABYSS_SAMPLE_TILE (1 << ABYSS_SAMPLE_TILE_BITS)
+
+struct abyss_cached_sample
+{
+    abyss_cached_sample() : feat(DNGN_UNSEEN), from(0), changepoint(0),
+                            mask(MMT_NONE)
+    {
+    }
+
+    dungeon_feature_type feat;  // DNGN_UNSEEN if nothing is cached
+    uint32_t from;              // the depth it was sampled at
+    uint32_t changepoint;
+    map_mask_type mask;
+};
+
+typedef FixedArray<abyss_cached_sample, ABYSS_SAMPLE_TILE, ABYSS_SAMPLE_TILE>
+    abyss_sample_tile;
+static map<coord_def, abyss_sample_tile> abyss_sample_cache;
+
+// Cells whose terrain morphing or shifting has changed since the last LOS
+// update; see _abyss_terrain_changed().
+static int abyss_terrain_changes = 0;
 static vector<dungeon_feature_type> abyssal_features;
 static list<monster*> displaced_monsters;
 
@@ -1176,17 +1206,36 @@ const static RiverLayout rivers(1800, baseLayout);
 // This one is not fixed: [0] is a level pulled from the current game
 static vector<const ProceduralLayout*> complex_vec(2);
 
-static ProceduralSample _abyss_grid(const coord_def &p)
+static abyss_cached_sample &_abyss_cached_sample(const coord_def &pt)
 {
-    const coord_def pt = p + abyssal_state.major_coord;
+    const coord_def tile(pt.x >> ABYSS_SAMPLE_TILE_BITS,
+                         pt.y >> ABYSS_SAMPLE_TILE_BITS);
+    return abyss_sample_cache[tile][pt.x & (ABYSS_SAMPLE_TILE - 1)]
+                                   [pt.y & (ABYSS_SAMPLE_TILE - 1)];
+}
 
-    if (_in_wastes(pt))
+// Forget cached samples for tiles which no longer overlap the level.
+static void _prune_abyss_sample_cache()
+{
+    const coord_def lo(abyssal_state.major_coord.x >> ABYSS_SAMPLE_TILE_BITS,
+                       abyssal_state.major_coord.y >> ABYSS_SAMPLE_TILE_BITS);
+    const coord_def hi((abyssal_state.major_coord.x + GXM - 1)
+                           >> ABYSS_SAMPLE_TILE_BITS,
+                       (abyssal_state.major_coord.y + GYM - 1)
+                           >> ABYSS_SAMPLE_TILE_BITS);
+
+    for (auto it = abyss_sample_cache.begin(); it != abyss_sample_cache.end();)
     {
-        ProceduralSample sample = wastes(pt, abyssal_state.depth);
-        abyss_sample_queue.push(sample);
-        return sample;
+        const coord_def &tile = it->first;
+        if (tile.x < lo.x || tile.x > hi.x || tile.y < lo.y || tile.y > hi.y)
+            it = abyss_sample_cache.erase(it);
+        else
+            ++it;
     }
+}
 
+static void _init_abyss_layout()
+{
     if (abyssLayout == nullptr)
     {
         const level_id lid = _get_random_level();
@@ -1200,14 +1249,95 @@ static ProceduralSample _abyss_grid(const coord_def &p)
             vault_list.push_back("base: " + lid.describe(false));
         }
     }
+}
+
+// Sample the n cells eastwards from pt, a run at a time for each side of the
+// wastes' edge.
+static void _abyss_layout_row(const coord_def &pt, int n,
+                              vector<ProceduralSample> &out)
+{
+    for (int start = 0, end; start < n; start = end)
+    {
+        const bool in_wastes = _in_wastes(coord_def(pt.x + start, pt.y));
+        for (end = start + 1; end < n; ++end)
+            if (_in_wastes(coord_def(pt.x + end, pt.y)) != in_wastes)
+                break;
+
+        if (!in_wastes)
+            _init_abyss_layout();
+        const ProceduralLayout &layout = in_wastes
+            ? static_cast<const ProceduralLayout &>(wastes) : *abyssLayout;
+        layout.row(coord_def(pt.x + start, pt.y), end - start,
+                   abyssal_state.depth, out);
+    }
+}
 
-    const ProceduralSample sample = (*abyssLayout)(pt, abyssal_state.depth);
-    ASSERT(sample.feat() > DNGN_UNSEEN);
+static bool _abyss_sample_stale(const abyss_cached_sample &cached)
+{
+    const uint32_t depth = abyssal_state.depth;
+    return cached.feat == DNGN_UNSEEN
+           || depth < cached.from || depth >= cached.changepoint;
+}
 
+static ProceduralSample _abyss_grid(const coord_def &p)
+{
+    const coord_def pt = p + abyssal_state.major_coord;
+
+    abyss_cached_sample &cached = _abyss_cached_sample(pt);
+    if (_abyss_sample_stale(cached))
+    {
+        // Fill in the stale cells from here to the end of this row of the
+        // tile together: on a new area that's the whole row, which is
+        // what's asked for next.
+        int n = 1;
+        while ((pt.x + n) & (ABYSS_SAMPLE_TILE - 1)
+               && _abyss_sample_stale(
+                      _abyss_cached_sample(coord_def(pt.x + n, pt.y))))
+        {
+            ++n;
+        }
+
+        vector<ProceduralSample> samples;
+        samples.reserve(n);
+        _abyss_layout_row(pt, n, samples);
+        ASSERT((int)samples.size() == n);
+        for (int i = 0; i < n; ++i)
+        {
+            const ProceduralSample &sample = samples[i];
+            ASSERT(sample.feat() > DNGN_UNSEEN);
+            abyss_cached_sample &fill =
+                _abyss_cached_sample(coord_def(pt.x + i, pt.y));
+            fill.feat = sample.feat();
+            fill.from = abyssal_state.depth;
+            fill.changepoint = sample.changepoint();
+            fill.mask = sample.mask();
+        }
+    }
+
+    const ProceduralSample sample(pt, cached.feat, cached.changepoint,
+                                  cached.mask);
     abyss_sample_queue.push(sample);
     return sample;
 }
 
+static void _abyss_terrain_changed()
+{
+    ++abyss_terrain_changes;
+}
+
+// Tell LOS about all the terrain changes since the last call at once,
+// rather than cell by cell as they happen. Returns whether there were any.
+static bool _abyss_flush_terrain_changes()
+{
+    if (!abyss_terrain_changes)
+        return false;
+
+    dprf(DIAG_ABYSS, "%d terrain changes", abyss_terrain_changes);
+    abyss_terrain_changes = 0;
+    los_changed();
+    return true;
+}
+
 static cloud_type _cloud_from_feat(const dungeon_feature_type &ft)
 {
     switch (ft)
@@ -1318,6 +1448,7 @@ static void _update_abyss_terrain(const coord_def &p,
     if (feat != currfeat)
     {
         env.grid(rp) = feat;
+        _abyss_terrain_changed();
         if (feat == DNGN_FLOOR && in_los_bounds_g(rp))
         {
             cloud_type cloud = _cloud_from_feat(currfeat);
@@ -1518,6 +1649,7 @@ static void _initialize_abyss_state()
     abyssal_state.destroy_all_terrain = false;
     abyssal_state.level = _get_random_level();
     abyss_sample_queue = sample_queue(ProceduralSamplePQCompare());
+    abyss_sample_cache.clear();
 }
 
 void set_abyss_state(coord_def coord, uint32_t depth)
@@ -1528,6 +1660,7 @@ void set_abyss_state(coord_def coord, uint32_t depth)
     abyssal_state.phase = 0.0;
     abyssal_state.destroy_all_terrain = true;
     abyss_sample_queue = sample_queue(ProceduralSamplePQCompare());
+    abyss_sample_cache.clear();
     you.moveto(ABYSS_CENTRE);
     map_bitmask abyss_genlevel_mask(true);
     _abyss_apply_terrain(abyss_genlevel_mask, true, true);
@@ -1552,10 +1685,12 @@ static void abyss_area_shift()
             _abyss_shift_level_contents_around_player(
                 ABYSS_AREA_SHIFT_RADIUS, ABYSS_CENTRE, abyss_genlevel_mask);
             _generate_area(abyss_genlevel_mask);
+            _prune_abyss_sample_cache();
         }
         forget_map(true);
 
         // Update LOS at player's new abyssal vacation retreat.
+        abyss_terrain_changes = 0;
         los_changed();
     }
 
@@ -1591,6 +1726,7 @@ void destroy_abyss()
         delete levelLayout;
         levelLayout = nullptr;
     }
+    abyss_sample_cache.clear();
 }
 
 static colour_t _roll_abyss_floor_colour()
@@ -1733,7 +1869,7 @@ void abyss_morph()
     _place_displaced_monsters();
     _push_items();
     // TODO: does gozag gold detection need to be here too?
-    los_changed();
+    _abyss_flush_terrain_changes();
 }
 
 // Force the player one level deeper in the abyss during an abyss teleport with
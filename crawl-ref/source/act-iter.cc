@@ -5,15 +5,39 @@
 #include "env.h"
 #include "losglobal.h"
 
+// The highest index in env.mons an iterator made now should look at.
+static int _last_mon_slot()
+{
+    return env.active_mons.empty() ? -1 : env.active_mons.back();
+}
+
+// The next index after i in env.active_mons, or max + 1 if there are no more
+// up to max. slot is where i was found in the list, but monsters placed while
+// iterating can shift it, so it's only a hint.
+static int _next_mon_slot(int i, int &slot, int max)
+{
+    const vector<int> &slots = env.active_mons;
+    if (slot >= 0 && slot < (int)slots.size() && slots[slot] == i)
+        ++slot;
+    else
+        slot = upper_bound(slots.begin(), slots.end(), i) - slots.begin();
+
+    if (slot < (int)slots.size() && slots[slot] <= max)
+        return slots[slot];
+    return max + 1;
+}
+
 actor_near_iterator::actor_near_iterator(coord_def c, los_type los)
-    : center(c), _los(los), viewer(nullptr), i(-1), max(env.max_mon_index)
+    : center(c), _los(los), viewer(nullptr), i(-1), slot(-1),
+      max(_last_mon_slot())
 {
     if (!valid(&you))
         advance();
 }
 
 actor_near_iterator::actor_near_iterator(const actor* a, los_type los)
-    : center(a->pos()), _los(los), viewer(a), i(-1), max(env.max_mon_index)
+    : center(a->pos()), _los(los), viewer(a), i(-1), slot(-1),
+      max(_last_mon_slot())
 {
     if (!valid(&you))
         advance();
@@ -64,7 +88,7 @@ bool actor_near_iterator::valid(const actor* a) const
 void actor_near_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_mon_slot(i, slot, max)) > max)
              return;
     while (!valid(**this));
 }
@@ -72,18 +96,18 @@ void actor_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_near_iterator::monster_near_iterator(coord_def c, los_type los)
-    : center(c), _los(los), viewer(nullptr), i(0), max(env.max_mon_index)
+    : center(c), _los(los), viewer(nullptr), i(-1), slot(-1),
+      max(_last_mon_slot())
 {
-    if (!valid(&env.mons[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
 monster_near_iterator::monster_near_iterator(const actor *a, los_type los)
-    : center(a->pos()), _los(los), viewer(a), i(0), max(env.max_mon_index)
+    : center(a->pos()), _los(los), viewer(a), i(-1), slot(-1),
+      max(_last_mon_slot())
 {
-    if (!valid(&env.mons[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
@@ -154,7 +178,7 @@ bool monster_near_iterator::valid(const monster* a) const
 void monster_near_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_mon_slot(i, slot, max)) > max)
              return;
     while (!valid(**this));
 }
@@ -162,10 +186,9 @@ void monster_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_iterator::monster_iterator()
-    : i(0), max(env.max_mon_index)
+    : i(-1), slot(-1), max(_last_mon_slot())
 {
-    while (i <= max && !env.mons[i].alive())
-        i++;
+    advance();
 }
 
 monster_iterator::operator bool() const
@@ -202,7 +225,7 @@ monster_iterator monster_iterator::operator++(int)
 void monster_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_mon_slot(i, slot, max)) > max)
              return;
     while (!(*this)->alive());
 }
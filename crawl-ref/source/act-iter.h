@@ -24,6 +24,7 @@ protected:
     los_type _los;
     const actor* viewer;
     int i;
+    int slot;
     const int max;
 
     bool valid(const actor* a) const;
@@ -51,6 +52,7 @@ protected:
     los_type _los;
     const actor* viewer;
     int i;
+    int slot;
     const int max;
     int begin_point;
 
@@ -71,6 +73,7 @@ public:
 
 protected:
     int i;
+    int slot;
     const int max;
     void advance();
 };
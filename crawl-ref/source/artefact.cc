@@ -1263,14 +1263,14 @@ static void _get_randart_properties(const item_def &item,
 void setup_unrandart(item_def &item, bool creating)
 {
     ASSERT(is_unrandom_artefact(item));
-    CrawlVector &rap = item.props[ARTEFACT_PROPS_KEY].get_vector();
     const unrandart_entry *unrand = _seekunrandart(item);
 
     if (unrand->prpty[ARTP_NO_UPGRADE] && !creating)
         return; // don't mangle mutable items
 
     for (int i = 0; i < ART_PROPERTIES; i++)
-        rap[i] = static_cast<short>(unrand->prpty[i]);
+        item.artprops[i] = static_cast<short>(unrand->prpty[i]);
+    item.has_artprops = true;
 
     item.base_type = unrand->base_type;
     item.sub_type  = unrand->sub_type;
@@ -1287,10 +1287,6 @@ static bool _init_artefact_properties(item_def &item)
         return true;
     }
 
-    CrawlVector &rap = item.props[ARTEFACT_PROPS_KEY].get_vector();
-    for (vec_size i = 0; i < ART_PROPERTIES; i++)
-        rap[i] = static_cast<short>(0);
-
     ASSERT(item.base_type != OBJ_BOOKS);
 
     artefact_properties_t prop;
@@ -1298,7 +1294,8 @@ static bool _init_artefact_properties(item_def &item)
     _get_randart_properties(item, prop);
 
     for (int i = 0; i < ART_PROPERTIES; i++)
-        rap[i] = static_cast<short>(prop[i]);
+        item.artprops[i] = static_cast<short>(prop[i]);
+    item.has_artprops = true;
 
     return true;
 }
@@ -1308,18 +1305,12 @@ void artefact_properties(const item_def &item,
 {
     ASSERT(is_artefact(item));
     ASSERT(item.base_type != OBJ_BOOKS);
-    ASSERT(item.props.exists(ARTEFACT_PROPS_KEY) || is_unrandom_artefact(item));
+    ASSERT(item.has_artprops || is_unrandom_artefact(item));
 
-    if (item.props.exists(ARTEFACT_PROPS_KEY))
+    if (item.has_artprops)
     {
-        const CrawlVector &rap_vec =
-            item.props[ARTEFACT_PROPS_KEY].get_vector();
-        ASSERT(rap_vec.get_type()     == SV_SHORT);
-        ASSERT(rap_vec.size()         == ART_PROPERTIES);
-        ASSERT(rap_vec.get_max_size() == ART_PROPERTIES);
-
-        for (vec_size i = 0; i < ART_PROPERTIES; i++)
-            proprt[i] = rap_vec[i].get_short();
+        for (int i = 0; i < ART_PROPERTIES; i++)
+            proprt[i] = item.artprops[i];
     }
     else // if (is_unrandom_artefact(item))
     {
@@ -1334,13 +1325,9 @@ int artefact_property(const item_def &item, artefact_prop_type prop)
 {
     ASSERT(is_artefact(item));
     ASSERT(item.base_type != OBJ_BOOKS);
-    ASSERT(item.props.exists(ARTEFACT_PROPS_KEY) || is_unrandom_artefact(item));
-    if (item.props.exists(ARTEFACT_PROPS_KEY))
-    {
-        const CrawlVector &rap_vec =
-            item.props[ARTEFACT_PROPS_KEY].get_vector();
-        return rap_vec[prop].get_short();
-    }
+    ASSERT(item.has_artprops || is_unrandom_artefact(item));
+    if (item.has_artprops)
+        return item.artprops[prop];
     else // if (is_unrandom_artefact(item))
     {
         const unrandart_entry *unrand = _seekunrandart(item);
@@ -1788,15 +1775,8 @@ bool randart_is_bad(const item_def &item)
 
 static void _artefact_setup_prop_vectors(item_def &item)
 {
-    CrawlHashTable &props = item.props;
-    if (!props.exists(ARTEFACT_PROPS_KEY))
-        props[ARTEFACT_PROPS_KEY].new_vector(SV_SHORT).resize(ART_PROPERTIES);
-
-    CrawlVector &rap = props[ARTEFACT_PROPS_KEY].get_vector();
-    rap.set_max_size(ART_PROPERTIES);
-
-    for (vec_size i = 0; i < ART_PROPERTIES; i++)
-        rap[i].get_short() = 0;
+    item.artprops.init(0);
+    item.has_artprops = true;
 }
 
 // If ignore_mundane is true, normally mundane items are forced to
@@ -1840,7 +1820,7 @@ bool make_item_randart(item_def &item, bool ignore_mundane)
         {
             // Something went wrong that no amount of rerolling will fix.
             item.unrand_idx = 0;
-            item.props.erase(ARTEFACT_PROPS_KEY);
+            item.has_artprops = false;
             item.flags &= ~ISFLAG_RANDART;
             return false;
         }
@@ -2085,6 +2065,8 @@ static void _make_faerie_armour(item_def &item)
         = item.props[ARTEFACT_APPEAR_KEY].get_string();
     doodad.props.erase(ARTEFACT_NAME_KEY);
     item.props = doodad.props;
+    item.artprops = doodad.artprops;
+    item.has_artprops = doodad.has_artprops;
 
     // Make the scales always stand out.
     artefact_set_property(item, ARTP_ENHANCE_HEXES, 1);
@@ -2183,36 +2165,26 @@ void unrand_death_effects(monster* mons, killer_type killer)
 void artefact_set_property(item_def &item, artefact_prop_type prop, int val)
 {
     ASSERT(is_artefact(item));
-    ASSERT(item.props.exists(ARTEFACT_PROPS_KEY));
+    ASSERT(item.has_artprops);
 
-    CrawlVector &rap_vec = item.props[ARTEFACT_PROPS_KEY].get_vector();
-    ASSERT(rap_vec.get_type()     == SV_SHORT);
-    ASSERT(rap_vec.size()         == ART_PROPERTIES);
-    ASSERT(rap_vec.get_max_size() == ART_PROPERTIES);
-
-    rap_vec[prop].get_short() = val;
-}
-
-template<typename Z>
-static inline void artefact_pad_store_vector(CrawlVector &vec, Z value)
-{
-    if (vec.get_max_size() < ART_PROPERTIES)
-    {
-        // Authentic tribal dance to propitiate the asserts in store.cc:
-        const int old_size = vec.get_max_size();
-        vec.set_max_size(VEC_MAX_SIZE);
-        vec.resize(ART_PROPERTIES);
-        vec.set_max_size(ART_PROPERTIES);
-        for (int i = old_size; i < ART_PROPERTIES; ++i)
-            vec[i] = value;
-    }
+    item.artprops[prop] = val;
 }
 
+// Saves keep artefact properties as a vector in props, as they were once
+// kept in memory too; move them onto the item itself after loading, padding
+// out any properties added since the save was made.
 void artefact_fixup_props(item_def &item)
 {
     CrawlHashTable &props = item.props;
     if (props.exists(ARTEFACT_PROPS_KEY))
-        artefact_pad_store_vector(props[ARTEFACT_PROPS_KEY], short(0));
+    {
+        const CrawlVector &rap = props[ARTEFACT_PROPS_KEY].get_vector();
+        item.artprops.init(0);
+        for (vec_size i = 0; i < rap.size() && i < ART_PROPERTIES; i++)
+            item.artprops[i] = rap[i].get_short();
+        item.has_artprops = true;
+        props.erase(ARTEFACT_PROPS_KEY);
+    }
 
     // As of 0.30, it seems like there is some rare circumstance that can
     // cause a Hepliaklqana ancestor's weapon to become a half-baked artefact -
@@ -2222,8 +2194,22 @@ void artefact_fixup_props(item_def &item)
     // https://crawl.develz.org/mantis/view.php?id=11756 - see also abyss.cc.
     if (item.base_type == OBJ_WEAPONS
         && (item.flags & (ISFLAG_SUMMONED | ISFLAG_RANDART))
-        && !item.props.exists(ARTEFACT_PROPS_KEY))
+        && !item.has_artprops)
     {
         item.flags &= ~ISFLAG_RANDART;
     }
 }
+
+// The reverse of the above, for saving: store the item's artefact properties
+// into props (usually a copy of the item's own) in the saved form.
+void artefact_save_props(const item_def &item, CrawlHashTable &props)
+{
+    ASSERT(item.has_artprops);
+
+    CrawlVector &rap = props[ARTEFACT_PROPS_KEY].new_vector(SV_SHORT);
+    rap.resize(ART_PROPERTIES);
+    rap.set_max_size(ART_PROPERTIES);
+
+    for (vec_size i = 0; i < ART_PROPERTIES; i++)
+        rap[i].get_short() = item.artprops[i];
+}
@@ -30,6 +30,7 @@
 
 struct bolt;
 struct item_def;
+class CrawlHashTable;
 class actor;
 class CrawlVector;
 class monster;
@@ -90,6 +91,7 @@ bool is_unrandom_artefact(const item_def &item, int which = 0);
 bool is_special_unrandom_artefact(const item_def &item);
 
 void artefact_fixup_props(item_def &item);
+void artefact_save_props(const item_def &item, CrawlHashTable &props);
 
 unique_item_status_type get_unique_item_status(int unrand_index);
 void set_unique_item_status(const item_def& item,
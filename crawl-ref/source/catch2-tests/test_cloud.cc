@@ -0,0 +1,174 @@
+#include <random>
+
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "cloud.h"
+#include "env.h"
+#include "tags.h"
+#include "unwind.h"
+
+static cloud_struct _cloud(coord_def pos, cloud_type type, int decay)
+{
+    cloud_struct cloud;
+    cloud.pos = pos;
+    cloud.type = type;
+    cloud.decay = decay;
+    cloud.source = decay * 3;
+    return cloud;
+}
+
+// The store has to agree with a map of the same clouds: the same clouds at
+// the same places, listed in the map's order.
+static void _require_matches(cloud_store &store,
+                             const map<coord_def, cloud_struct> &expected)
+{
+    REQUIRE(store.size() == (int)expected.size());
+
+    vector<coord_def> map_order;
+    for (const auto &entry : expected)
+    {
+        map_order.push_back(entry.first);
+        const cloud_struct *cloud = store.find(entry.first);
+        REQUIRE(cloud);
+        REQUIRE(cloud->pos == entry.first);
+        REQUIRE(cloud->type == entry.second.type);
+        REQUIRE(cloud->decay == entry.second.decay);
+        REQUIRE(cloud->source == entry.second.source);
+    }
+    REQUIRE(store.positions() == map_order);
+}
+
+TEST_CASE( "cloud_store keeps clouds in map order", "[single-file]" ) {
+
+    mt19937 gen(1234);
+    auto random_pos = [&]()
+    {
+        return coord_def(X_BOUND_1 + gen() % (X_BOUND_2 - X_BOUND_1 + 1),
+                         Y_BOUND_1 + gen() % (Y_BOUND_2 - Y_BOUND_1 + 1));
+    };
+
+    cloud_store store;
+    map<coord_def, cloud_struct> expected;
+
+    for (int i = 0; i < 3000; ++i)
+    {
+        const int op = gen() % 4;
+        if (op < 2 || expected.empty())
+        {
+            // Place, possibly over another cloud.
+            const cloud_struct cloud = _cloud(random_pos(),
+                                              gen() % 2 ? CLOUD_FIRE
+                                                        : CLOUD_COLD,
+                                              gen() % 100);
+            store.set(cloud);
+            expected[cloud.pos] = cloud;
+        }
+        else
+        {
+            auto it = expected.begin();
+            advance(it, gen() % expected.size());
+            cloud_struct cloud = it->second;
+            expected.erase(it);
+            store.erase(cloud.pos);
+
+            if (op == 2)
+            {
+                // Move, as move_cloud() does.
+                cloud.pos = random_pos();
+                store.set(cloud);
+                expected[cloud.pos] = cloud;
+            }
+        }
+
+        if (i % 50 == 0)
+            _require_matches(store, expected);
+    }
+    _require_matches(store, expected);
+
+    SECTION ("a cloud stays put while others come and go") {
+        const coord_def pos = expected.begin()->first;
+        const cloud_struct *cloud = store.find(pos);
+        for (int i = 0; i < 200; ++i)
+        {
+            const coord_def p = random_pos();
+            if (expected.count(p))
+                continue;
+            store.set(_cloud(p, CLOUD_FIRE, i));
+            if (i % 3)
+                store.erase(p);
+            else
+                expected[p] = _cloud(p, CLOUD_FIRE, i);
+        }
+        REQUIRE(store.find(pos) == cloud);
+        REQUIRE(cloud->pos == pos);
+        _require_matches(store, expected);
+    }
+
+    SECTION ("erasing nothing changes nothing") {
+        store.erase(coord_def(-1, -1));
+        for (int x = X_BOUND_1; x <= X_BOUND_2; ++x)
+            if (!expected.count(coord_def(x, Y_BOUND_1)))
+                store.erase(coord_def(x, Y_BOUND_1));
+        _require_matches(store, expected);
+    }
+
+    SECTION ("clearing empties the store") {
+        store.clear();
+        REQUIRE(store.size() == 0);
+        REQUIRE(store.positions().empty());
+        REQUIRE_FALSE(store.find(expected.begin()->first));
+    }
+}
+
+TEST_CASE( "Clouds survive a save round trip", "[single-file]" ) {
+
+    // Loading drops clouds inside walls.
+    unwind_var<feature_grid> saved_grid(env.grid);
+    env.grid.init(DNGN_FLOOR);
+
+    cloud_store store;
+    map<coord_def, cloud_struct> expected;
+    for (int i = 0; i < 40; ++i)
+    {
+        const coord_def pos(X_BOUND_1 + (i * 37) % (X_BOUND_2 - X_BOUND_1),
+                            Y_BOUND_1 + (i * 11) % (Y_BOUND_2 - Y_BOUND_1));
+        cloud_struct cloud = _cloud(pos, i % 3 ? CLOUD_POISON : CLOUD_FIRE,
+                                    i * 5);
+        cloud.spread_rate = i;
+        cloud.excl_rad = i % 4 - 1;
+        store.set(cloud);
+        expected[pos] = cloud;
+    }
+    // Leave a gap in the store's slots.
+    store.erase(expected.begin()->first);
+    expected.erase(expected.begin());
+
+    vector<unsigned char> buf;
+    writer w(&buf);
+    marshall_clouds(w, store);
+
+    cloud_store loaded;
+    loaded.set(_cloud(coord_def(X_BOUND_1, Y_BOUND_1), CLOUD_COLD, 1));
+    reader r(buf);
+    r.setMinorVersion(TAG_MINOR_VERSION);
+    unmarshall_clouds(r, loaded);
+    REQUIRE(r.valid() == false);
+
+    _require_matches(loaded, expected);
+    for (const auto &entry : expected)
+    {
+        const cloud_struct &cloud = *loaded.find(entry.first);
+        REQUIRE(cloud.spread_rate == entry.second.spread_rate);
+        REQUIRE(cloud.whose == entry.second.whose);
+        REQUIRE(cloud.killer == entry.second.killer);
+        REQUIRE(cloud.excl_rad == entry.second.excl_rad);
+    }
+
+    // And saving again gives the same bytes.
+    vector<unsigned char> again;
+    writer w2(&again);
+    marshall_clouds(w2, loaded);
+    REQUIRE(again == buf);
+}
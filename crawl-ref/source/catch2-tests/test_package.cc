@@ -0,0 +1,82 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include <cstdio>
+
+#include "errors.h"
+#include "package.h"
+#include "tags.h"
+
+// Run with both save backends: `make catch2-tests` and
+// `make catch2-tests SAVE_LOG=1`.
+TEST_CASE( "Save chunks survive a round trip through a package",
+           "[single-file]" ) {
+
+    const string filename = "catch2-test-package.cs";
+    vector<unsigned char> blob(300);
+    for (size_t i = 0; i < blob.size(); ++i)
+        blob[i] = i * 7;
+
+    {
+        package save(filename.c_str(), true, true);
+        {
+            writer w(&save, "test");
+            marshallInt(w, 123456789);
+            marshallString(w, "round trip");
+            w.write(blob.data(), blob.size());
+        }
+        {
+            writer w(&save, "empty");
+        }
+        save.commit();
+    }
+
+    SECTION ("chunks read back unchanged and end where they should") {
+        package save(filename.c_str(), false);
+        {
+            reader r(&save, "test");
+            REQUIRE(unmarshallInt(r) == 123456789);
+            REQUIRE(unmarshallString(r) == "round trip");
+
+            vector<unsigned char> read_blob(blob.size());
+            r.read(read_blob.data(), read_blob.size());
+            REQUIRE(read_blob == blob);
+
+            REQUIRE(r.valid() == false);
+            REQUIRE_NOTHROW(r.fail_if_not_eof("test"));
+        }
+        {
+            reader r(&save, "empty");
+            REQUIRE_NOTHROW(r.fail_if_not_eof("empty"));
+        }
+    }
+
+    SECTION ("leftover data is an incomplete read") {
+        package save(filename.c_str(), false);
+        reader r(&save, "test");
+        REQUIRE(unmarshallInt(r) == 123456789);
+        REQUIRE_THROWS_AS(r.fail_if_not_eof("test"), ext_fail_exception);
+    }
+
+    remove(filename.c_str());
+}
+
+TEST_CASE( "Readers detect the end of in-memory data", "[single-file]" ) {
+
+    SECTION ("vector buffers") {
+        vector<unsigned char> input = { 0x01, 0x02 };
+        reader r(input);
+        REQUIRE_THROWS_AS(r.fail_if_not_eof("buffer"), ext_fail_exception);
+        r.read(nullptr, 2);
+        REQUIRE_NOTHROW(r.fail_if_not_eof("buffer"));
+    }
+
+    SECTION ("data read in place") {
+        const char input[] = { 0x01, 0x02 };
+        reader r(input, sizeof(input));
+        REQUIRE_THROWS_AS(r.fail_if_not_eof("buffer"), ext_fail_exception);
+        r.read(nullptr, 2);
+        REQUIRE_NOTHROW(r.fail_if_not_eof("buffer"));
+    }
+}
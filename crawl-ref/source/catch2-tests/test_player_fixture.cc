@@ -63,5 +63,6 @@ void destroy_items_in_player_inventory(){
         you.inv[i].quantity = 0;
         you.inv[i].pos.reset();
         you.inv[i].props.clear();
+        you.inv[i].has_artprops = false;
     }
 }
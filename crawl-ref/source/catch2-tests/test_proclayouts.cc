@@ -0,0 +1,87 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "dgn-proclayouts.h"
+
+static void _require_same_sample(const ProceduralSample &a,
+                                 const ProceduralSample &b)
+{
+    REQUIRE(a.coord() == b.coord());
+    REQUIRE(a.feat() == b.feat());
+    REQUIRE(a.changepoint() == b.changepoint());
+    REQUIRE(a.mask() == b.mask());
+}
+
+// row() has to give exactly what operator() gives cell by cell, however the
+// row is split up and handed on.
+static void _require_rows_match(const ProceduralLayout &layout)
+{
+    for (uint32_t depth : { 0u, 1234u, 987654u })
+        for (int y = -40; y < 40; y += 7)
+        {
+            const coord_def start(-50 + y, y);
+            const int n = 100;
+            vector<ProceduralSample> row;
+            layout.row(start, n, depth, row);
+            REQUIRE(row.size() == (size_t)n);
+            for (int i = 0; i < n; ++i)
+            {
+                const coord_def p(start.x + i, start.y);
+                _require_same_sample(row[i], layout(p, depth));
+            }
+
+            // Appends, and works in short pieces too.
+            vector<ProceduralSample> pieces(row.begin(), row.begin() + 3);
+            for (int i = 3, len = 1; i < n; i += len, len = len % 7 + 1)
+            {
+                layout.row(coord_def(start.x + i, start.y),
+                           min(len, n - i), depth, pieces);
+            }
+            REQUIRE(pieces.size() == (size_t)n);
+            for (int i = 0; i < n; ++i)
+                _require_same_sample(pieces[i], row[i]);
+        }
+}
+
+TEST_CASE( "Procedural layouts sample rows as they do cells",
+           "[single-file]" ) {
+
+    // The abyss's layouts, as abyss.cc puts them together.
+    const WastesLayout wastes;
+    const DiamondLayout diamond30(3,0);
+    const DiamondLayout diamond21(2,1);
+    const ColumnLayout column2(2);
+    const ColumnLayout column26(2,6);
+    const WorleyLayout worleyL(123456,
+        { &diamond30, &diamond21, &column2, &column26 });
+    const RoilingChaosLayout chaosA(8675309, 450);
+    const RoilingChaosLayout chaosB(7654321, 400);
+    const NewAbyssLayout newAbyssLayout(7629);
+    const WorleyLayout layout(4321,
+        { &chaosA, &worleyL, &chaosB, &newAbyssLayout });
+    const WorleyLayout baseLayout(314159, { &newAbyssLayout, &layout }, 5.0);
+    const RiverLayout rivers(1800, baseLayout);
+    const WorleyLayout abyssLayout(23571113, { &rivers, &baseLayout }, 6.1f);
+
+    SECTION ("leaf layouts") {
+        _require_rows_match(wastes);
+        _require_rows_match(diamond21);
+        _require_rows_match(column26);
+        _require_rows_match(ChaosLayout(99));
+        _require_rows_match(chaosA);
+        _require_rows_match(newAbyssLayout);
+    }
+
+    SECTION ("layouts that hand cells on") {
+        _require_rows_match(worleyL);
+        _require_rows_match(baseLayout);
+        _require_rows_match(rivers);
+        _require_rows_match(abyssLayout);
+    }
+
+    SECTION ("layouts that keep the default") {
+        _require_rows_match(ForestLayout());
+        _require_rows_match(ClampLayout(rivers, 200, true));
+    }
+}
@@ -0,0 +1,264 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "store.h"
+#include "stringutil.h"
+#include "tags.h"
+
+static string _key(int i)
+{
+    return make_stringf("key_%d", i);
+}
+
+// Fill the table with key_0 .. key_(n-1), each holding its number.
+static void _fill(CrawlHashTable &table, int n)
+{
+    for (int i = 0; i < n; ++i)
+        table[_key(i)] = i;
+}
+
+// Check that table holds exactly the keys in expected, with the values
+// _fill() gave them, and that each one can be found.
+static void _require_keys(const CrawlHashTable &table, const set<int> &expected)
+{
+    REQUIRE(table.size() == expected.size());
+
+    set<int> seen;
+    for (const auto &entry : table)
+    {
+        REQUIRE(entry.second.get_int() == atoi(entry.first.c_str() + 4));
+        seen.insert(entry.second.get_int());
+    }
+    REQUIRE(seen == expected);
+
+    for (int i : expected)
+    {
+        REQUIRE(table.exists(_key(i)));
+        REQUIRE(table.find(_key(i)) != table.end());
+        REQUIRE(table[_key(i)].get_int() == i);
+    }
+    table.assert_validity();
+}
+
+static set<int> _range(int n)
+{
+    set<int> keys;
+    for (int i = 0; i < n; ++i)
+        keys.insert(i);
+    return keys;
+}
+
+// The table hashes keys with FNV-1a; see store.cc.
+static uint32_t _fnv1a(const string &key)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : key)
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    return hash;
+}
+
+TEST_CASE( "CrawlHashTable grows and shrinks across HASH_LINEAR_MAX",
+           "[single-file]" ) {
+
+    CrawlHashTable table;
+    _fill(table, HASH_LINEAR_MAX);
+    _require_keys(table, _range(HASH_LINEAR_MAX));
+
+    table[_key(HASH_LINEAR_MAX)] = HASH_LINEAR_MAX;
+    _require_keys(table, _range(HASH_LINEAR_MAX + 1));
+
+    REQUIRE(table.erase(_key(2)) == 1);
+    set<int> expected = _range(HASH_LINEAR_MAX + 1);
+    expected.erase(2);
+    _require_keys(table, expected);
+    REQUIRE_FALSE(table.exists(_key(2)));
+    REQUIRE(table.erase(_key(2)) == 0);
+
+    // And back over the limit with a key that was there before.
+    table[_key(2)] = 2;
+    _require_keys(table, _range(HASH_LINEAR_MAX + 1));
+
+    table.clear();
+    REQUIRE(table.empty());
+    REQUIRE_FALSE(table.exists(_key(0)));
+}
+
+TEST_CASE( "CrawlHashTable keeps references valid as it grows",
+           "[single-file]" ) {
+
+    CrawlHashTable table;
+    CrawlStoreValue &first = table["first"];
+    first = 17;
+    _fill(table, 4 * HASH_LINEAR_MAX);
+
+    REQUIRE(&table["first"] == &first);
+    REQUIRE(first.get_int() == 17);
+
+    // Erasing moves the last entry into the gap, but not its value.
+    CrawlStoreValue &last = table[_key(4 * HASH_LINEAR_MAX - 1)];
+    table.erase("first");
+    REQUIRE(&table[_key(4 * HASH_LINEAR_MAX - 1)] == &last);
+}
+
+TEST_CASE( "CrawlHashTable erases from the middle of a probe run",
+           "[single-file]" ) {
+
+    // Keys whose hashes agree in their low bits share a home bucket in any
+    // index of up to 1024 buckets, so they sit in one probe run.
+    vector<string> colliding;
+    for (int i = 0; colliding.size() < 5; ++i)
+    {
+        const string key = make_stringf("probe_%d", i);
+        if ((_fnv1a(key) & 1023) == (_fnv1a("probe_0") & 1023))
+            colliding.push_back(key);
+    }
+
+    CrawlHashTable table;
+    _fill(table, 2 * HASH_LINEAR_MAX);
+    for (const string &key : colliding)
+        table[key] = 0;
+
+    // Take out the middle of the run, then its start, then its end, then the rest.
+    set<string> left(colliding.begin(), colliding.end());
+    for (int victim : { 2, 0, 4, 1, 3 })
+    {
+        REQUIRE(table.erase(colliding[victim]) == 1);
+        REQUIRE_FALSE(table.exists(colliding[victim]));
+        left.erase(colliding[victim]);
+        for (const string &key : left)
+            REQUIRE(table.exists(key));
+        table.assert_validity();
+    }
+    _require_keys(table, _range(2 * HASH_LINEAR_MAX));
+
+    SECTION ("with many runs at once") {
+        CrawlHashTable big;
+        _fill(big, 300);
+        set<int> expected = _range(300);
+        for (int step : { 3, 2, 1 })
+            for (int i = step - 1; i < 300; i += 3)
+                if (expected.erase(i))
+                {
+                    REQUIRE(big.erase(_key(i)) == 1);
+                    if (i % 7 == 0)
+                        _require_keys(big, expected);
+                }
+        REQUIRE(big.empty());
+    }
+}
+
+TEST_CASE( "CrawlHashTable can erase while iterating", "[single-file]" ) {
+
+    for (int n : { HASH_LINEAR_MAX, 4 * HASH_LINEAR_MAX })
+    {
+        CrawlHashTable table;
+        _fill(table, n);
+
+        set<int> expected;
+        for (auto it = table.begin(); it != table.end();)
+        {
+            // erase() returns the entry that took the erased one's place.
+            if (it->second.get_int() % 2)
+                it = table.erase(it);
+            else
+            {
+                expected.insert(it->second.get_int());
+                ++it;
+            }
+        }
+
+        set<int> evens;
+        for (int i = 0; i < n; i += 2)
+            evens.insert(i);
+        REQUIRE(expected == evens);
+        _require_keys(table, evens);
+    }
+}
+
+TEST_CASE( "CrawlHashTable can be copied and moved", "[single-file]" ) {
+
+    for (int n : { HASH_LINEAR_MAX, 4 * HASH_LINEAR_MAX })
+    {
+        CrawlHashTable table;
+        _fill(table, n);
+        table["nested"].new_table()["inner"] = 5;
+
+        set<int> expected = _range(n);
+        // "nested" isn't a key_ entry.
+        auto with_nested = [&](const CrawlHashTable &t)
+        {
+            CrawlHashTable plain(t);
+            REQUIRE(plain["nested"]["inner"].get_int() == 5);
+            plain.erase("nested");
+            _require_keys(plain, expected);
+        };
+
+        CrawlHashTable copy(table);
+        with_nested(copy);
+
+        // The copy is deep.
+        table[_key(0)] = -1;
+        table["nested"]["inner"] = 6;
+        REQUIRE(copy[_key(0)].get_int() == 0);
+        REQUIRE(copy["nested"]["inner"].get_int() == 5);
+        table[_key(0)] = 0;
+        table["nested"]["inner"] = 5;
+
+        CrawlHashTable assigned;
+        assigned["stale"] = 1;
+        assigned = table;
+        REQUIRE_FALSE(assigned.exists("stale"));
+        with_nested(assigned);
+
+        CrawlHashTable moved(move(copy));
+        REQUIRE(copy.empty());
+        with_nested(moved);
+
+        CrawlHashTable move_assigned;
+        _fill(move_assigned, 3 * HASH_LINEAR_MAX);
+        move_assigned = move(moved);
+        REQUIRE(moved.empty());
+        with_nested(move_assigned);
+
+        // A moved-from table is still usable.
+        _fill(moved, n);
+        _require_keys(moved, expected);
+    }
+}
+
+TEST_CASE( "CrawlHashTable survives a save round trip", "[single-file]" ) {
+
+    CrawlHashTable table;
+    _fill(table, 2 * HASH_LINEAR_MAX);
+    table["name"] = string("Sigmund");
+    CrawlHashTable &nested = table["nested"].new_table();
+    nested["depth"] = 1;
+    nested["deeper"].new_table()["depth"] = 2;
+    CrawlVector &vec = nested["list"].new_vector(SV_INT);
+    vec.push_back(3);
+    vec.push_back(4);
+
+    vector<unsigned char> buf;
+    writer w(&buf);
+    table.write(w);
+
+    CrawlHashTable loaded;
+    reader r(buf);
+    r.setMinorVersion(TAG_MINOR_VERSION);
+    loaded.read(r);
+    REQUIRE(r.valid() == false);
+
+    REQUIRE(loaded.size() == table.size());
+    REQUIRE(loaded["name"].get_string() == "Sigmund");
+    REQUIRE(loaded["nested"]["depth"].get_int() == 1);
+    REQUIRE(loaded["nested"]["deeper"]["depth"].get_int() == 2);
+    const CrawlVector &loaded_vec = loaded["nested"]["list"].get_vector();
+    REQUIRE(loaded_vec.size() == 2);
+    REQUIRE(loaded_vec[0].get_int() == 3);
+    REQUIRE(loaded_vec[1].get_int() == 4);
+
+    loaded.erase("name");
+    loaded.erase("nested");
+    _require_keys(loaded, _range(2 * HASH_LINEAR_MAX));
+}
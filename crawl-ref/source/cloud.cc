@@ -45,9 +45,80 @@
 #include "unwind.h"
 #include "xom.h"
 
+cloud_store::cloud_store() : count(0), order_valid(true)
+{
+    slot.init(-1);
+}
+
+cloud_struct *cloud_store::find(const coord_def &pos)
+{
+    if (!map_bounds(pos) || slot(pos) < 0)
+        return nullptr;
+    return &clouds[slot(pos)];
+}
+
+cloud_struct &cloud_store::set(cloud_struct cloud)
+{
+    ASSERT(map_bounds(cloud.pos));
+    int &s = slot(cloud.pos);
+    if (s >= 0)
+        return clouds[s] = cloud;
+
+    if (free_slots.empty())
+    {
+        s = clouds.size();
+        clouds.push_back(cloud);
+    }
+    else
+    {
+        s = free_slots.back();
+        free_slots.pop_back();
+        clouds[s] = cloud;
+    }
+    ++count;
+    order_valid = false;
+    return clouds[s];
+}
+
+void cloud_store::erase(const coord_def &pos)
+{
+    if (!map_bounds(pos) || slot(pos) < 0)
+        return;
+
+    clouds[slot(pos)] = cloud_struct();
+    free_slots.push_back(slot(pos));
+    slot(pos) = -1;
+    --count;
+    order_valid = false;
+}
+
+void cloud_store::clear()
+{
+    clouds.clear();
+    free_slots.clear();
+    slot.init(-1);
+    count = 0;
+    order.clear();
+    order_valid = true;
+}
+
+vector<coord_def> cloud_store::positions()
+{
+    if (!order_valid)
+    {
+        order.clear();
+        for (int i = 0; i < (int)clouds.size(); ++i)
+            if (slot(clouds[i].pos) == i)
+                order.push_back(clouds[i].pos);
+        sort(order.begin(), order.end());
+        order_valid = true;
+    }
+    return order;
+}
+
 cloud_struct* cloud_at(coord_def pos)
 {
-    return map_find(env.cloud, pos);
+    return env.cloud.find(pos);
 }
 
 /// damage = base + random2avg(random, random/15 + 1)
@@ -459,10 +530,11 @@ static int _spread_cloud(const cloud_struct &cloud)
         if (newdecay >= cloud.decay)
             newdecay = cloud.decay - 1;
 
-        env.cloud[*ai] = cloud;
-        env.cloud[*ai].pos = *ai;
-        env.cloud[*ai].decay = newdecay;
-        _los_cloud_changed(env.cloud[*ai].pos, env.cloud[*ai].type, CLOUD_NONE);
+        cloud_struct spread = cloud;
+        spread.pos = *ai;
+        spread.decay = newdecay;
+        env.cloud.set(spread);
+        _los_cloud_changed(spread.pos, spread.type, CLOUD_NONE);
 
         extra_decay += 8;
     }
@@ -486,10 +558,11 @@ static void _spread_fire(const cloud_struct &cloud)
         // burning trees produce flames all around
         if (!cell_is_solid(*ai) && make_flames)
         {
-            env.cloud[*ai] = cloud;
-            env.cloud[*ai].type = CLOUD_FIRE;
-            env.cloud[*ai].pos = *ai;
-            env.cloud[*ai].decay = cloud.decay / 2 + 1;
+            cloud_struct flames = cloud;
+            flames.type = CLOUD_FIRE;
+            flames.pos = *ai;
+            flames.decay = cloud.decay / 2 + 1;
+            env.cloud.set(flames);
         }
 
         // forest fire doesn't spread in all directions at once,
@@ -506,9 +579,10 @@ static void _spread_fire(const cloud_struct &cloud)
         if (you.see_cell(*ai))
             mpr("The forest fire spreads!");
         destroy_wall(*ai);
-        env.cloud[*ai] = cloud;
-        env.cloud[*ai].pos = *ai;
-        env.cloud[*ai].decay = random2(30) + 25;
+        cloud_struct fire = cloud;
+        fire.pos = *ai;
+        fire.decay = random2(30) + 25;
+        env.cloud.set(fire);
 
     }
 }
@@ -528,10 +602,10 @@ static void _cloud_interacts_with_terrain(const cloud_struct &cloud)
             && one_chance_in(14))
         {
             const cloud_type old = cloud_type_at(p);
-            env.cloud[p] = cloud_struct(p, CLOUD_STEAM, 2 + random2(5),
-                                        11, cloud.whose, cloud.killer,
-                                        cloud.source, -1);
-            _los_cloud_changed(p, env.cloud[p].type, old);
+            env.cloud.set(cloud_struct(p, CLOUD_STEAM, 2 + random2(5),
+                                       11, cloud.whose, cloud.killer,
+                                       cloud.source, -1));
+            _los_cloud_changed(p, CLOUD_STEAM, old);
         }
     }
 }
@@ -632,14 +706,13 @@ static void _handle_spectral_cloud(const cloud_struct& cloud)
 
 void manage_clouds()
 {
-    // We can't iterate over env.cloud directly because _dissipate_cloud
-    // will remove this cloud and invalidate our iterator.
-    vector<cloud_struct *> cloud_ptrs;
-    for (auto& entry : env.cloud)
-        cloud_ptrs.push_back(&entry.second);
-
-    for (auto ptr : cloud_ptrs)
+    // Take the positions first, since _dissipate_cloud may remove this
+    // cloud and clouds may spread to new cells as we go.
+    for (coord_def pos : env.cloud.positions())
     {
+        cloud_struct* ptr = cloud_at(pos);
+        if (!ptr)
+            continue;
         cloud_struct& cloud = *ptr;
 
 #ifdef ASSERTS
@@ -689,13 +762,7 @@ void delete_cloud(coord_def p)
 
 void delete_all_clouds()
 {
-    // We can't iterate over env.cloud directly because delete_cloud
-    // will remove this cloud and invalidate our iterator.
-    vector<coord_def> cloud_locs;
-    for (auto& entry : env.cloud)
-        cloud_locs.push_back(entry.first);
-
-    for (auto pos : cloud_locs)
+    for (auto pos : env.cloud.positions())
         delete_cloud(pos);
 }
 
@@ -709,11 +776,12 @@ void move_cloud(coord_def src, coord_def newpos)
 
     const cloud_type old = cloud_type_at(newpos);
 
-    env.cloud[newpos] = env.cloud[src];
+    cloud_struct cloud = *cloud_at(src);
     env.cloud.erase(src);
-    env.cloud[newpos].pos = newpos;
-    _los_cloud_changed(src, CLOUD_NONE, env.cloud[newpos].type);
-    _los_cloud_changed(newpos, env.cloud[newpos].type, old);
+    cloud.pos = newpos;
+    env.cloud.set(cloud);
+    _los_cloud_changed(src, CLOUD_NONE, cloud.type);
+    _los_cloud_changed(newpos, cloud.type, old);
 }
 
 void swap_clouds(coord_def p1, coord_def p2)
@@ -731,13 +799,14 @@ void swap_clouds(coord_def p1, coord_def p2)
         return;
     }
 
-    cloud_struct temp = env.cloud[p1];
-    env.cloud[p1] = env.cloud[p2];
-    env.cloud[p2] = temp;
-    env.cloud[p1].pos = p1;
-    env.cloud[p2].pos = p2;
-    _los_cloud_changed(p1, env.cloud[p1].type, env.cloud[p2].type);
-    _los_cloud_changed(p2, env.cloud[p2].type, env.cloud[p1].type);
+    cloud_struct c1 = *cloud_at(p1);
+    cloud_struct c2 = *cloud_at(p2);
+    c1.pos = p2;
+    c2.pos = p1;
+    env.cloud.set(c2);
+    env.cloud.set(c1);
+    _los_cloud_changed(p1, c2.type, c1.type);
+    _los_cloud_changed(p2, c1.type, c2.type);
 }
 
 // Places a cloud with the given stats assuming one doesn't already
@@ -835,10 +904,10 @@ void place_cloud(cloud_type cl_type, const coord_def& ctarget, int cl_range,
     // possible to overwrite an opaque cloud with a non-opaque one; OOD will do
     // this.
     const cloud_type old = cloud ? cloud->type : CLOUD_NONE;
-    env.cloud[ctarget] = cloud_struct(ctarget, cl_type, cl_range * 10,
+    env.cloud.set(cloud_struct(ctarget, cl_type, cl_range * 10,
             _actual_spread_rate(cl_type, spread_rate), whose, killer, source,
-            excl_rad);
-    _los_cloud_changed(ctarget, env.cloud[ctarget].type, old);
+            excl_rad));
+    _los_cloud_changed(ctarget, cl_type, old);
 }
 
 bool is_opaque_cloud(cloud_type ctype)
@@ -1833,15 +1902,12 @@ void remove_vortex_clouds(mid_t whose)
     // spell (excluding immobile and mindless casters).
     // XXX: this comment seems impossibly out of date? ^
 
-    // We can't iterate over env.cloud directly because delete_cloud
-    // will remove this cloud and invalidate our iterator.
-    vector<coord_def> vortices;
-    for (auto& entry : env.cloud)
-        if (entry.second.type == CLOUD_VORTEX && entry.second.source == whose)
-            vortices.push_back(entry.first);
-
-    for (auto pos : vortices)
-        delete_cloud(pos);
+    for (auto pos : env.cloud.positions())
+    {
+        const cloud_struct* cloud = cloud_at(pos);
+        if (cloud && cloud->type == CLOUD_VORTEX && cloud->source == whose)
+            delete_cloud(pos);
+    }
 }
 
 static void _spread_cloud(coord_def pos, cloud_type type, int radius, int pow,
@@ -5,6 +5,14 @@
 
 #pragma once
 
+#include <deque>
+#include <vector>
+
+#include "fixedarray.h"
+
+using std::deque;
+using std::vector;
+
 struct cloud_struct
 {
     coord_def     pos;
@@ -39,6 +47,43 @@ struct cloud_struct
     static killer_type   whose_to_killer(kill_category whose);
 };
 
+/**
+ * The clouds on a level.
+ *
+ * Clouds are kept in a chunked dense array, with a grid of indices into it
+ * for lookups by position; freed slots are reused. A cloud never moves in
+ * the array while it exists, so the pointer from cloud_at() stays good until
+ * that cloud is deleted, even if other clouds come and go.
+ *
+ * positions() lists the clouds in coord_def order, the order clouds were
+ * iterated in when they lived in a map, so that anything rolling dice per
+ * cloud (and the save format) stays as it was.
+ */
+class cloud_store
+{
+public:
+    cloud_store();
+
+    cloud_struct *find(const coord_def &pos);
+    // Stores a copy of cloud at cloud.pos, replacing any cloud there.
+    cloud_struct &set(cloud_struct cloud);
+    void erase(const coord_def &pos);
+    void clear();
+    int size() const { return count; }
+
+    vector<coord_def> positions();
+
+private:
+    deque<cloud_struct> clouds;
+    vector<int> free_slots;
+    FixedArray<int, GXM, GYM> slot;
+    int count;
+
+    // positions() sorted, unless something has been added or removed since.
+    vector<coord_def> order;
+    bool order_valid;
+};
+
 enum cloud_tile_variation
 {
     CTVARY_NONE,     ///< fixed tile (or special case)
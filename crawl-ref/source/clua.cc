@@ -3,11 +3,13 @@
 #include "clua.h"
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "cluautil.h"
 #include "dlua.h"
 #include "end.h"
 #include "files.h"
+#include "hash.h"
 #include "libutil.h"
 #include "l-libs.h"
 #include "maybe-bool.h"
@@ -16,6 +18,7 @@
 #include "state.h"
 #include "stringutil.h"
 #include "syscalls.h"
+#include "tags.h"
 #include "unicode.h"
 #include "version.h"
 
@@ -257,6 +260,222 @@ int CLua::loadstring(const char *s, const char *context)
     return loadbuffer(s, strlen(s), context);
 }
 
+/////////////////////////////////////////////////////////////////////
+// The chunk cache: bytecode of compiled scripts and map chunks, keyed by
+// a hash of their name and source, and saved next to the des cache so that
+// later processes need not compile them again. The name, and a second hash
+// and the length of the source, are stored too, so that a collision of
+// keys can't run the wrong chunk.
+//
+// Many processes share the file, so each merges its new chunks into what
+// is on disk when it writes, and chunks no process has used for a while
+// are dropped then.
+
+// Bump when the layout of the cache file changes.
+#define CHUNK_CACHE_FORMAT 3
+// Chunks unused for this long (in seconds) are dropped from the file.
+#define CHUNK_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+// A used chunk's timestamp is only refreshed, rewriting the file, once it
+// is this old.
+#define CHUNK_CACHE_REFRESH (24 * 60 * 60)
+
+struct cached_chunk
+{
+    string context;
+    uint64_t source_hash;
+    uint32_t source_len;
+    string bytecode;
+    // When some process last loaded the chunk.
+    int64_t last_used;
+};
+
+typedef unordered_map<uint64_t, cached_chunk> chunk_map;
+
+static chunk_map chunk_cache;
+static string chunk_cache_file;
+// Until the options are loaded, the des cache may yet move.
+static bool chunk_cache_open = false;
+static bool chunk_cache_dirty = false;
+
+int CLua::chunks_compiled = 0;
+int CLua::chunks_cached = 0;
+
+static uint64_t _chunk_key(const char *buf, size_t size, const char *context)
+{
+    // Include the terminating null, so that name and source can't run
+    // into each other.
+    return hash64(buf, size, hash64(context, strlen(context) + 1));
+}
+
+// Add the chunks in the cache file to the map. Chunks already there are
+// kept, but take the later of the two timestamps.
+static void _read_chunk_cache(chunk_map &chunks)
+{
+    FILE *fp = fopen_u(chunk_cache_file.c_str(), "rb");
+    if (!fp)
+        return;
+
+    reader inf(fp);
+    inf.set_safe_read(true);
+    try
+    {
+        const auto version = get_save_version(inf);
+        // Lua checks itself that the bytecode suits this build.
+        if (version.major == TAG_MAJOR_VERSION
+            && version.minor <= TAG_MINOR_VERSION
+            && unmarshallInt(inf) == CHUNK_CACHE_FORMAT)
+        {
+            for (int n = unmarshallInt(inf); n > 0; --n)
+            {
+                const uint64_t key = unmarshallSigned(inf);
+                cached_chunk chunk;
+                unmarshallString4(inf, chunk.context);
+                chunk.source_hash = unmarshallSigned(inf);
+                chunk.source_len = unmarshallInt(inf);
+                unmarshallString4(inf, chunk.bytecode);
+                chunk.last_used = unmarshallSigned(inf);
+
+                auto it = chunks.find(key);
+                if (it == chunks.end())
+                    chunks.emplace(key, move(chunk));
+                else if (it->second.last_used < chunk.last_used)
+                    it->second.last_used = chunk.last_used;
+            }
+        }
+    }
+    catch (const short_read_exception&)
+    {
+        // Keep what was read intact; the next write replaces the file.
+    }
+    fclose(fp);
+}
+
+void CLua::open_chunk_cache()
+{
+    if (chunk_cache_open)
+        return;
+    chunk_cache_open = true;
+
+    // Fixed now, so that the cache is written where it was read from.
+    chunk_cache_file = catpath(savedir_versioned_path("des"), "chunks.luac");
+    _read_chunk_cache(chunk_cache);
+}
+
+static int _dump_chunk(lua_State *ls, const void *p, size_t sz, void *ud)
+{
+    UNUSED(ls);
+    static_cast<string *>(ud)->append(static_cast<const char *>(p), sz);
+    return 0;
+}
+
+static int _load_cached_chunk(lua_State *ls, const char *buf, size_t size,
+                              const char *context, string *bytecode)
+{
+    const uint64_t key = _chunk_key(buf, size, context);
+    const uint64_t source_hash = hash64(buf, size);
+    const int64_t now = time(nullptr);
+
+    auto it = chunk_cache.find(key);
+    if (it != chunk_cache.end() && it->second.context == context
+        && it->second.source_len == size
+        && it->second.source_hash == source_hash)
+    {
+        const string &code = it->second.bytecode;
+        if (!luaL_loadbuffer(ls, code.data(), code.size(), context))
+        {
+            CLua::chunks_cached++;
+            if (now - it->second.last_used >= CHUNK_CACHE_REFRESH)
+            {
+                it->second.last_used = now;
+                chunk_cache_dirty = true;
+            }
+            if (bytecode)
+                *bytecode = code;
+            return 0;
+        }
+        // Most likely built by a different Lua; compile it afresh.
+        lua_pop(ls, 1);
+        chunk_cache.erase(it);
+    }
+
+    const int err = luaL_loadbuffer(ls, buf, size, context);
+    if (err)
+        return err;
+    CLua::chunks_compiled++;
+
+    string code;
+    if (lua_dump(ls, _dump_chunk, &code))
+        return 0;
+    if (bytecode)
+        *bytecode = code;
+    if (!chunk_cache_open)
+        return 0;
+
+    // Also replaces a different chunk with the same key.
+    cached_chunk &chunk = chunk_cache[key];
+    chunk.context = context;
+    chunk.source_hash = source_hash;
+    chunk.source_len = size;
+    chunk.bytecode = move(code);
+    chunk.last_used = now;
+    chunk_cache_dirty = true;
+    return 0;
+}
+
+int CLua::loadcached(const string &source, const char *context,
+                     string *bytecode)
+{
+    const int err = _load_cached_chunk(state(), source.data(), source.size(),
+                                       context, bytecode);
+    set_error(err, state());
+    return err;
+}
+
+void CLua::save_chunk_cache()
+{
+    if (!chunk_cache_open || !chunk_cache_dirty)
+        return;
+    chunk_cache_dirty = false;
+
+    file_lock lock(chunk_cache_file + ".lk", "wb", false);
+
+    // Pick up what other processes have written since we read the file,
+    // and drop what nobody has used for a while.
+    _read_chunk_cache(chunk_cache);
+    const int64_t now = time(nullptr);
+    for (auto it = chunk_cache.begin(); it != chunk_cache.end();)
+    {
+        if (now - it->second.last_used > CHUNK_CACHE_MAX_AGE)
+            it = chunk_cache.erase(it);
+        else
+            ++it;
+    }
+
+    // Other processes may be reading the old cache, so replace it whole.
+    const string tmpname = chunk_cache_file + ".tmp";
+    FILE *fp = fopen_replace(tmpname.c_str());
+    if (!fp)
+        return;
+
+    writer outf(tmpname, fp, true);
+    write_save_version(outf, save_version::current());
+    marshallInt(outf, CHUNK_CACHE_FORMAT);
+    marshallInt(outf, chunk_cache.size());
+    for (const auto &entry : chunk_cache)
+    {
+        marshallSigned(outf, entry.first);
+        marshallString4(outf, entry.second.context);
+        marshallSigned(outf, entry.second.source_hash);
+        marshallInt(outf, entry.second.source_len);
+        marshallString4(outf, entry.second.bytecode);
+        marshallSigned(outf, entry.second.last_used);
+    }
+    const bool ok = outf.succeeded() && !fclose(fp);
+
+    if (!ok || rename_u(tmpname.c_str(), chunk_cache_file.c_str()))
+        unlink_u(tmpname.c_str());
+}
+
 int CLua::execstring(const char *s, const char *context, int nresults)
 {
     int err = 0;
@@ -309,8 +528,8 @@ int CLua::loadfile(lua_State *ls, const char *filename, bool trusted,
         abort();
 
     // prefixing with @ stops lua from adding [string "%s"]
-    return luaL_loadbuffer(ls, &script[0], script.length(),
-                           ("@" + file).c_str());
+    return _load_cached_chunk(ls, &script[0], script.length(),
+                              ("@" + file).c_str(), nullptr);
 }
 
 int CLua::execfile(const char *filename, bool trusted, bool die_on_fail,
@@ -726,8 +945,10 @@ void CLua::init_lua()
 # endif
     _state = luaL_newstate();
 #else
-    // Throttle memory usage in managed (clua) VMs
-    _state = managed_vm? lua_newstate(_clua_allocator, this) : luaL_newstate();
+    // Throttle memory usage in managed (clua) VMs; the dungeon builder's
+    // VM has its own allocator.
+    _state = lua_newstate(managed_vm ? _clua_allocator : dlua_allocator,
+                          this);
 #endif
     if (!_state)
         end(1, false, "Unable to create Lua state.");
@@ -118,6 +118,11 @@ public:
 
     int loadbuffer(const char *buf, size_t size, const char *context);
     int loadstring(const char *str, const char *context);
+    // Like loadstring, for chunks that are loaded again and again: their
+    // bytecode is cached, and kept between processes. Gives the bytecode
+    // too, if asked.
+    int loadcached(const string &source, const char *context,
+                   string *bytecode = nullptr);
     int execstring(const char *str, const char *context = "init.txt",
                    int nresults = 0);
     int execfile(const char *filename,
@@ -143,6 +148,17 @@ public:
                         bool trusted = false, bool die_on_fail = false);
     static bool is_path_safe(string file, bool trusted = false);
 
+    // The chunk cache lives in the des cache directory, so it is only
+    // opened once the options are loaded; chunks loaded before then are
+    // just compiled.
+    static void open_chunk_cache();
+    // Write the cache back if it has changed, merged with what other
+    // processes have written since it was read.
+    static void save_chunk_cache();
+    // How many cacheable chunks had to be compiled, and how many were
+    // found in the cache.
+    static int chunks_compiled, chunks_cached;
+
     static bool is_managed_vm(lua_State *ls);
 
     void print_stack();
@@ -7,6 +7,7 @@
 
 #include "database.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -14,10 +15,14 @@
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
 #endif
+#ifdef UNIX
+#include <sys/mman.h>
+#endif
 
 #include "clua.h"
 #include "end.h"
 #include "files.h"
+#include "hash.h"
 #include "libutil.h"
 #include "options.h"
 #include "random.h"
@@ -25,6 +30,348 @@
 #include "syscalls.h"
 #include "unicode.h"
 
+// A read-only image of a whole DB, written next to it whenever it's
+// regenerated, and mapped into memory so that lookups need no queries.
+// Keys are found through a perfect hash: the key's bucket gives the seed
+// that hashes it to its own slot. Files are only for this build, so
+// everything is in native byte order.
+//
+// Layout: db_snapshot_header, then the bucket seeds, the slots (entry
+// numbers, or NO_ENTRY), the entries, and the key and value text.
+struct db_snapshot_header
+{
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t n_entries, n_buckets, n_slots;
+};
+
+struct db_snapshot_entry
+{
+    uint32_t key, key_len, value, value_len;
+};
+
+static const char DB_SNAPSHOT_MAGIC[8] = "DBSNAP1";
+static const uint32_t DB_SNAPSHOT_BYTE_ORDER = 0x01020304;
+static const uint32_t NO_ENTRY = 0xffffffff;
+
+static uint64_t _snapshot_hash(const char *key, size_t len, uint32_t seed)
+{
+    return hash64(key, len, hash64(&seed, sizeof(seed)));
+}
+
+class db_snapshot
+{
+public:
+    ~db_snapshot();
+    static db_snapshot *open(const string &file);
+    static bool write(const string &file,
+                      const vector<pair<string, string>> &entries);
+
+    uint32_t size() const { return header->n_entries; }
+    string key(uint32_t i) const
+    {
+        return string(text + entries[i].key, entries[i].key_len);
+    }
+    string value(uint32_t i) const
+    {
+        return string(text + entries[i].value, entries[i].value_len);
+    }
+    bool find(const string &key, string &value) const;
+    // Entries that might contain s, lowercased, in order.
+    vector<uint32_t> may_contain(const string &s);
+
+private:
+    db_snapshot() = default;
+    bool check();
+
+    const char *data = nullptr;
+    size_t data_size = 0;
+#ifndef UNIX
+    vector<char> buf;
+#endif
+    const db_snapshot_header *header = nullptr;
+    const uint32_t *seeds = nullptr;
+    const uint32_t *slots = nullptr;
+    const db_snapshot_entry *entries = nullptr;
+    const char *text = nullptr;
+    size_t text_size = 0;
+
+    // For searches: the entries with each trigram of their lowercased key
+    // and value, built the first time it's needed.
+    map<uint32_t, vector<uint32_t>> trigrams;
+    void index_trigrams();
+};
+
+db_snapshot::~db_snapshot()
+{
+#ifdef UNIX
+    if (data)
+        munmap(const_cast<char *>(data), data_size);
+#endif
+}
+
+db_snapshot *db_snapshot::open(const string &file)
+{
+    db_snapshot *snap = new db_snapshot;
+#ifdef UNIX
+    int fd = open_u(file.c_str(), O_RDONLY, 0);
+    if (fd != -1)
+    {
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0)
+        {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE,
+                              fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                snap->data = static_cast<const char *>(addr);
+                snap->data_size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+#else
+    if (FILE *fp = fopen_u(file.c_str(), "rb"))
+    {
+        snap->buf.resize(file_size(fp));
+        if (!snap->buf.empty()
+            && fread(&snap->buf[0], 1, snap->buf.size(), fp)
+               == snap->buf.size())
+        {
+            snap->data = &snap->buf[0];
+            snap->data_size = snap->buf.size();
+        }
+        fclose(fp);
+    }
+#endif
+
+    if (!snap->data || !snap->check())
+    {
+        delete snap;
+        return nullptr;
+    }
+    return snap;
+}
+
+bool db_snapshot::check()
+{
+    if (data_size < sizeof(db_snapshot_header))
+        return false;
+    header = reinterpret_cast<const db_snapshot_header *>(data);
+    if (memcmp(header->magic, DB_SNAPSHOT_MAGIC, sizeof(header->magic))
+        || header->byte_order != DB_SNAPSHOT_BYTE_ORDER
+        || !header->n_buckets || header->n_slots < header->n_entries)
+    {
+        return false;
+    }
+
+    const size_t tables = sizeof(db_snapshot_header)
+        + sizeof(uint32_t) * ((size_t)header->n_buckets + header->n_slots)
+        + sizeof(db_snapshot_entry) * (size_t)header->n_entries;
+    if (data_size < tables)
+        return false;
+
+    seeds = reinterpret_cast<const uint32_t *>(header + 1);
+    slots = seeds + header->n_buckets;
+    entries = reinterpret_cast<const db_snapshot_entry *>(
+                  slots + header->n_slots);
+    text = data + tables;
+    text_size = data_size - tables;
+
+    for (uint32_t i = 0; i < header->n_slots; ++i)
+        if (slots[i] != NO_ENTRY && slots[i] >= header->n_entries)
+            return false;
+    for (uint32_t i = 0; i < header->n_entries; ++i)
+    {
+        const db_snapshot_entry &e = entries[i];
+        if (e.key > text_size || e.key_len > text_size - e.key
+            || e.value > text_size || e.value_len > text_size - e.value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool db_snapshot::find(const string &key, string &value) const
+{
+    const uint32_t bucket =
+        _snapshot_hash(key.data(), key.size(), 0) % header->n_buckets;
+    const uint32_t slot = _snapshot_hash(key.data(), key.size(),
+                                         seeds[bucket]) % header->n_slots;
+    const uint32_t i = slots[slot];
+    if (i == NO_ENTRY || entries[i].key_len != key.size()
+        || memcmp(text + entries[i].key, key.data(), key.size()))
+    {
+        return false;
+    }
+    value = this->value(i);
+    return true;
+}
+
+// Only ASCII is folded, so searches for anything else must be exact.
+static uint8_t _ascii_lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static uint32_t _trigram(const char *s)
+{
+    return _ascii_lower(s[0]) << 16 | _ascii_lower(s[1]) << 8
+           | _ascii_lower(s[2]);
+}
+
+void db_snapshot::index_trigrams()
+{
+    for (uint32_t i = 0; i < size(); ++i)
+    {
+        for (const string &s : { key(i), value(i) })
+        {
+            for (size_t j = 0; j + 3 <= s.size(); ++j)
+            {
+                vector<uint32_t> &list = trigrams[_trigram(&s[j])];
+                if (list.empty() || list.back() != i)
+                    list.push_back(i);
+            }
+        }
+    }
+}
+
+vector<uint32_t> db_snapshot::may_contain(const string &s)
+{
+    vector<uint32_t> found;
+    if (s.size() < 3)
+    {
+        for (uint32_t i = 0; i < size(); ++i)
+            found.push_back(i);
+        return found;
+    }
+
+    if (trigrams.empty())
+        index_trigrams();
+
+    // Start from the rarest trigram, and keep what has all the others.
+    vector<const vector<uint32_t> *> lists;
+    for (size_t j = 0; j + 3 <= s.size(); ++j)
+    {
+        auto it = trigrams.find(_trigram(&s[j]));
+        if (it == trigrams.end())
+            return found;
+        lists.push_back(&it->second);
+    }
+    sort(lists.begin(), lists.end(),
+         [](const vector<uint32_t> *a, const vector<uint32_t> *b)
+         { return a->size() < b->size(); });
+
+    found = *lists[0];
+    for (size_t j = 1; j < lists.size() && !found.empty(); ++j)
+    {
+        vector<uint32_t> both;
+        set_intersection(found.begin(), found.end(),
+                         lists[j]->begin(), lists[j]->end(),
+                         back_inserter(both));
+        found.swap(both);
+    }
+    return found;
+}
+
+bool db_snapshot::write(const string &file,
+                        const vector<pair<string, string>> &contents)
+{
+    db_snapshot_header head;
+    memcpy(head.magic, DB_SNAPSHOT_MAGIC, sizeof(head.magic));
+    head.byte_order = DB_SNAPSHOT_BYTE_ORDER;
+    head.n_entries = contents.size();
+    head.n_buckets = max<uint32_t>(1, head.n_entries / 4);
+    head.n_slots = head.n_entries + head.n_entries / 4 + 1;
+
+    // Place the biggest buckets first, while there's most room.
+    vector<vector<uint32_t>> buckets(head.n_buckets);
+    for (uint32_t i = 0; i < head.n_entries; ++i)
+    {
+        const string &key = contents[i].first;
+        buckets[_snapshot_hash(key.data(), key.size(), 0) % head.n_buckets]
+            .push_back(i);
+    }
+    vector<uint32_t> order(head.n_buckets);
+    for (uint32_t b = 0; b < head.n_buckets; ++b)
+        order[b] = b;
+    sort(order.begin(), order.end(),
+         [&](uint32_t a, uint32_t b)
+         { return buckets[a].size() > buckets[b].size(); });
+
+    vector<uint32_t> seeds(head.n_buckets, 0);
+    vector<uint32_t> slots(head.n_slots, NO_ENTRY);
+    for (uint32_t b : order)
+    {
+        if (buckets[b].empty())
+            break;
+        vector<uint32_t> taken;
+        for (uint32_t seed = 1; ; ++seed)
+        {
+            taken.clear();
+            for (uint32_t i : buckets[b])
+            {
+                const string &key = contents[i].first;
+                const uint32_t slot = _snapshot_hash(key.data(), key.size(),
+                                                     seed) % head.n_slots;
+                if (slots[slot] != NO_ENTRY
+                    || std::find(taken.begin(), taken.end(), slot)
+                       != taken.end())
+                {
+                    break;
+                }
+                taken.push_back(slot);
+            }
+            if (taken.size() == buckets[b].size())
+            {
+                seeds[b] = seed;
+                for (size_t j = 0; j < taken.size(); ++j)
+                    slots[taken[j]] = buckets[b][j];
+                break;
+            }
+        }
+    }
+
+    vector<db_snapshot_entry> entries;
+    string text;
+    for (const auto &entry : contents)
+    {
+        db_snapshot_entry e;
+        e.key = text.size();
+        e.key_len = entry.first.size();
+        text += entry.first;
+        e.value = text.size();
+        e.value_len = entry.second.size();
+        text += entry.second;
+        entries.push_back(e);
+    }
+
+    // Other processes may have the old one mapped, so replace it whole.
+    const string tmpname = file + ".tmp";
+    FILE *fp = fopen_replace(tmpname.c_str());
+    if (!fp)
+        return false;
+    auto put = [fp](const void *data, size_t size)
+    {
+        return !size || fwrite(data, 1, size, fp) == size;
+    };
+    bool ok = put(&head, sizeof(head))
+              && put(seeds.data(), seeds.size() * sizeof(uint32_t))
+              && put(slots.data(), slots.size() * sizeof(uint32_t))
+              && put(entries.data(),
+                     entries.size() * sizeof(db_snapshot_entry))
+              && put(text.data(), text.size());
+    ok = !fclose(fp) && ok;
+
+    if (!ok || rename_u(tmpname.c_str(), file.c_str()))
+    {
+        unlink_u(tmpname.c_str());
+        return false;
+    }
+    return true;
+}
+
 // TextDB handles dependency checking the db vs text files, creating the
 // db, loading, and destroying the DB.
 class TextDB
@@ -38,10 +385,10 @@ public:
     void init();
     void shutdown(bool recursive = false);
     DBM* get() { return _db; }
+    db_snapshot *snapshot() { return _snapshot; }
+    string fetch(const string &key);
 
-    // Make it easier to migrate from raw DBM* to TextDB
-    operator bool() const { return _db != 0; }
-    operator DBM*() const { return _db; }
+    operator bool() const { return _db || _snapshot; }
 
  private:
     bool _needs_update() const;
@@ -53,6 +400,7 @@ public:
     string _directory;
     vector<string> _input_files;
     DBM* _db;
+    db_snapshot *_snapshot;
     string timestamp;
     TextDB *_parent;
     const char* lang() { return _parent ? Options.lang_name : 0; }
@@ -169,7 +517,8 @@ static string _db_cache_path(string db, const char *lang)
 
 TextDB::TextDB(const char* db_name, const char* dir, vector<string> files)
     : _db_name(db_name), _directory(dir), _input_files(files),
-      _db(nullptr), timestamp(""), _parent(0), translation(0)
+      _db(nullptr), _snapshot(nullptr), timestamp(""), _parent(0),
+      translation(0)
 {
 }
 
@@ -177,18 +526,22 @@ TextDB::TextDB(TextDB *parent)
     : _db_name(parent->_db_name),
       _directory(parent->_directory + Options.lang_name + "/"),
       _input_files(parent->_input_files), // FIXME: pointless copy
-      _db(nullptr), timestamp(""), _parent(parent), translation(nullptr)
+      _db(nullptr), _snapshot(nullptr), timestamp(""), _parent(parent),
+      translation(nullptr)
 {
 }
 
 bool TextDB::open_db()
 {
-    if (_db)
+    if (_db || _snapshot)
         return true;
 
+    // Without the snapshot, only open the DB to see that it's out of date.
     const string full_db_path = _db_cache_path(_db_name, lang());
-    _db = dbm_open(full_db_path.c_str(), O_RDONLY, 0660);
-    if (!_db)
+    _snapshot = db_snapshot::open(full_db_path + ".snap");
+    if (!_snapshot)
+        _db = dbm_open(full_db_path.c_str(), O_RDONLY, 0660);
+    if (!_db && !_snapshot)
         return false;
 
     timestamp = _query_database(*this, "TIMESTAMP", false, false, true);
@@ -219,6 +572,23 @@ void TextDB::init()
     }
 }
 
+string TextDB::fetch(const string &key)
+{
+    string value;
+    if (_snapshot)
+        _snapshot->find(key, value);
+    else if (_db)
+    {
+        datum dbKey;
+        dbKey.dptr = (DPTR_COERCE) key.c_str();
+        dbKey.dsize = key.length();
+        datum result = dbm_fetch(_db, dbKey);
+        if (result.dsize > 0)
+            value = string((const char *)result.dptr, result.dsize);
+    }
+    return value;
+}
+
 void TextDB::shutdown(bool recursive)
 {
     if (_db)
@@ -226,6 +596,8 @@ void TextDB::shutdown(bool recursive)
         dbm_close(_db);
         _db = nullptr;
     }
+    delete _snapshot;
+    _snapshot = nullptr;
     if (recursive && translation)
         translation->shutdown(recursive);
 }
@@ -266,6 +638,9 @@ bool TextDB::_needs_update() const
         return false;
     }
 
+    // Without a snapshot (a DB from before snapshots, or one whose snapshot
+    // couldn't be written), open_db() fell back to the DB itself, which is
+    // slower but fine; rebuilding wouldn't help a read-only data dir.
     return ts != timestamp;
 }
 
@@ -320,6 +695,17 @@ void TextDB::_regenerate_db()
     }
     _add_entry(_db, "TIMESTAMP", ts);
 
+    vector<pair<string, string>> entries;
+    for (datum dbKey = dbm_firstkey(_db); dbKey.dptr != nullptr;
+         dbKey = dbm_nextkey(_db))
+    {
+        datum dbBody = dbm_fetch(_db, dbKey);
+        entries.emplace_back(string((const char *)dbKey.dptr, dbKey.dsize),
+                             string((const char *)dbBody.dptr, dbBody.dsize));
+    }
+    if (!db_snapshot::write(db_path + ".snap", entries))
+        mprf(MSGCH_ERROR, "Unable to write DB snapshot: %s", db_path.c_str());
+
     dbm_close(_db);
     _db = 0;
 }
@@ -345,24 +731,41 @@ void databaseSystemShutdown()
 ////////////////////////////////////////////////////////////////////////////
 // Main DB functions
 
-static datum _database_fetch(DBM *database, const string &key)
+static string _database_fetch(TextDB *db, const string &key)
 {
-    datum result;
-    result.dptr = nullptr;
-    result.dsize = 0;
-    datum dbKey;
-
-    dbKey.dptr = (DPTR_COERCE) key.c_str();
-    dbKey.dsize = key.length();
-
     // Don't use the database if called from "monster".
-    if (database)
-        result = dbm_fetch(database, dbKey);
+    if (!db)
+        return "";
+    return db->fetch(key);
+}
+
+// The literal text a regex has to match, if it's nothing but.
+static bool _regex_literal(const string &regex, string &literal)
+{
+    if (regex.find_first_of("\\^$.|?*+()[]{}") != string::npos)
+        return false;
+    for (char c : regex)
+        if (c & 0x80)
+            return false;
+    literal = regex;
+    return true;
+}
 
-    return result;
+// Entries of the snapshot that might match the regex.
+static vector<uint32_t> _snapshot_candidates(db_snapshot &snap,
+                                             const string &regex)
+{
+    string literal;
+    if (_regex_literal(regex, literal))
+        return snap.may_contain(literal);
+
+    vector<uint32_t> all(snap.size());
+    for (uint32_t i = 0; i < snap.size(); ++i)
+        all[i] = i;
+    return all;
 }
 
-static vector<string> _database_find_keys(DBM *database,
+static vector<string> _database_find_keys(TextDB *database,
                                           const string &regex,
                                           bool ignore_case,
                                           db_find_filter filter = nullptr)
@@ -370,7 +773,23 @@ static vector<string> _database_find_keys(DBM *database,
     text_pattern             tpat(regex, ignore_case);
     vector<string> matches;
 
-    datum dbKey = dbm_firstkey(database);
+    if (db_snapshot *snap = database->snapshot())
+    {
+        for (uint32_t i : _snapshot_candidates(*snap, regex))
+        {
+            const string key = snap->key(i);
+            if (tpat.matches(key)
+                && key.find("__") == string::npos
+                && (filter == nullptr || !(*filter)(key, "")))
+            {
+                matches.push_back(key);
+            }
+        }
+        return matches;
+    }
+
+    DBM *db = database->get();
+    datum dbKey = dbm_firstkey(db);
 
     while (dbKey.dptr != nullptr)
     {
@@ -383,13 +802,13 @@ static vector<string> _database_find_keys(DBM *database,
             matches.push_back(key);
         }
 
-        dbKey = dbm_nextkey(database);
+        dbKey = dbm_nextkey(db);
     }
 
     return matches;
 }
 
-static vector<string> _database_find_bodies(DBM *database,
+static vector<string> _database_find_bodies(TextDB *database,
                                             const string &regex,
                                             bool ignore_case,
                                             db_find_filter filter = nullptr)
@@ -397,13 +816,30 @@ static vector<string> _database_find_bodies(DBM *database,
     text_pattern             tpat(regex, ignore_case);
     vector<string> matches;
 
-    datum dbKey = dbm_firstkey(database);
+    if (db_snapshot *snap = database->snapshot())
+    {
+        for (uint32_t i : _snapshot_candidates(*snap, regex))
+        {
+            const string key = snap->key(i);
+            const string body = snap->value(i);
+            if (tpat.matches(body)
+                && key.find("__") == string::npos
+                && (filter == nullptr || !(*filter)(key, body)))
+            {
+                matches.push_back(key);
+            }
+        }
+        return matches;
+    }
+
+    DBM *db = database->get();
+    datum dbKey = dbm_firstkey(db);
 
     while (dbKey.dptr != nullptr)
     {
         string key((const char *)dbKey.dptr, dbKey.dsize);
 
-        datum dbBody = dbm_fetch(database, dbKey);
+        datum dbBody = dbm_fetch(db, dbKey);
         string body((const char *)dbBody.dptr, dbBody.dsize);
 
         if (tpat.matches(body)
@@ -413,7 +849,7 @@ static vector<string> _database_find_bodies(DBM *database,
             matches.push_back(key);
         }
 
-        dbKey = dbm_nextkey(database);
+        dbKey = dbm_nextkey(db);
     }
 
     return matches;
@@ -622,14 +1058,14 @@ static string _getWeightedString(TextDB &db, const string &key,
     lowercase(canonical_key);
 
     // Query the DB.
-    datum result;
+    string str;
 
     if (db.translation)
-        result = _database_fetch(db.translation->get(), canonical_key);
-    if (result.dsize <= 0)
-        result = _database_fetch(db.get(), canonical_key);
+        str = _database_fetch(db.translation, canonical_key);
+    if (str.empty())
+        str = _database_fetch(&db, canonical_key);
 
-    if (result.dsize <= 0)
+    if (str.empty())
     {
         // Try ignoring the suffix.
         canonical_key = key;
@@ -637,17 +1073,14 @@ static string _getWeightedString(TextDB &db, const string &key,
 
         // Query the DB.
         if (db.translation)
-            result = _database_fetch(db.translation->get(), canonical_key);
-        if (result.dsize <= 0)
-            result = _database_fetch(db.get(), canonical_key);
+            str = _database_fetch(db.translation, canonical_key);
+        if (str.empty())
+            str = _database_fetch(&db, canonical_key);
 
-        if (result.dsize <= 0)
+        if (str.empty())
             return "";
     }
 
-    // Cons up a (C++) string to return. The caller must release it.
-    string str = string((const char *)result.dptr, result.dsize);
-
     return _chooseStrByWeight(str, fixed_weight);
 }
 
@@ -736,18 +1169,16 @@ static string _query_database(TextDB &db, string key, bool canonicalise_key,
     }
 
     // Query the DB.
-    datum result;
+    string str;
 
     if (db.translation && !untranslated)
-        result = _database_fetch(db.translation->get(), key);
-    if (result.dsize <= 0)
-        result = _database_fetch(db.get(), key);
+        str = _database_fetch(db.translation, key);
+    if (str.empty())
+        str = _database_fetch(&db, key);
 
-    if (result.dsize <= 0)
+    if (str.empty())
         return "";
 
-    string str((const char *)result.dptr, result.dsize);
-
     // <foo> is an alias to key foo
     if (str[0] == '<' && str[str.size() - 2] == '>'
         && str.find('<', 1) == str.npos
@@ -784,7 +1215,7 @@ string getLongDescription(const string &key)
 vector<string> getLongDescKeysByRegex(const string &regex,
                                       db_find_filter filter)
 {
-    if (!DescriptionDB.get())
+    if (!DescriptionDB)
     {
         vector<string> empty;
         return empty;
@@ -792,13 +1223,13 @@ vector<string> getLongDescKeysByRegex(const string &regex,
 
     // FIXME: need to match regex against translated keys, which can't
     // be done by db only.
-    return _database_find_keys(DescriptionDB.get(), regex, true, filter);
+    return _database_find_keys(&DescriptionDB, regex, true, filter);
 }
 
 vector<string> getLongDescBodiesByRegex(const string &regex,
                                         db_find_filter filter)
 {
-    if (!DescriptionDB.get())
+    if (!DescriptionDB)
     {
         vector<string> empty;
         return empty;
@@ -808,8 +1239,8 @@ vector<string> getLongDescBodiesByRegex(const string &regex,
     // Not good, but otherwise we'd have to check hundreds of keys, with
     // two queries for each.
     // SQL can do this in one go, DBM can't.
-    DBM *database = DescriptionDB.translation ?
-        DescriptionDB.translation->get() : DescriptionDB.get();
+    TextDB *database = DescriptionDB.translation ?
+        DescriptionDB.translation : &DescriptionDB;
     return _database_find_bodies(database, regex, true, filter);
 }
 
@@ -875,13 +1306,13 @@ string getHelpString(const string &topic)
 // FAQ DB specific functions.
 vector<string> getAllFAQKeys()
 {
-    if (!FAQDB.get())
+    if (!FAQDB)
     {
         vector<string> empty;
         return empty;
     }
 
-    return _database_find_keys(FAQDB.get(), "^q.+", false);
+    return _database_find_keys(&FAQDB, "^q.+", false);
 }
 
 string getFAQ_Question(const string &key)
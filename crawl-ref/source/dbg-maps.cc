@@ -7,19 +7,30 @@
 
 #include "dbg-maps.h"
 
+#include <chrono>
+#ifdef UNIX
+#include <sys/resource.h>
+#endif
+
 #include "branch.h"
 #include "chardump.h"
+#include "clua.h"
 #include "crash.h"
 #include "dbg-objstat.h"
+#include "dlua.h"
 #include "dungeon.h"
 #include "env.h"
 #include "initfile.h"
+#include "json.h"
+#include "json-wrapper.h"
 #include "libutil.h"
 #include "maps.h"
 #include "message.h"
 #include "ng-init.h"
 #include "ng-setup.h"
+#include "options.h"
 #include "player.h"
+#include "random.h"
 #include "shopping.h"
 #include "state.h"
 #include "stringutil.h"
@@ -528,4 +539,274 @@ void mapstat_generate_stats()
     printf("Map stats complete.\n");
 }
 
+// Builder benchmark.
+
+struct bench_timing
+{
+    int count = 0;
+    double total_ms = 0;
+    double max_ms = 0;
+
+    void add(double ms)
+    {
+        ++count;
+        total_ms += ms;
+        max_ms = max(max_ms, ms);
+    }
+};
+
+struct bench_build
+{
+    double ms;
+    uint64_t seed;
+    level_id place;
+    string method;
+    int vetoes;
+};
+
+static bench_timing bench_stages[NUM_BUILDER_STAGES];
+static int bench_stage_depth[NUM_BUILDER_STAGES];
+static map<string, bench_timing> bench_vaults;
+static map<level_id, bench_timing> bench_levels;
+static map<string, bench_timing> bench_methods;
+// the slowest builder() calls, slowest first
+static vector<bench_build> bench_slowest;
+static const size_t BENCH_SLOWEST = 20;
+
+static const char *bench_stage_names[] =
+{
+    "builder", "build_level_vetoable", "vault", "place_minivaults",
+    "fixup_interlevel_connectivity",
+};
+COMPILE_CHECK(ARRAYSZ(bench_stage_names) == NUM_BUILDER_STAGES);
+
+static int64_t _bench_now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+builder_stage_timer::builder_stage_timer(builder_stage _stage,
+                                         const string &_what)
+    : stage(_stage), active(false), start_ns(0)
+{
+    if (!crawl_state.builder_bench || bench_stage_depth[stage]++)
+        return;
+    active = true;
+    what = _what;
+    start_ns = _bench_now_ns();
+}
+
+builder_stage_timer::~builder_stage_timer()
+{
+    if (!crawl_state.builder_bench)
+        return;
+    --bench_stage_depth[stage];
+    if (!active)
+        return;
+
+    const double ms = (_bench_now_ns() - start_ns) / 1000000.0;
+    bench_stages[stage].add(ms);
+    if (stage == BSTAGE_VAULT)
+        bench_vaults[what].add(ms);
+}
+
+static void _bench_record_build(uint64_t seed, double ms, int vetoes)
+{
+    const level_id place = level_id::current();
+    bench_levels[place].add(ms);
+    bench_methods[env.level_build_method].add(ms);
+
+    if (bench_slowest.size() == BENCH_SLOWEST
+        && ms <= bench_slowest.back().ms)
+    {
+        return;
+    }
+    if (bench_slowest.size() == BENCH_SLOWEST)
+        bench_slowest.pop_back();
+    bench_build build = { ms, seed, place, env.level_build_method, vetoes };
+    auto pos = find_if(bench_slowest.begin(), bench_slowest.end(),
+                       [ms](const bench_build &b) { return b.ms < ms; });
+    bench_slowest.insert(pos, build);
+}
+
+static JsonNode *_bench_timing_json(const bench_timing &t)
+{
+    JsonNode *node(json_mkobject());
+    json_append_member(node, "count", json_mknumber(t.count));
+    json_append_member(node, "total_ms", json_mknumber(t.total_ms));
+    json_append_member(node, "mean_ms",
+                       json_mknumber(t.count ? t.total_ms / t.count : 0));
+    json_append_member(node, "max_ms", json_mknumber(t.max_ms));
+    return node;
+}
+
+template<typename K>
+static JsonNode *_bench_timings_json(const map<K, bench_timing> &timings,
+                                     function<string(const K&)> name)
+{
+    // Costliest first.
+    vector<pair<string, const bench_timing*>> sorted;
+    for (const auto &entry : timings)
+        sorted.emplace_back(name(entry.first), &entry.second);
+    sort(sorted.begin(), sorted.end(),
+         [](const pair<string, const bench_timing*> &a,
+            const pair<string, const bench_timing*> &b)
+         { return a.second->total_ms > b.second->total_ms; });
+
+    JsonNode *node(json_mkarray());
+    for (const auto &entry : sorted)
+    {
+        JsonNode *timing = _bench_timing_json(*entry.second);
+        json_prepend_member(timing, "name", json_mkstring(entry.first));
+        json_append_element(node, timing);
+    }
+    return node;
+}
+
+static void _write_bench_stats()
+{
+    JsonWrapper json(json_mkobject());
+    json_append_member(json.node, "seed_first",
+                       json_mkstring(to_string(SysEnv.bench_seed_first)));
+    json_append_member(json.node, "seed_last",
+                       json_mkstring(to_string(SysEnv.bench_seed_last)));
+    json_append_member(json.node, "levels_tried", json_mknumber(levels_tried));
+    json_append_member(json.node, "levels_failed",
+                       json_mknumber(levels_failed));
+    json_append_member(json.node, "build_attempts",
+                       json_mknumber(build_attempts));
+    json_append_member(json.node, "vetoes", json_mknumber(level_vetoes));
+
+    JsonNode *stages(json_mkobject());
+    for (int i = 0; i < NUM_BUILDER_STAGES; ++i)
+    {
+        json_append_member(stages, bench_stage_names[i],
+                           _bench_timing_json(bench_stages[i]));
+    }
+    json_append_member(json.node, "stages", stages);
+
+    JsonNode *vetoes(json_mkobject());
+    for (const auto &entry : veto_messages)
+        json_append_member(vetoes, entry.first.c_str(),
+                           json_mknumber(entry.second));
+    json_append_member(json.node, "veto_reasons", vetoes);
+
+    JsonNode *chunks(json_mkobject());
+    json_append_member(chunks, "compiled",
+                       json_mknumber(CLua::chunks_compiled));
+    json_append_member(chunks, "cached", json_mknumber(CLua::chunks_cached));
+    json_append_member(json.node, "lua_chunks", chunks);
+
+    const dlua_memory_stats &lua_mem = dlua_memory();
+    JsonNode *memory(json_mkobject());
+    json_append_member(memory, "build_peak_kb",
+                       json_mknumber(lua_mem.build_peak / 1024));
+    json_append_member(memory, "released_kb",
+                       json_mknumber(lua_mem.released / 1024));
+    json_append_member(memory, "capped_builds",
+                       json_mknumber(lua_mem.capped_builds));
+    json_append_member(json.node, "lua_memory", memory);
+
+    json_append_member(json.node, "levels",
+        _bench_timings_json<level_id>(bench_levels,
+            [](const level_id &l) { return l.describe(); }));
+    json_append_member(json.node, "build_methods",
+        _bench_timings_json<string>(bench_methods,
+            [](const string &m) { return m.empty() ? "unknown" : m; }));
+    json_append_member(json.node, "vaults",
+        _bench_timings_json<string>(bench_vaults,
+            [](const string &v) { return v; }));
+
+    JsonNode *slowest(json_mkarray());
+    for (const bench_build &build : bench_slowest)
+    {
+        JsonNode *node(json_mkobject());
+        json_append_member(node, "ms", json_mknumber(build.ms));
+        json_append_member(node, "seed", json_mkstring(to_string(build.seed)));
+        json_append_member(node, "level",
+                           json_mkstring(build.place.describe()));
+        json_append_member(node, "build_method", json_mkstring(build.method));
+        json_append_member(node, "vetoes", json_mknumber(build.vetoes));
+        json_append_element(slowest, node);
+    }
+    json_append_member(json.node, "slowest_builds", slowest);
+
+#ifdef UNIX
+    // Linux reports this in kilobytes.
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage))
+    {
+        json_append_member(json.node, "peak_rss_kb",
+                           json_mknumber(usage.ru_maxrss));
+    }
+#endif
+
+    const char *out_file = "builder-bench.json";
+    FILE *outf = fopen_u(out_file, "w");
+    if (!outf)
+    {
+        printf("Can't write to %s.\n", out_file);
+        return;
+    }
+    printf("Writing builder stats to %s...\n", out_file);
+    fprintf(outf, "%s\n", json.to_string().c_str());
+    fclose(outf);
+}
+
+/**
+ * Run the builder over every selected level for each seed in the range set
+ * by -builder-bench, timing its stages, and write the results as JSON.
+ */
+void builder_bench_generate_stats()
+{
+    you.wizard = true;
+    you.species = SP_HUMAN;
+
+    initialise_item_descriptions();
+    initialise_branch_depths();
+
+    run_map_global_preludes();
+    run_map_local_preludes();
+
+    _dungeon_places();
+
+    printf("Benchmarking the builder on seeds %" PRIu64 "-%" PRIu64
+           " for %d level(s) over %d branch(es).\n",
+           SysEnv.bench_seed_first, SysEnv.bench_seed_last,
+           (int) generated_levels.size(), branch_count);
+    fflush(stdout);
+
+    for (uint64_t seed = SysEnv.bench_seed_first;
+         seed <= SysEnv.bench_seed_last && seed; ++seed)
+    {
+        printf("%" PRIu64 "..", seed);
+        fflush(stdout);
+
+        Options.seed = seed;
+        rng::reset();
+        dgn_reset_player_data();
+        initial_dungeon_setup();
+
+        for (const level_id &lid : generated_levels)
+        {
+            you.where_are_you = lid.branch;
+            you.depth = lid.depth;
+            watchdog();
+
+            const int vetoes = level_vetoes;
+            const int64_t start = _bench_now_ns();
+            ++levels_tried;
+            if (!builder())
+                ++levels_failed;
+            _bench_record_build(seed, (_bench_now_ns() - start) / 1000000.0,
+                                level_vetoes - vetoes);
+        }
+    }
+    printf("Finished.\n");
+
+    _write_bench_stats();
+    printf("Builder benchmark complete.\n");
+}
+
 #endif // DEBUG_STATISTICS
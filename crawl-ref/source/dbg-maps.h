@@ -17,4 +17,31 @@ void mapstat_report_map_veto(const string &message);
 void mapstat_generate_stats();
 bool mapstat_build_levels();
 bool mapstat_find_forced_map();
+
+// Builder stages timed by -builder-bench.
+enum builder_stage
+{
+    BSTAGE_BUILDER,       // builder(), including all retries
+    BSTAGE_LEVEL,         // _build_level_vetoable(), one attempt
+    BSTAGE_VAULT,         // _build_vault_impl()
+    BSTAGE_MINIVAULTS,    // _place_minivaults()
+    BSTAGE_CONNECTIVITY,  // _fixup_interlevel_connectivity()
+    NUM_BUILDER_STAGES
+};
+
+// Times a builder stage for the lifetime of the object, when running
+// -builder-bench. Nested timers of the same stage count only once.
+class builder_stage_timer
+{
+public:
+    builder_stage_timer(builder_stage stage, const string &what = "");
+    ~builder_stage_timer();
+private:
+    builder_stage stage;
+    string what;
+    bool active;
+    int64_t start_ns;
+};
+
+void builder_bench_generate_stats();
 #endif
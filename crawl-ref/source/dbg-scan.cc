@@ -330,6 +330,13 @@ void debug_mons_scan()
         ASSERT(m->mid > 0);
         coord_def pos = m->pos();
 
+        if (!binary_search(env.active_mons.begin(), env.active_mons.end(), i))
+        {
+            mprf(MSGCH_ERROR, "Monster missing from the active list: %s, "
+                              "midx = %d",
+                 m->full_name(DESC_PLAIN).c_str(), i);
+        }
+
         if (invalid_monster_type(m->type))
         {
             mprf(MSGCH_ERROR, "Bogus monster type %d at (%d, %d), midx = %d",
@@ -32,6 +32,23 @@ static dungeon_feature_type _pick_pseudorandom_wall(uint64_t val)
     return features[val%9];
 }
 
+void ProceduralLayout::row(const coord_def &p, int n, const uint32_t offset,
+                           vector<ProceduralSample> &out) const
+{
+    for (int i = 0; i < n; ++i)
+        out.push_back((*this)(coord_def(p.x + i, p.y), offset));
+}
+
+// Sample a row with layout's own operator(), called directly rather than
+// through the vtable.
+template<class L>
+static void _row_of(const L &layout, const coord_def &p, int n,
+                    const uint32_t offset, vector<ProceduralSample> &out)
+{
+    for (int i = 0; i < n; ++i)
+        out.push_back(layout.L::operator()(coord_def(p.x + i, p.y), offset));
+}
+
 ProceduralSample
 ColumnLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -46,6 +63,12 @@ ColumnLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, DNGN_FLOOR, offset + 4096);
 }
 
+void ColumnLayout::row(const coord_def &p, int n, const uint32_t offset,
+                       vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
 ProceduralSample
 DiamondLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -61,13 +84,21 @@ DiamondLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, DNGN_FLOOR, offset + 4096);
 }
 
+void DiamondLayout::row(const coord_def &p, int n, const uint32_t offset,
+                        vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
 static uint32_t _get_changepoint(const worley::noise_datum &n, const double scale)
 {
     return max(1, (int) floor((n.distance[1] - n.distance[0]) * scale) - 5);
 }
 
-ProceduralSample
-WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
+// Pick the layout to hand p on to, and the point to hand on in its place.
+const ProceduralLayout &
+WorleyLayout::_choose(const coord_def &p, const uint32_t offset,
+                      coord_def &pd, uint32_t &changepoint) const
 {
     const double offset_scale = 5000.0;
     double x = p.x / scale;
@@ -75,20 +106,76 @@ WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
     double z = offset / offset_scale;
     worley::noise_datum n = worley::noise(x, y, z + seed);
 
-    const uint32_t changepoint = offset + _get_changepoint(n, offset_scale);
+    changepoint = offset + _get_changepoint(n, offset_scale);
     const uint8_t size = layouts.size();
     bool parity = n.id[0] % 4;
     uint32_t id = n.id[0] / 4;
     const uint8_t choice = parity
         ? id % size
         : min(id % size, (id / size) % size);
-    const coord_def pd = p + id;
-    ProceduralSample sample = (*layouts[(choice + seed) % size])(pd, offset);
+    pd = p + id;
+    return *layouts[(choice + seed) % size];
+}
+
+ProceduralSample
+WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
+{
+    coord_def pd;
+    uint32_t changepoint;
+    const ProceduralLayout &layout = _choose(p, offset, pd, changepoint);
+    ProceduralSample sample = layout(pd, offset);
 
     return ProceduralSample(p, sample.feat(),
                 min(changepoint, sample.changepoint()));
 }
 
+void WorleyLayout::row(const coord_def &p, int n, const uint32_t offset,
+                       vector<ProceduralSample> &out) const
+{
+    // Neighbouring cells mostly share a feature point, and so go to the same
+    // layout, shifted by the same amount: hand those on as one row. Work
+    // along the row a few cells at a time, so as to keep what is picked for
+    // each on the stack.
+    const int chunk = 16;
+    const ProceduralLayout *chosen[chunk];
+    coord_def shifted[chunk];
+    uint32_t changepoints[chunk];
+
+    for (int done = 0; done < n; done += chunk)
+    {
+        const int len = min(chunk, n - done);
+        for (int i = 0; i < len; ++i)
+        {
+            chosen[i] = &_choose(coord_def(p.x + done + i, p.y), offset,
+                                 shifted[i], changepoints[i]);
+        }
+
+        for (int start = 0, end; start < len; start = end)
+        {
+            for (end = start + 1; end < len; ++end)
+            {
+                if (chosen[end] != chosen[start]
+                    || shifted[end] != shifted[start]
+                                       + coord_def(end - start, 0))
+                {
+                    break;
+                }
+            }
+
+            const size_t first = out.size() - start;
+            chosen[start]->row(shifted[start], end - start, offset, out);
+            for (int i = start; i < end; ++i)
+            {
+                const ProceduralSample &sample = out[first + i];
+                out[first + i] =
+                    ProceduralSample(coord_def(p.x + done + i, p.y),
+                                     sample.feat(),
+                                     min(changepoints[i], sample.changepoint()));
+            }
+        }
+    }
+}
+
 ProceduralSample
 ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -99,6 +186,12 @@ ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, DNGN_FLOOR, offset + 4096);
 }
 
+void ChaosLayout::row(const coord_def &p, int n, const uint32_t offset,
+                      vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
 ProceduralSample
 RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -112,6 +205,12 @@ RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, sample.feat(), min(sample.changepoint(), changepoint));
 }
 
+void RoilingChaosLayout::row(const coord_def &p, int n, const uint32_t offset,
+                             vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
 ProceduralSample
 WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -126,32 +225,71 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, min(sample.changepoint(), changepoint));
 }
 
-ProceduralSample
-RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
+void WastesLayout::row(const coord_def &p, int n, const uint32_t offset,
+                       vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
+// Whether p is in a river, and if so what's there and until when.
+bool RiverLayout::_river(const coord_def &p, const uint32_t offset,
+                         dungeon_feature_type &feat,
+                         uint32_t &changepoint) const
 {
     const double scale = 10000;
     const double scalar = 90.0;
     double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
     double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
     worley::noise_datum n = worley::noise(x, y, offset / scale + seed);
-    const uint32_t changepoint = offset + _get_changepoint(n, scale);
+    changepoint = offset + _get_changepoint(n, scale);
     if ((n.id[0] ^ n.id[1] ^ seed) % 4)
-        return layout(p, offset);
+        return false;
 
     double delta = n.distance[1] - n.distance[0];
     if (delta < 1.5/scalar)
     {
-        dungeon_feature_type feat = DNGN_SHALLOW_WATER;
+        feat = DNGN_SHALLOW_WATER;
         uint64_t hash = hash3(p.x, p.y, n.id[0] + seed);
         if (!(hash % 5))
             feat = DNGN_DEEP_WATER;
         if (!(hash % 23))
             feat = DNGN_TREE;
-        return ProceduralSample(p, feat, changepoint);
+        return true;
     }
+    return false;
+}
+
+ProceduralSample
+RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
+{
+    dungeon_feature_type feat;
+    uint32_t changepoint;
+    if (_river(p, offset, feat, changepoint))
+        return ProceduralSample(p, feat, changepoint);
     return layout(p, offset);
 }
 
+void RiverLayout::row(const coord_def &p, int n, const uint32_t offset,
+                      vector<ProceduralSample> &out) const
+{
+    // Hand on the runs of cells between rivers.
+    int start = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const coord_def c(p.x + i, p.y);
+        dungeon_feature_type feat;
+        uint32_t changepoint;
+        if (!_river(c, offset, feat, changepoint))
+            continue;
+        if (start < i)
+            layout.row(coord_def(p.x + start, p.y), i - start, offset, out);
+        out.emplace_back(c, feat, changepoint);
+        start = i + 1;
+    }
+    if (start < n)
+        layout.row(coord_def(p.x + start, p.y), n - start, offset, out);
+}
+
 ProceduralSample
 NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -182,6 +320,12 @@ NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + delta);
 }
 
+void NewAbyssLayout::row(const coord_def &p, int n, const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    _row_of(*this, p, n, offset, out);
+}
+
 dungeon_feature_type sanitize_feature(dungeon_feature_type feature, bool strict)
 {
     if (feat_is_gate(feature)
@@ -294,6 +438,26 @@ LevelLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + 4096);
 }
 
+void LevelLayout::row(const coord_def &p, int n, const uint32_t offset,
+                      vector<ProceduralSample> &out) const
+{
+    // Hand on the runs of cells the level doesn't cover.
+    int start = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const coord_def c(p.x + i, p.y);
+        dungeon_feature_type feat = grid(clip(c));
+        if (feat == DNGN_UNSEEN)
+            continue;
+        if (start < i)
+            layout.row(coord_def(p.x + start, p.y), i - start, offset, out);
+        out.emplace_back(c, feat, offset + 4096);
+        start = i + 1;
+    }
+    if (start < n)
+        layout.row(coord_def(p.x + start, p.y), n - start, offset, out);
+}
+
 ProceduralSample
 NoiseLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
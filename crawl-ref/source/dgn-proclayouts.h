@@ -58,6 +58,13 @@ class ProceduralLayout
     public:
         virtual ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const = 0;
+        // Appends the samples for the n cells eastwards from p to out, the
+        // same ones operator() gives for each. Layouts which hand cells on to
+        // other layouts override this to hand them on a run at a time, and
+        // the ones they hand on to override it to loop without a virtual
+        // call per cell.
+        virtual void row(const coord_def &p, int n, const uint32_t offset,
+                         vector<ProceduralSample> &out) const;
         virtual ~ProceduralLayout() { }
 };
 
@@ -77,6 +84,8 @@ class ColumnLayout : public ProceduralLayout
 
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         int _col_width, _col_space, _row_width, _row_space;
 };
@@ -87,6 +96,8 @@ class DiamondLayout : public ProceduralLayout
         DiamondLayout(int _w, int _s) : w(_w) , s(_s) { }
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         uint32_t w, s;
 };
@@ -101,7 +112,13 @@ class WorleyLayout : public ProceduralLayout
             seed(_seed), layouts(_layouts), scale(_scale) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
+        const ProceduralLayout &_choose(const coord_def &p,
+            const uint32_t offset, coord_def &pd,
+            uint32_t &changepoint) const;
+
         const uint32_t seed;
         const vector<const ProceduralLayout*> layouts;
         const float scale;
@@ -120,6 +137,8 @@ class ChaosLayout : public ProceduralLayout
             seed(_seed), baseDensity(_density) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
         const uint32_t baseDensity;
@@ -133,6 +152,8 @@ class RoilingChaosLayout : public ProceduralLayout
             seed(_seed), density(_density) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
         const uint32_t density;
@@ -145,6 +166,8 @@ class WastesLayout : public ProceduralLayout
         WastesLayout() { };
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
 };
 
 class RiverLayout : public ProceduralLayout
@@ -154,7 +177,12 @@ class RiverLayout : public ProceduralLayout
             seed(_seed), layout(_layout) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
+        bool _river(const coord_def &p, const uint32_t offset,
+            dungeon_feature_type &feat, uint32_t &changepoint) const;
+
         const uint32_t seed;
         const ProceduralLayout &layout;
 };
@@ -166,6 +194,8 @@ class NewAbyssLayout : public ProceduralLayout
         NewAbyssLayout(uint32_t _seed) : seed(_seed) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         const uint32_t seed;
 };
@@ -179,6 +209,8 @@ class LevelLayout : public ProceduralLayout
             const ProceduralLayout &_layout);
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void row(const coord_def &p, int n, const uint32_t offset,
+                 vector<ProceduralSample> &out) const override;
     private:
         feature_grid grid;
         uint32_t seed;
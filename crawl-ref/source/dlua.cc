@@ -10,6 +10,7 @@
 #include <sstream>
 
 #include "l-libs.h"
+#include "mpr.h"
 #include "stringutil.h"
 
 static int dlua_compiled_chunk_writer(lua_State *ls, const void *p,
@@ -162,20 +163,8 @@ int dlua_chunk::load(CLua &interp)
         return E_CHUNK_LOAD_FAILURE;
     }
 
-    int err = check_op(interp,
-                        interp.loadstring(chunk.c_str(), context.c_str()));
-    if (err)
-        return err;
-    ostringstream out;
-    err = lua_dump(interp, dlua_compiled_chunk_writer, &out);
-    if (err)
-    {
-        const char *e = lua_tostring(interp, -1);
-        error = e? e : "Unknown error compiling chunk";
-        lua_pop(interp, 2);
-    }
-    compiled = out.str();
-    return err;
+    return check_op(interp,
+                    interp.loadcached(chunk, context.c_str(), &compiled));
 }
 
 int dlua_chunk::run(CLua &interp)
@@ -274,6 +263,237 @@ string dlua_chunk::get_chunk_prefix(const string &sorig) const
     return rewrite_chunk_prefix(sorig, true);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// The dungeon builder's allocator
+//
+// Small blocks come from pages of same-sized blocks. Pages filled during a
+// level build are kept apart from the rest, so once the build's garbage is
+// collected they are usually empty and can be freed whole, instead of
+// leaving the process holding scattered free blocks. Large blocks go
+// straight to malloc.
+
+static const size_t POOL_GRAIN = 16;
+static const int POOL_CLASSES = 16;
+static const size_t POOL_PAGE_SIZE = 64 * 1024;
+
+struct pool_page
+{
+    char *mem;
+    int cls;
+    // Blocks handed out, and blocks ever handed out.
+    unsigned live, used;
+    // Blocks handed back, linked through their first word.
+    void *free;
+    // Whether the page belongs to the current level build.
+    bool temp;
+    // Whether the page is in its generation's list of pages with room.
+    bool listed;
+};
+
+struct dlua_pool
+{
+    map<const char *, pool_page *> pages;
+    vector<pool_page *> room[2][POOL_CLASSES];
+    int build_depth = 0;
+    size_t build_start = 0;
+    bool capped = false;
+    dlua_memory_stats stats;
+};
+
+// Never destroyed, as the Lua state may be closed after static destructors
+// have run.
+static dlua_pool &_pool()
+{
+    static dlua_pool *pool = new dlua_pool;
+    return *pool;
+}
+
+const dlua_memory_stats &dlua_memory()
+{
+    return _pool().stats;
+}
+
+static int _size_class(size_t size)
+{
+    return size <= POOL_GRAIN * POOL_CLASSES ? (size - 1) / POOL_GRAIN : -1;
+}
+
+static unsigned _page_blocks(int cls)
+{
+    return POOL_PAGE_SIZE / ((cls + 1) * POOL_GRAIN);
+}
+
+static bool _page_has_room(const pool_page *page)
+{
+    return page->free || page->used < _page_blocks(page->cls);
+}
+
+static void *_pool_alloc(dlua_pool &pool, int cls)
+{
+    vector<pool_page *> &room = pool.room[pool.build_depth > 0][cls];
+    while (!room.empty() && !_page_has_room(room.back()))
+    {
+        room.back()->listed = false;
+        room.pop_back();
+    }
+
+    if (room.empty())
+    {
+        char *mem = static_cast<char *>(malloc(POOL_PAGE_SIZE));
+        if (!mem)
+            return nullptr;
+        pool_page *page = new pool_page;
+        page->mem = mem;
+        page->cls = cls;
+        page->live = page->used = 0;
+        page->free = nullptr;
+        page->temp = pool.build_depth > 0;
+        page->listed = true;
+        pool.pages[mem] = page;
+        room.push_back(page);
+    }
+
+    pool_page *page = room.back();
+    void *block;
+    if (page->free)
+    {
+        block = page->free;
+        page->free = *static_cast<void **>(block);
+    }
+    else
+        block = page->mem + page->used++ * (cls + 1) * POOL_GRAIN;
+    page->live++;
+    return block;
+}
+
+static void _pool_free(dlua_pool &pool, void *ptr, size_t size)
+{
+    const int cls = _size_class(size);
+    if (cls < 0)
+    {
+        free(ptr);
+        return;
+    }
+
+    auto it = pool.pages.upper_bound(static_cast<char *>(ptr));
+    ASSERT(it != pool.pages.begin());
+    pool_page *page = (--it)->second;
+    *static_cast<void **>(ptr) = page->free;
+    page->free = ptr;
+    page->live--;
+    if (!page->listed)
+    {
+        pool.room[page->temp][cls].push_back(page);
+        page->listed = true;
+    }
+}
+
+void *dlua_allocator(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    dlua_pool &pool = _pool();
+    if (!ptr)
+        osize = 0;
+
+    // As with clua, only refuse memory to Lua code, which can handle it.
+    const CLua *lua = static_cast<const CLua *>(ud);
+    if (nsize > osize && pool.build_depth && lua->mixed_call_depth
+        && pool.stats.in_use + nsize - osize
+           > pool.build_start + DLUA_BUILD_MAX_MEMORY)
+    {
+        pool.capped = true;
+        return nullptr;
+    }
+
+    void *block = nullptr;
+    if (!nsize)
+    {
+        if (ptr)
+            _pool_free(pool, ptr, osize);
+    }
+    else
+    {
+        const int ncls = _size_class(nsize);
+        const int ocls = ptr ? _size_class(osize) : ncls;
+        if (ptr && ocls == ncls && ncls >= 0)
+            block = ptr;
+        else if (ptr && ocls < 0 && ncls < 0)
+            block = realloc(ptr, nsize);
+        else
+        {
+            block = ncls >= 0 ? _pool_alloc(pool, ncls) : malloc(nsize);
+            if (block && ptr)
+            {
+                memcpy(block, ptr, min(osize, nsize));
+                _pool_free(pool, ptr, osize);
+            }
+        }
+        if (!block)
+            return nullptr;
+    }
+
+    pool.stats.in_use += nsize - osize;
+    if (pool.build_depth)
+        pool.stats.build_peak = max(pool.stats.build_peak, pool.stats.in_use);
+    return block;
+}
+
+dlua_build_arena::dlua_build_arena()
+{
+    dlua_pool &pool = _pool();
+    if (pool.build_depth++)
+        return;
+    pool.build_start = pool.stats.in_use;
+    pool.capped = false;
+}
+
+dlua_build_arena::~dlua_build_arena()
+{
+    dlua_pool &pool = _pool();
+    if (--pool.build_depth)
+        return;
+
+    // Collect the build's garbage, so that its pages can go in one piece.
+    lua_gc(dlua, LUA_GCCOLLECT, 0);
+
+    size_t released = 0;
+    for (auto it = pool.pages.begin(); it != pool.pages.end();)
+    {
+        pool_page *page = it->second;
+        if (page->temp && !page->live)
+        {
+            free(page->mem);
+            delete page;
+            it = pool.pages.erase(it);
+            released += POOL_PAGE_SIZE;
+        }
+        else
+        {
+            page->temp = false;
+            ++it;
+        }
+    }
+
+    for (auto &room : pool.room)
+        for (vector<pool_page *> &pages : room)
+            pages.clear();
+    for (const auto &entry : pool.pages)
+    {
+        pool_page *page = entry.second;
+        page->listed = _page_has_room(page);
+        if (page->listed)
+            pool.room[false][page->cls].push_back(page);
+    }
+
+    pool.stats.released += released;
+    pool.stats.builds++;
+    if (pool.capped)
+        pool.stats.capped_builds++;
+    dprf(DIAG_DNGN, "Level build Lua memory: %u KB in use, %u KB released%s",
+         (unsigned int)(pool.stats.in_use / 1024),
+         (unsigned int)(released / 1024),
+         pool.capped ? " (capped)" : "");
+}
+
 static void _dlua_register_constants(CLua &lua)
 {
     lua_pushstring(lua, CORPSE_NEVER_DECAYS);
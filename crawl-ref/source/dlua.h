@@ -72,4 +72,33 @@ public:
     void read(reader&);
 };
 
+// Lua memory a level build may take on top of what was in use before it.
+const size_t DLUA_BUILD_MAX_MEMORY = 128 * 1024 * 1024;
+
+struct dlua_memory_stats
+{
+    size_t in_use = 0;
+    // The most in use during any level build.
+    size_t build_peak = 0;
+    // Handed back at the end of level builds.
+    size_t released = 0;
+    int builds = 0;
+    // Builds that ran into DLUA_BUILD_MAX_MEMORY.
+    int capped_builds = 0;
+};
+
+const dlua_memory_stats &dlua_memory();
+
+// While one of these exists, the dungeon builder's Lua allocates apart from
+// its longer-lived data, and the memory is handed back in bulk once it's
+// gone. Survivors of the build join the long-lived data.
+class dlua_build_arena
+{
+public:
+    dlua_build_arena();
+    ~dlua_build_arena();
+};
+
+void *dlua_allocator(void *ud, void *ptr, size_t osize, size_t nsize);
+
 void init_dungeon_lua();
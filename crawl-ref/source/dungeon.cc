@@ -290,6 +290,10 @@ bool builder(bool enable_random_maps)
     ASSERT_RANGE(you.where_are_you, 0, NUM_BRANCHES);
     ASSERT_RANGE(you.depth, 0 + 1, brdepth[you.where_are_you] + 1);
 
+#ifdef DEBUG_STATISTICS
+    builder_stage_timer timer(BSTAGE_BUILDER);
+#endif
+
     const set<string> uniq_tags = get_uniq_map_tags();
     const set<string> uniq_names = get_uniq_map_names();
 
@@ -459,7 +463,10 @@ static bool _build_level_vetoable(bool enable_random_maps)
 {
 #ifdef DEBUG_STATISTICS
     mapstat_report_map_build_start();
+    builder_stage_timer timer(BSTAGE_LEVEL);
 #endif
+    // Hand back the Lua memory of this attempt, whether vetoed or not.
+    dlua_build_arena arena;
 
     dgn_reset_level(enable_random_maps);
 
@@ -3369,6 +3376,9 @@ static void _place_chance_vaults()
 
 static void _place_minivaults()
 {
+#ifdef DEBUG_STATISTICS
+    builder_stage_timer timer(BSTAGE_MINIVAULTS);
+#endif
     const map_def *vault = nullptr;
     // First place the vault requested with &P
     if (you.props.exists(FORCE_MINIVAULT_KEY)
@@ -4334,6 +4344,10 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
                   bool build_only, bool check_collisions,
                   bool make_no_exits, const coord_def &where)
 {
+#ifdef DEBUG_STATISTICS
+    builder_stage_timer timer(BSTAGE_VAULT, vault->name);
+#endif
+
     if (dgn_check_connectivity && !dgn_zones)
     {
         dgn_zones = dgn_count_disconnected_zones(false);
@@ -6525,6 +6539,9 @@ void write_level_connectivity(writer &th)
 
 static bool _fixup_interlevel_connectivity()
 {
+#ifdef DEBUG_STATISTICS
+    builder_stage_timer timer(BSTAGE_CONNECTIVITY);
+#endif
     // Rotate the stairs on this level to attempt to preserve connectivity
     // as much as possible. At a minimum, it ensures a path from the bottom
     // of a branch to the top of a branch. If this is not possible, it
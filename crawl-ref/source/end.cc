@@ -11,6 +11,7 @@
 
 #include "abyss.h"
 #include "chardump.h"
+#include "clua.h"
 #include "colour.h"
 #include "crash.h"
 #include "database.h"
@@ -174,6 +175,10 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
         tiles.shutdown();
 #endif
 
+        // Not after a failure, which could have left chunks half-loaded.
+        if (!exit_code)
+            CLua::save_chunk_cache();
+
         cio_cleanup();
         msg::deinitialise_mpr_streams();
         _clear_globals_on_exit();
@@ -33,14 +33,16 @@ struct crawl_environment
     FixedVector< item_def, MAX_ITEMS >       item;  // item list
     FixedVector< monster, MAX_MONSTERS+2 >   mons;  // monster list, plus anon
 
-    // Highest index into mons that might currently contain a real monster.
-    // This is incremented by 1 whenever get_free_monster() is called and
-    // reduced to the current highest index whenever clear_monster_flags() is
-    // called each turn.
+    // Indices into mons, in ascending order, of every slot that might
+    // currently contain a real monster. A slot is added whenever
+    // get_free_monster() hands it out or a level is loaded, and slots that
+    // have been emptied are dropped whenever clear_monster_flags() is called
+    // each turn.
     //
-    // This is used only as a small optimisation for monster_iterator and is
-    // completely safe if it's an overestimate - just not an underestimate.
-    int                             max_mon_index;
+    // monster_iterator and the near iterators walk this instead of all of
+    // mons. It's completely safe for it to hold slots that are no longer in
+    // use - just not to miss one that is.
+    vector<int>                     active_mons;
 
     feature_grid                             grid;  // terrain grid
     FixedArray<terrain_property_t, GXM, GYM> pgrid; // terrain properties
@@ -70,7 +72,7 @@ struct crawl_environment
 
     vector<coord_def>                        travel_trail;
 
-    map<coord_def, cloud_struct> cloud;
+    cloud_store cloud;
 
     map<coord_def, shop_struct> shop; // shop list
     map<coord_def, trap_def> trap; // trap list
@@ -70,6 +70,7 @@
 #include "message.h"
 #include "mon-behv.h"
 #include "mon-death.h"
+#include "mon-pathfind.h"
 #include "mon-place.h"
 #include "nearby-danger.h"
 #include "notes.h"
@@ -1808,6 +1809,11 @@ bool pregen_dungeon(const level_id &stopping_point)
         ui::progress_popup progress("Generating dungeon...\n\n", 35);
         progress.advance_progress();
 
+        // Levels are built one at a time, as each may depend on what the
+        // previous ones placed (uniques, artefacts, vault tags); but each
+        // saved level can be compressed while the next one is being built.
+        you.save->compress_in_background(true);
+        bool generated = true;
         for (const level_id &new_level : to_generate)
         {
             string status = "\nbuilding ";
@@ -1820,10 +1826,14 @@ bool pregen_dungeon(const level_id &stopping_point)
 
             // (save chunk existence is checked above, so isn't relevant here)
             if (!generate_level(new_level))
-                return false; // level failed to generate -- bail immediately
+            {
+                generated = false; // level failed to generate -- bail
+                break;
+            }
         }
+        you.save->compress_in_background(false);
 
-        return true;
+        return generated;
     }
 }
 
@@ -2070,6 +2080,7 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
     env.final_effect_monster_cache.clear();
 
     los_changed();
+    invalidate_player_flows();
 
     if (load_mode != LOAD_VISITOR)
         you.set_level_visited(level_id::current());
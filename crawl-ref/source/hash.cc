@@ -54,6 +54,20 @@ uint32_t hash32(const void *data, int len)
     return h;
 }
 
+// FNV-1a. Pass the result of an earlier call as hash to continue it.
+uint64_t hash64(const void *data, size_t len, uint64_t hash)
+{
+    if (!hash)
+        hash = 0xcbf29ce484222325ULL;
+    const uint8_t *d = (const uint8_t*)data;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= d[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 unsigned int hash_with_seed(int x, uint32_t seed, uint32_t id)
 {
     if (x < 2)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "macros.h"
@@ -20,4 +21,5 @@ static inline uint64_t hash3(uint64_t x, uint64_t y, uint64_t z)
 }
 
 uint32_t hash32(const void *data, int len) PURE;
+uint64_t hash64(const void *data, size_t len, uint64_t hash = 0) PURE;
 unsigned int hash_with_seed(int x, uint32_t seed, uint32_t id = 0);
@@ -4616,6 +4616,7 @@ enum commandline_option_type
     CLO_MAPSTAT,
     CLO_MAPSTAT_DUMP_DISCONNECT,
     CLO_OBJSTAT,
+    CLO_BUILDER_BENCH,
     CLO_ITERATIONS,
     CLO_FORCE_MAP,
     CLO_ARENA,
@@ -4677,6 +4678,7 @@ static set<commandline_option_type> clo_headless_ok = {
     CLO_MAPSTAT,
     CLO_MAPSTAT_DUMP_DISCONNECT,
     CLO_OBJSTAT,
+    CLO_BUILDER_BENCH,
 #ifndef USE_TILE_LOCAL
 // TODO: still too crashy in local tiles to enable
     CLO_RC,
@@ -4697,8 +4699,9 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
-    "builddb", "help", "version", "seed", "pregen", "save-version", "sprint",
+    "objstat", "builder-bench", "iters", "force-map", "arena", "dump-maps",
+    "test", "script", "builddb", "help", "version", "seed", "pregen",
+    "save-version", "sprint",
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save",
     "no-player-bones", "gdb", "no-gdb", "nogdb", "throttle", "no-throttle",
@@ -5508,8 +5511,8 @@ bool parse_args(int argc, char **argv, bool rc_only)
     COMPILE_CHECK(ARRAYSZ(cmd_ops) == CLO_NOPS);
 
 #ifndef DEBUG_STATISTICS
-    const char *dbg_stat_err = "mapstat and objstat are available only in "
-                               "DEBUG_STATISTICS builds.\n";
+    const char *dbg_stat_err = "mapstat, objstat and builder-bench are "
+                               "available only in DEBUG_STATISTICS builds.\n";
 #endif
 
     if (crawl_state.command_line_arguments.empty())
@@ -5686,6 +5689,51 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #else
             end(1, false, "%s", dbg_stat_err);
 #endif
+        case CLO_BUILDER_BENCH:
+#ifdef DEBUG_STATISTICS
+            crawl_state.builder_bench = true;
+            enter_headless_mode();
+
+            if (next_is_param)
+            {
+                // <first>[-<last>]; 0 would mean a random seed.
+                const int found = sscanf(next_arg, "%" SCNu64 "-%" SCNu64,
+                                         &SysEnv.bench_seed_first,
+                                         &SysEnv.bench_seed_last);
+                if (found == 1)
+                    SysEnv.bench_seed_last = SysEnv.bench_seed_first;
+                if (found < 1 || !SysEnv.bench_seed_first
+                    || SysEnv.bench_seed_last < SysEnv.bench_seed_first)
+                {
+                    end(1, false, "Bad seed range for -%s: %s\n", arg,
+                        next_arg);
+                }
+                nextUsed = true;
+
+                // An optional range of levels follows, as for -mapstat.
+                const char *levels = current + 2 < argc ? argv[current + 2]
+                                                        : nullptr;
+                if (levels && levels[0] != '-')
+                {
+                    SysEnv.map_gen_range.reset(new depth_ranges);
+                    try
+                    {
+                        *SysEnv.map_gen_range =
+                            depth_ranges::parse_depth_ranges(levels);
+                    }
+                    catch (const bad_level_id &err)
+                    {
+                        end(1, false, "Error parsing depths: %s\n",
+                            err.what());
+                    }
+                    current++;
+                }
+            }
+            break;
+#else
+            end(1, false, "%s", dbg_stat_err);
+#endif
+
         case CLO_MAPSTAT_DUMP_DISCONNECT:
 #ifdef DEBUG_STATISTICS
             crawl_state.map_stat_dump_disconnect = true;
@@ -62,6 +62,9 @@ public:
 
     int map_gen_iters;
     unique_ptr<depth_ranges> map_gen_range;
+    // Game seeds to build levels with for -builder-bench, inclusive.
+    uint64_t bench_seed_first = 1;
+    uint64_t bench_seed_last = 100;
 
     vector<string> extra_opts_first;
     vector<string> extra_opts_last;
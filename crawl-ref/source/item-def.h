@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include "artefact-prop-type.h"
 #include "description-level-type.h"
+#include "fixedvector.h"
 #include "level-id.h"
 #include "monster-type.h"
 #include "object-class-type.h"
@@ -81,12 +83,20 @@ struct item_def
 
     CrawlHashTable props;
 
+    /// Artefact properties, indexed by artefact_prop_type. Only meaningful
+    /// if has_artprops is set; mutable unrandarts without stored properties
+    /// read theirs from the unrandart table instead. Saved as the
+    /// ARTEFACT_PROPS_KEY vector in props (see marshallItem()).
+    FixedVector<short, ARTP_NUM_PROPERTIES> artprops;
+    bool has_artprops;
+
 public:
     item_def() : base_type(OBJ_UNASSIGNED), sub_type(0), plus(0), plus2(0),
                  special(0), rnd(0), quantity(0), flags(0),
                  pos(), link(NON_ITEM), slot(0), orig_place(),
-                 orig_monnum(0), inscription()
+                 orig_monnum(0), inscription(), has_artprops(false)
     {
+        artprops.init(0);
     }
 
     string name(description_level_type descrip, bool terse = false,
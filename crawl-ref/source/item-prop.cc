@@ -1229,6 +1229,9 @@ bool set_item_ego_type(item_def &item, object_class_type item_type,
     if (item.base_type == item_type && !is_artefact(item))
     {
         item.brand = ego_type;
+        // Keep the player's cached ego counts in step with their gear.
+        if (in_inventory(item) && item_is_equipped(item))
+            you.equipment.update();
         return true;
     }
 
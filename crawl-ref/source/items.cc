@@ -385,6 +385,7 @@ bool dec_inv_item_quantity(int obj, int amount)
         you.inv[obj].base_type = OBJ_UNASSIGNED;
         you.inv[obj].quantity  = 0;
         you.inv[obj].props.clear();
+        you.inv[obj].has_artprops = false;
 
         ret = true;
 
@@ -581,6 +582,7 @@ void unlink_item(int dest)
     env.item[dest].link      = NON_ITEM;
     env.item[dest].pos.reset();
     env.item[dest].props.clear();
+    env.item[dest].has_artprops = false;
 
     // Look through all items for links to this item.
     for (auto &item : env.item)
@@ -15,6 +15,7 @@
 #include "files.h"
 #include "god-wrath.h"
 #include "los.h"
+#include "losglobal.h"
 #include "maps.h"
 #include "message.h"
 #include "mon-act.h"
@@ -119,6 +120,41 @@ LUAFN(debug_reveal_mimics)
 
 LUAWRAP(debug_los_changed, los_changed())
 
+// Usage: los_engine(<"raycast"|"bitboard">)
+// Returns the current losight() engine, switching to the given one first.
+LUAFN(debug_los_engine)
+{
+    if (lua_isstring(ls, 1))
+    {
+        const string engine = lua_tostring(ls, 1);
+        if (engine == "raycast")
+            set_los_engine(los_engine_type::raycast);
+        else if (engine == "bitboard")
+            set_los_engine(los_engine_type::bitboard);
+        else
+            luaL_argerror(ls, 1, ("unknown LOS engine: " + engine).c_str());
+    }
+    PLUARET(string, get_los_engine() == los_engine_type::raycast
+                    ? "raycast" : "bitboard");
+}
+
+// Usage: bytes_ns, packed_ns, bytes_size, packed_size
+//            = los_cache_benchmark(<rounds>)
+// Times lookups in the two layouts of the global LOS cache, and gives
+// their sizes in bytes.
+LUAFN(debug_los_cache_benchmark)
+{
+    const int rounds = lua_isnumber(ls, 1) ? luaL_safe_checkint(ls, 1) : 100;
+    double bytes_ns, packed_ns;
+    size_t bytes_size, packed_size;
+    los_cache_benchmark(rounds, bytes_ns, packed_ns, bytes_size, packed_size);
+    lua_pushnumber(ls, bytes_ns);
+    lua_pushnumber(ls, packed_ns);
+    lua_pushnumber(ls, bytes_size);
+    lua_pushnumber(ls, packed_size);
+    return 4;
+}
+
 LUAFN(debug_builder_ignore_depth)
 {
     const bool b = lua_toboolean(ls, 1);
@@ -341,6 +377,57 @@ LUAFN(debug_check_uniques)
     return 1;
 }
 
+// Compare what monster_iterator and monster_near_iterator visit with a scan
+// of all of env.mons.
+static bool _check_monster_iterators()
+{
+    vector<int> all, near;
+    for (int i = 0; i < MAX_MONSTERS; ++i)
+    {
+        if (!env.mons[i].alive())
+            continue;
+        all.push_back(i);
+        if (cell_see_cell(you.pos(), env.mons[i].pos(), LOS_DEFAULT))
+            near.push_back(i);
+    }
+
+    vector<int> iterated, iterated_near;
+    for (monster_iterator mi; mi; ++mi)
+        iterated.push_back(mi->mindex());
+    for (monster_near_iterator mi(you.pos()); mi; ++mi)
+        iterated_near.push_back(mi->mindex());
+
+    bool ret = true;
+    if (iterated != all)
+    {
+        mprf(MSGCH_ERROR, "monster_iterator visited %u monsters, "
+                          "env.mons holds %u",
+             (unsigned int)iterated.size(), (unsigned int)all.size());
+        ret = false;
+    }
+    if (iterated_near != near)
+    {
+        mprf(MSGCH_ERROR, "monster_near_iterator visited %u monsters, "
+                          "%u are in view",
+             (unsigned int)iterated_near.size(), (unsigned int)near.size());
+        ret = false;
+    }
+    return ret;
+}
+
+LUAFN(debug_check_monster_iterator)
+{
+    lua_pushboolean(ls, _check_monster_iterators());
+    return 1;
+}
+
+LUAFN(debug_clear_monster_flags)
+{
+    UNUSED(ls);
+    clear_monster_flags();
+    return 0;
+}
+
 LUAFN(debug_viewwindow)
 {
     viewwindow(lua_toboolean(ls, 1));
@@ -480,6 +567,8 @@ const struct luaL_reg debug_dlib[] =
 { "generate_level", debug_generate_level },
 { "reveal_mimics", debug_reveal_mimics },
 { "los_changed", debug_los_changed },
+{ "los_cache_benchmark", debug_los_cache_benchmark },
+{ "los_engine", debug_los_engine },
 { "dump_map", debug_dump_map },
 { "vault_names", debug_vault_names },
 { "test_explore", _debug_test_explore },
@@ -493,6 +582,8 @@ const struct luaL_reg debug_dlib[] =
 { "randomize_uniques", debug_randomize_uniques },
 { "reset_uniques", debug_reset_uniques },
 { "check_uniques", debug_check_uniques },
+{ "check_monster_iterator", debug_check_monster_iterator },
+{ "clear_monster_flags", debug_clear_monster_flags },
 { "viewwindow", debug_viewwindow },
 { "seen_monsters_react", debug_seen_monsters_react },
 { "disable", debug_disable },
@@ -251,6 +251,8 @@ static short curs_palette_size();
  */
 static void curs_set_default_colors();
 
+static inline cchar_t character_at(int y, int x);
+
 /**
  * @brief Translates a flagged curses color to an internal COLOUR.
  *
@@ -941,6 +943,88 @@ void putwch(char32_t chr)
 #endif
 }
 
+static console_output_stats _output_totals;
+
+const console_output_stats &console_output_totals()
+{
+    return _output_totals;
+}
+
+static void _count_output(int cells, int runs, int bytes)
+{
+    _output_totals.cells += cells;
+    _output_totals.runs += runs;
+    _output_totals.bytes += bytes;
+}
+
+static bool _same_style(const curses_style &a, const curses_style &b)
+{
+    return a.color_pair == b.color_pair
+           && (a.attr & ~A_COLOR) == (b.attr & ~A_COLOR);
+}
+
+// Does the screen already show glyph in style at (y, x)? stdscr always holds
+// what curses will put on the terminal, whoever drew it, so it serves as the
+// front buffer.
+static bool _cell_shows(int y, int x, wchar_t glyph, const curses_style &style)
+{
+    const cchar_t current = character_at(y, x);
+    wchar_t wch[CCHARW_MAX + 1];
+    curses_style shown;
+    if (getcchar(&current, wch, &shown.attr, &shown.color_pair, nullptr) == ERR)
+        return false;
+    return wch[0] == glyph && wch[1] == 0 && _same_style(shown, style);
+}
+
+/**
+ * Draw a row of the view buffer, leaving out cells that the screen already
+ * shows, and writing each run of changed cells in the same style at once.
+ *
+ * @return whether the row could be diffed at all; rows with glyphs that
+ *         aren't a single column wide are left to the caller.
+ */
+static bool _puttext_row(int y, int x, const screen_cell_t *cell, int width)
+{
+    for (int i = 0; i < width; ++i)
+        if (cell[i].glyph && wcwidth(cell[i].glyph) != 1)
+            return false;
+
+    wstring run;
+    curses_style run_style = { 0, 0 };
+    int run_x = 0, cells = 0, runs = 0, bytes = 0;
+    for (int i = 0; i <= width; ++i)
+    {
+        const wchar_t glyph = i < width && cell[i].glyph ? cell[i].glyph : ' ';
+        const curses_style style = i < width ? curs_attr_fg(cell[i].colour)
+                                             : run_style;
+        const bool changed = i < width && !_cell_shows(y, x + i, glyph, style);
+
+        if (!run.empty()
+            && (!changed || !_same_style(style, run_style)))
+        {
+            attr_set(run_style.attr, run_style.color_pair, nullptr);
+            mvaddnwstr(y, run_x, run.data(), run.size());
+            cells += run.size();
+            runs++;
+            run.clear();
+        }
+
+        if (changed)
+        {
+            if (run.empty())
+            {
+                run_x = x + i;
+                run_style = style;
+            }
+            run.push_back(glyph);
+            bytes += wclen(glyph);
+        }
+    }
+
+    _count_output(cells, runs, bytes);
+    return true;
+}
+
 void puttext(int x1, int y1, const crawl_view_buffer &vbuf)
 {
     const screen_cell_t *cell = vbuf;
@@ -948,10 +1032,36 @@ void puttext(int x1, int y1, const crawl_view_buffer &vbuf)
     for (int y = 0; y < size.y; ++y)
     {
         cgotoxy(x1, y1 + y);
+        // Only send curses what has changed; it does diff the screen itself
+        // on refresh(), but building and comparing every cell of a full
+        // redraw costs more than skipping the ones that match here.
+        if (!_headless_mode && size.x > 0)
+        {
+            coord_def pos;
+            getyx(stdscr, pos.y, pos.x);
+            if (_puttext_row(pos.y, pos.x, cell, size.x))
+            {
+#ifdef USE_TILE_WEB
+                // The webtiles text areas keep track of their own changes.
+                for (int x = 0; x < size.x; ++x)
+                {
+                    char32_t buf[2] = { cell[x].glyph, 0 };
+                    tiles.textcolour(cell[x].colour);
+                    tiles.put_ucs_string(buf);
+                }
+#endif
+                textcolour(cell[size.x - 1].colour);
+                move(pos.y, pos.x + size.x < COLS ? pos.x + size.x : COLS - 1);
+                cell += size.x;
+                continue;
+            }
+        }
+
         for (int x = 0; x < size.x; ++x)
         {
             // headless check handled in putwch, which this calls
             put_colour_ch(cell->colour, cell->glyph);
+            _count_output(1, 1, wclen(cell->glyph ? cell->glyph : ' '));
             cell++;
         }
     }
@@ -19,3 +19,14 @@ private:
 
 bool in_headless_mode();
 void enter_headless_mode();
+
+// Running totals of what puttext() has handed to curses. This is not
+// what reaches the terminal: curses compares the screen and encodes the
+// changes itself on refresh().
+struct console_output_stats
+{
+    int cells = 0;
+    int runs = 0;
+    int bytes = 0;
+};
+const console_output_stats &console_output_totals();
@@ -85,6 +85,30 @@ static blockrays_t blockrays;
 struct cellray;
 static FixedArray<vector<cellray>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> min_cellrays;
 
+// For each cell p of the quadrant, the targets of those minimal
+// cellrays that pass through p. Visibility of any other target
+// from the origin does not depend on the opacity at p, which lets
+// the global LOS cache invalidate selectively (see losglobal.cc).
+static FixedArray<vector<coord_def>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> blocked_targets;
+
+// For the bitboard engine: the cells each minimal cellray passes
+// through (those that block it), one bit per cell of the quadrant,
+// grouped by target.
+struct quadrant_mask
+{
+    uint64_t bits[2];
+
+    void set(const coord_def& p)
+    {
+        const int i = p.y * (LOS_MAX_RANGE+1) + p.x;
+        bits[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+};
+COMPILE_CHECK((LOS_MAX_RANGE+1) * (LOS_MAX_RANGE+1) <= 128);
+static FixedArray<vector<quadrant_mask>, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> cellray_masks;
+
+static los_engine_type los_engine = los_engine_type::bitboard;
+
 // Temporary arrays used in losight() to track which rays
 // are blocked or have seen a smoke cloud.
 // Allocated when doing the precomputations.
@@ -114,6 +138,18 @@ int los_radius = LOS_DEFAULT_RANGE;
 
 static void _handle_los_change();
 
+void set_los_engine(los_engine_type engine)
+{
+    los_engine = engine;
+    invalidate_los();
+    _handle_los_change();
+}
+
+los_engine_type get_los_engine()
+{
+    return los_engine;
+}
+
 void set_los_radius(int r)
 {
     ASSERT(r <= LOS_RADIUS);
@@ -428,6 +464,32 @@ static void _create_blockrays()
     for (quadrant_iterator qi; qi; ++qi)
         delete all_blockrays(*qi);
 
+    // Collect the blocking cells of each minimal cellray as a bitboard.
+    for (int i = 0; i < n_min_rays; ++i)
+    {
+        quadrant_mask mask = { { 0, 0 } };
+        for (quadrant_iterator qi; qi; ++qi)
+            if (blockrays(*qi)->get(i))
+                mask.set(*qi);
+        cellray_masks(cellray_ends[i]).push_back(mask);
+    }
+
+    // Invert the compressed blockrays by target.
+    for (quadrant_iterator qi; qi; ++qi)
+    {
+        FixedArray<bool, LOS_MAX_RANGE+1, LOS_MAX_RANGE+1> seen(false);
+        vector<coord_def>& targets = blocked_targets(*qi);
+        for (int i = 0; i < n_min_rays; ++i)
+        {
+            const coord_def t = cellray_ends[i];
+            if (blockrays(*qi)->get(i) && !seen(t))
+            {
+                seen(t) = true;
+                targets.push_back(t);
+            }
+        }
+    }
+
     dead_rays  = new bit_vector(n_min_rays);
     smoke_rays = new bit_vector(n_min_rays);
 
@@ -651,6 +713,20 @@ bool find_ray(const coord_def& source, const coord_def& target,
     return true;
 }
 
+// Which targets in the positive quadrant might change visibility from
+// the origin if the opacity at p (also in the positive quadrant) changes?
+const vector<coord_def>& los_blocked_targets(const coord_def& p)
+{
+    ASSERT(p.x >= 0);
+    ASSERT(p.y >= 0);
+    ASSERT(p.rdist() <= LOS_MAX_RANGE);
+
+    // Ensure the precalculations have been done.
+    raycast();
+
+    return blocked_targets(p);
+}
+
 bool exists_ray(const coord_def& source, const coord_def& target,
                 const opacity_func& opc, int range)
 {
@@ -800,6 +876,74 @@ struct los_param_funcs : public los_param
     }
 };
 
+// The bitboard engine. Instead of accumulating dead rays cell by cell,
+// take the opacity of the whole window once, turn it into a bitboard per
+// quadrant, and test each ray's bitboard against it: a ray is blocked by
+// any opaque cell, or by two half-opaque ones.
+static bool _ray_alive(const quadrant_mask& ray, const quadrant_mask& opaque,
+                       const quadrant_mask& half)
+{
+    if ((ray.bits[0] & opaque.bits[0]) | (ray.bits[1] & opaque.bits[1]))
+        return false;
+    const uint64_t h0 = ray.bits[0] & half.bits[0];
+    const uint64_t h1 = ray.bits[1] & half.bits[1];
+    if (h0 && h1)
+        return false;
+    const uint64_t h = h0 | h1;
+    return !(h & (h - 1));
+}
+
+static void _losight_bitboard(los_grid& sh, const los_param& dat)
+{
+    // Opacity of the window, or NUM_OPACITIES if out of bounds.
+    SquareArray<uint8_t, LOS_MAX_RANGE> window;
+    for (int y = -LOS_MAX_RANGE; y <= LOS_MAX_RANGE; ++y)
+        for (int x = -LOS_MAX_RANGE; x <= LOS_MAX_RANGE; ++x)
+        {
+            const coord_def p(x, y);
+            window(p) = dat.los_bounds(p) ? dat.opacity(p) : NUM_OPACITIES;
+        }
+
+    // Plain loops rather than quadrant_iterator: this is the inner loop.
+    const int quadrant_x[4] = {  1, -1, -1,  1 };
+    const int quadrant_y[4] = {  1,  1, -1, -1 };
+    for (int q = 0; q < 4; ++q)
+    {
+        const int sx = quadrant_x[q], sy = quadrant_y[q];
+        quadrant_mask opaque = { { 0, 0 } };
+        quadrant_mask half = { { 0, 0 } };
+        for (int y = 0; y <= LOS_MAX_RANGE; ++y)
+            for (int x = 0; x <= LOS_MAX_RANGE; ++x)
+            {
+                switch (window(coord_def(sx * x, sy * y)))
+                {
+                case OPC_OPAQUE:
+                    opaque.set(coord_def(x, y));
+                    break;
+                case OPC_HALF:
+                    half.set(coord_def(x, y));
+                    break;
+                default:
+                    break;
+                }
+            }
+
+        for (int y = 0; y <= LOS_MAX_RANGE; ++y)
+            for (int x = 0; x <= LOS_MAX_RANGE; ++x)
+            {
+                const coord_def p(sx * x, sy * y);
+                if (sh(p) || window(p) == NUM_OPACITIES)
+                    continue;
+                for (const quadrant_mask& ray : cellray_masks[x][y])
+                    if (_ray_alive(ray, opaque, half))
+                    {
+                        sh(p) = true;
+                        break;
+                    }
+            }
+    }
+}
+
 void losight(los_grid& sh, const coord_def& center,
              const opacity_func& opc, const circle_def& bounds)
 {
@@ -810,10 +954,15 @@ void losight(los_grid& sh, const coord_def& center,
     // Do precomputations if necessary.
     raycast();
 
-    const int quadrant_x[4] = {  1, -1, -1,  1 };
-    const int quadrant_y[4] = {  1,  1, -1, -1 };
-    for (int q = 0; q < 4; ++q)
-        _losight_quadrant(sh, dat, quadrant_x[q], quadrant_y[q]);
+    if (los_engine == los_engine_type::bitboard)
+        _losight_bitboard(sh, dat);
+    else
+    {
+        const int quadrant_x[4] = {  1, -1, -1,  1 };
+        const int quadrant_y[4] = {  1,  1, -1, -1 };
+        for (int q = 0; q < 4; ++q)
+            _losight_quadrant(sh, dat, quadrant_x[q], quadrant_y[q]);
+    }
 
     // Center is always visible.
     const coord_def o = coord_def(0,0);
@@ -16,6 +16,16 @@ struct ray_def;
 
 bool double_is_zero(const double x);
 
+// How losight() computes visibility. Both give identical results.
+enum class los_engine_type
+{
+    raycast,  // accumulate blocked rays cell by cell
+    bitboard, // test each ray's cells against opacity bitboards
+};
+
+void set_los_engine(los_engine_type engine);
+los_engine_type get_los_engine();
+
 void set_los_radius(int r);
 int get_los_radius();
 
@@ -32,6 +42,8 @@ dungeon_feature_type ray_blocker(const coord_def& source, const coord_def& targe
 void fallback_ray(const coord_def& source, const coord_def& target,
                   ray_def& ray);
 
+const vector<coord_def>& los_blocked_targets(const coord_def& p);
+
 bool cell_see_cell_nocache(const coord_def& p1, const coord_def& p2);
 
 typedef SquareArray<bool, LOS_MAX_RANGE> los_grid;
@@ -2,37 +2,289 @@
 
 #include "losglobal.h"
 
+#include <chrono>
+
 #include "coord.h"
 #include "coordit.h"
 #include "libutil.h"
 #include "los-def.h"
+#include "maybe-bool.h"
+#include "random.h"
+
+// The cache stores each unordered pair of cells within LOS_RADIUS once,
+// under its lesser cell o and the offset d = q - o > (0,0).
+struct los_pair
+{
+    coord_def o;
+    coord_def d;
+};
+
+static bool _lookup_globallos(const coord_def& p, const coord_def& q,
+                              los_pair& pair)
+{
+    if (!map_bounds(p) || !map_bounds(q))
+        return false;
+    coord_def diff = q - p;
+    if (diff.origin() || diff.rdist() > LOS_RADIUS)
+        return false;
+    // p < q iff p.x < q.x || p.x == q.x && p.y < q.y
+    if (diff < coord_def(0, 0))
+    {
+        pair.o = q;
+        pair.d = -diff;
+    }
+    else
+    {
+        pair.o = p;
+        pair.d = diff;
+    }
+    return true;
+}
 
+// One row of pairs per map cell. Invalidating all rows just bumps the
+// epoch; each row is cleared lazily when it is next accessed with a
+// stale stamp, so rows that are never used are never touched.
+template<typename row_t>
+class globallos_rows
+{
+public:
+    globallos_rows() : epoch(1)
+    {
+        memset(stamps, 0, sizeof(stamps));
+    }
+
+    row_t& operator()(const coord_def& o)
+    {
+        if (stamps[o.x][o.y] != epoch)
+        {
+            rows[o.x][o.y].clear();
+            stamps[o.x][o.y] = epoch;
+        }
+        return rows[o.x][o.y];
+    }
+
+    void invalidate()
+    {
+        if (++epoch == 0)
+        {
+            // Wrapped around: stamps could be mistaken for current ones.
+            memset(stamps, 0, sizeof(stamps));
+            epoch = 1;
+        }
+    }
+
+private:
+    row_t rows[GXM][GYM];
+    uint16_t stamps[GXM][GYM];
+    uint16_t epoch;
+};
+
+// The default layout: one byte per pair, with the low LOS_KNOWN bits
+// holding visibility for each los_type and the high bits whether that
+// visibility is known.
 #define LOS_KNOWN 4
 
 typedef uint8_t losfield_t;
-typedef losfield_t halflos_t[LOS_MAX_RANGE+1][2*LOS_MAX_RANGE+1];
 static const int o_half_x = 0;
 static const int o_half_y = LOS_MAX_RANGE;
-typedef halflos_t globallos_t[GXM][GYM];
 
-static globallos_t globallos;
+struct halflos_t
+{
+    losfield_t field[LOS_MAX_RANGE+1][2*LOS_MAX_RANGE+1];
+
+    void clear()
+    {
+        memset(field, 0, sizeof(field));
+    }
 
-static losfield_t* _lookup_globallos(const coord_def& p, const coord_def& q)
+    losfield_t& operator()(const coord_def& d)
+    {
+        return field[d.x + o_half_x][d.y + o_half_y];
+    }
+};
+
+class globallos_bytes
 {
-    COMPILE_CHECK(LOS_KNOWN * 2 <= sizeof(losfield_t) * 8);
+public:
+    maybe_bool get(const los_pair& pair, los_type l)
+    {
+        COMPILE_CHECK(LOS_KNOWN * 2 <= sizeof(losfield_t) * 8);
 
-    if (!map_bounds(p) || !map_bounds(q))
-        return nullptr;
-    coord_def diff = q - p;
-    if (diff.rdist() > LOS_RADIUS)
-        return nullptr;
-    // p < q iff p.x < q.x || p.x == q.x && p.y < q.y
-    if (diff < coord_def(0, 0))
-        return &globallos[q.x][q.y][-diff.x + o_half_x][-diff.y + o_half_y];
-    else
-        return &globallos[p.x][p.y][ diff.x + o_half_x][ diff.y + o_half_y];
+        const losfield_t flags = rows(pair.o)(pair.d);
+        if (!(flags & (l << LOS_KNOWN)))
+            return maybe_bool::maybe;
+        return bool(flags & l);
+    }
+
+    void set(const los_pair& pair, los_type l, bool visible)
+    {
+        losfield_t& flags = rows(pair.o)(pair.d);
+        flags |= l << LOS_KNOWN;
+        if (visible)
+            flags |= l;
+        else
+            flags &= ~l;
+    }
+
+    void forget(const los_pair& pair)
+    {
+        rows(pair.o)(pair.d) = 0;
+    }
+
+    void invalidate()
+    {
+        rows.invalidate();
+    }
+
+private:
+    globallos_rows<halflos_t> rows;
+};
+
+// The packed layout (PACKED_LOS=y): four bits per pair, one for each
+// los_type, two pairs to a byte. The half of the square around o that a
+// row covers is packed without gaps: first the cells straight below o,
+// then the columns to its right. That is 72 bytes a row against the byte
+// layout's 153.
+//
+// There is no room for a known bit per los_type, so all four are filled
+// in together, and one otherwise impossible value marks a pair as not
+// known: LOS_SOLID_SEE is LOS_SOLID plus half-opaque clouds and monsters,
+// so a pair visible with LOS_SOLID_SEE is always visible with LOS_SOLID.
+#define LOS_HALF_PAIRS (LOS_MAX_RANGE + LOS_MAX_RANGE * (2*LOS_MAX_RANGE+1))
+#define LOS_UNKNOWN_PAIR LOS_SOLID_SEE
+
+struct packedlos_t
+{
+    uint8_t pairs[(LOS_HALF_PAIRS + 1) / 2];
+
+    void clear()
+    {
+        memset(pairs, LOS_UNKNOWN_PAIR | LOS_UNKNOWN_PAIR << 4, sizeof(pairs));
+    }
+
+    static unsigned int pair_index(const coord_def& d)
+    {
+        return d.x ? LOS_MAX_RANGE + (d.x - 1) * (2*LOS_MAX_RANGE+1)
+                     + d.y + LOS_MAX_RANGE
+                   : d.y - 1;
+    }
+
+    int get(const coord_def& d) const
+    {
+        const unsigned int i = pair_index(d);
+        return pairs[i / 2] >> (i % 2 * 4) & 0xf;
+    }
+
+    void set(const coord_def& d, int visible)
+    {
+        const unsigned int i = pair_index(d);
+        uint8_t& byte = pairs[i / 2];
+        byte = (byte & ~(0xf << (i % 2 * 4))) | visible << (i % 2 * 4);
+    }
+};
+
+class globallos_packed
+{
+public:
+    maybe_bool get(const los_pair& pair, los_type l)
+    {
+        const int visible = rows(pair.o).get(pair.d);
+        if (visible == LOS_UNKNOWN_PAIR)
+            return maybe_bool::maybe;
+        return bool(visible & l);
+    }
+
+    // visible holds the los_types that can see along the pair.
+    void set_all(const los_pair& pair, int visible)
+    {
+        ASSERT(!(visible & LOS_SOLID_SEE) || (visible & LOS_SOLID));
+        rows(pair.o).set(pair.d, visible);
+    }
+
+    void forget(const los_pair& pair)
+    {
+        rows(pair.o).set(pair.d, LOS_UNKNOWN_PAIR);
+    }
+
+    void invalidate()
+    {
+        rows.invalidate();
+    }
+
+private:
+    globallos_rows<packedlos_t> rows;
+};
+
+#ifdef USE_PACKED_LOS_CACHE
+static globallos_packed globallos;
+#else
+static globallos_bytes globallos;
+#endif
+
+// Opacity at p has changed. Only forget those pairs that have a
+// minimal cellray passing through p; other pairs can't be affected.
+void invalidate_los_around(const coord_def& p)
+{
+    // Not radius_iterator: the map border can see and be seen, too.
+    for (int dy = -LOS_MAX_RANGE; dy <= LOS_MAX_RANGE; dy++)
+        for (int dx = -LOS_MAX_RANGE; dx <= LOS_MAX_RANGE; dx++)
+        {
+            const coord_def o(p.x - dx, p.y - dy);
+            if (!map_bounds(o))
+                continue;
+
+            const vector<coord_def>& targets =
+                los_blocked_targets(coord_def(abs(dx), abs(dy)));
+
+            // Cells on an axis belong to both adjacent quadrants.
+            for (int sx = -1; sx <= 1; sx += 2)
+                for (int sy = -1; sy <= 1; sy += 2)
+                {
+                    if (dx * sx < 0 || dy * sy < 0)
+                        continue;
+                    for (const coord_def& t : targets)
+                    {
+                        const coord_def q(o.x + sx * t.x, o.y + sy * t.y);
+                        los_pair pair;
+                        if (_lookup_globallos(o, q, pair))
+                            globallos.forget(pair);
+                    }
+                }
+        }
+}
+
+void invalidate_los()
+{
+    globallos.invalidate();
 }
 
+#ifdef USE_PACKED_LOS_CACHE
+// The packed layout only stores all four los_types at once.
+static void _update_globallos_at(const coord_def& p, los_type l)
+{
+    UNUSED(l);
+    los_def los_default(p, opc_default);
+    los_def los_no_trans(p, opc_no_trans);
+    los_def los_solid(p, opc_solid);
+    los_def los_solid_see(p, opc_solid_see);
+    los_default.update();
+    los_no_trans.update();
+    los_solid.update();
+    los_solid_see.update();
+
+    for (rectangle_iterator ri(p, LOS_MAX_RANGE); ri; ++ri)
+    {
+        los_pair pair;
+        if (!_lookup_globallos(p, *ri, pair))
+            continue;
+        const int visible = (los_default.see_cell(*ri) ? LOS_DEFAULT : 0)
+                          | (los_no_trans.see_cell(*ri) ? LOS_NO_TRANS : 0)
+                          | (los_solid.see_cell(*ri) ? LOS_SOLID : 0)
+                          | (los_solid_see.see_cell(*ri) ? LOS_SOLID_SEE : 0);
+        globallos.set_all(pair, visible);
+    }
+}
+#else
 static void _save_los(los_def* los, los_type l)
 {
     const coord_def o = los->get_center();
@@ -47,35 +299,12 @@ static void _save_los(los_def* los, los_type l)
                 continue;
 
             coord_def ri(x, y);
-            losfield_t* flags = _lookup_globallos(o, ri);
-            if (!flags)
-                continue;
-            *flags |= l << LOS_KNOWN;
-            if (los->see_cell(ri))
-                *flags |= l;
-            else
-                *flags &= ~l;
+            los_pair pair;
+            if (_lookup_globallos(o, ri, pair))
+                globallos.set(pair, l, los->see_cell(ri));
         }
 }
 
-// Opacity at p has changed.
-void invalidate_los_around(const coord_def& p)
-{
-    int x1 = max(p.x - LOS_MAX_RANGE, 0);
-    int y1 = max(p.y - LOS_MAX_RANGE, 0);
-    int x2 = min(p.x, GXM - 1);
-    int y2 = min(p.y + LOS_MAX_RANGE, GYM - 1);
-    for (int y = y1; y <= y2; y++)
-        for (int x = x1; x <= x2; x++)
-            memset(globallos[x][y], 0, sizeof(halflos_t));
-}
-
-void invalidate_los()
-{
-    for (rectangle_iterator ri(0); ri; ++ri)
-        memset(globallos[ri->x][ri->y], 0, sizeof(halflos_t));
-}
-
 static void _update_globallos_at(const coord_def& p, los_type l)
 {
     switch (l)
@@ -113,19 +342,109 @@ static void _update_globallos_at(const coord_def& p, los_type l)
     }
 }
 
+#endif
+
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l)
 {
     if (l == LOS_NONE)
         return true;
 
-    losfield_t* flags = _lookup_globallos(p, q);
+    // A cell always sees itself.
+    if (p == q)
+        return map_bounds(p);
 
-    if (!flags)
+    los_pair pair;
+    if (!_lookup_globallos(p, q, pair))
         return false; // outside range
 
-    if (!(*flags & (l << LOS_KNOWN)))
+    maybe_bool seen = globallos.get(pair, l);
+    if (!seen.is_bool())
+    {
         _update_globallos_at(p, l);
+        seen = globallos.get(pair, l);
+    }
+
+    ASSERT(seen.is_bool());
+    return bool(seen);
+}
+
+template<typename cache_t>
+static double _time_lookups(cache_t& cache,
+                            const vector<pair<los_pair, los_type>>& lookups,
+                            int rounds, int& visible)
+{
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        for (const auto &lookup : lookups)
+            if (cache.get(lookup.first, lookup.second))
+                ++visible;
+    const auto end = chrono::steady_clock::now();
 
-    ASSERT(*flags & (l << LOS_KNOWN));
-    return *flags & l;
+    return chrono::duration<double, nano>(end - start).count()
+           / (rounds * lookups.size());
+}
+
+// Time cache hits in the byte layout and in the packed layout, as
+// nanoseconds per lookup, and give the size of each. Both are filled
+// with the same random contents and have to agree on every lookup.
+void los_cache_benchmark(int rounds, double& bytes_ns, double& packed_ns,
+                         size_t& bytes_size, size_t& packed_size)
+{
+    static const los_type types[] =
+        { LOS_DEFAULT, LOS_NO_TRANS, LOS_SOLID, LOS_SOLID_SEE };
+
+    rng::subgenerator bench_rng;
+    unique_ptr<globallos_bytes> bytes(new globallos_bytes());
+    unique_ptr<globallos_packed> packed(new globallos_packed());
+    bytes_size = sizeof(globallos_bytes);
+    packed_size = sizeof(globallos_packed);
+
+    for (rectangle_iterator ri(0); ri; ++ri)
+        for (rectangle_iterator di(coord_def(0, 0), LOS_RADIUS); di; ++di)
+        {
+            los_pair pair;
+            if (!_lookup_globallos(*ri, *ri + *di, pair) || pair.o != *ri)
+                continue;
+            int visible = 0;
+            for (los_type l : types)
+                if (coinflip())
+                    visible |= l;
+            // As in the game; see globallos_packed.
+            if (visible & LOS_SOLID_SEE)
+                visible |= LOS_SOLID;
+            for (los_type l : types)
+                bytes->set(pair, l, visible & l);
+            packed->set_all(pair, visible);
+        }
+
+    // Random pairs within range, clustered around a few centres as when
+    // monsters look around.
+    vector<pair<los_pair, los_type>> lookups;
+    while (lookups.size() < 1 << 16)
+    {
+        const coord_def c = random_in_bounds();
+        for (int i = 0; i < 64; ++i)
+        {
+            const coord_def p = c + coord_def(random_range(-LOS_RADIUS, LOS_RADIUS),
+                                              random_range(-LOS_RADIUS, LOS_RADIUS));
+            const coord_def q = p + coord_def(random_range(-LOS_RADIUS, LOS_RADIUS),
+                                              random_range(-LOS_RADIUS, LOS_RADIUS));
+            los_pair pair;
+            if (_lookup_globallos(p, q, pair))
+                lookups.emplace_back(pair, types[random2(ARRAYSZ(types))]);
+        }
+    }
+
+    // Alternate the layouts and keep the best time of each, so that
+    // neither is penalised for running first.
+    bytes_ns = packed_ns = numeric_limits<double>::max();
+    for (int i = 0; i < 3; ++i)
+    {
+        int bytes_visible = 0, packed_visible = 0;
+        bytes_ns = min(bytes_ns,
+                       _time_lookups(*bytes, lookups, rounds, bytes_visible));
+        packed_ns = min(packed_ns,
+                        _time_lookups(*packed, lookups, rounds, packed_visible));
+        ASSERT(bytes_visible == packed_visible);
+    }
 }
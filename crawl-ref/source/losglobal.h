@@ -6,3 +6,6 @@ void invalidate_los_around(const coord_def& p);
 void invalidate_los();
 
 bool cell_see_cell(const coord_def& p, const coord_def& q, los_type l);
+
+void los_cache_benchmark(int rounds, double& bytes_ns, double& packed_ns,
+                         size_t& bytes_size, size_t& packed_size);
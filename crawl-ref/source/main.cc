@@ -584,6 +584,12 @@ static void _show_commandline_options_help()
     puts("  -objstat [<levels>] run monster and item stats on the given range "
          "of levels");
     puts("      Defaults to entire dungeon; same level syntax as -mapstat.");
+    puts("  -builder-bench [<seeds> [<levels>]]");
+    puts("                      time the level builder over a range of seeds "
+         "and levels,");
+    puts("      writing a JSON report to builder-bench.json. Defaults to "
+         "seeds 1-100");
+    puts("      and the entire dungeon. Example: '-builder-bench 1-50 D,Lair'");
     puts("  -iters <num>        For -mapstat and -objstat, set the number of "
          "iterations");
     puts("  -force-map <map>    For -mapstat and -objstat, always choose the "
@@ -410,7 +410,7 @@ int determine_nice_weapon_plusses(int item_level)
 
 void set_artefact_brand(item_def &item, int brand)
 {
-    item.props[ARTEFACT_PROPS_KEY].get_vector()[ARTP_BRAND].get_short() = brand;
+    item.artprops[ARTP_BRAND] = brand;
 }
 
 static void _generate_weapon_item(item_def& item, bool allow_uniques,
@@ -764,18 +764,18 @@ static bool _try_make_armour_artefact(item_def& item, int force_type,
             switch (prop)
             {
                 case ARTP_AC:
-                    item.props[ARTEFACT_PROPS_KEY].get_vector()[prop].get_short() += 3;
+                    item.artprops[prop] += 3;
                     break;
                 case ARTP_MAGICAL_POWER:
-                    item.props[ARTEFACT_PROPS_KEY].get_vector()[prop].get_short() += 5;
+                    item.artprops[prop] += 5;
                     break;
                 case ARTP_EVASION:
-                    item.props[ARTEFACT_PROPS_KEY].get_vector()[prop].get_short() += 15;
+                    item.artprops[prop] += 15;
                     break;
 
                 default:
                 {
-                    short& val = item.props[ARTEFACT_PROPS_KEY].get_vector()[prop].get_short();
+                    short& val = item.artprops[prop];
 
                     // Make sure not to 'hide' a second level of a boolean artprop
                     if (artp_value_type(prop) == ARTP_VAL_BOOL)
@@ -2127,7 +2127,7 @@ int items(bool allow_uniques,
             item.name(DESC_PLAIN, false, true, false, false).c_str());
 
         if (is_artefact(item))
-            item.props[ARTEFACT_PROPS_KEY].get_vector()[ARTP_BRAND].get_short() = 0;
+            item.artprops[ARTP_BRAND] = 0;
         else
             item.brand = 0;
     }
@@ -2469,18 +2469,28 @@ void map_def::load()
     if (!index_only)
         return;
 
-    const string descache_base = get_descache_path(cache_name, "");
-    file_lock deslock(descache_base + ".lk", "rb", false);
-    const string loadfile = descache_base + ".dsc";
-
-    reader inf(loadfile, TAG_MINOR_VERSION);
-    if (!inf.valid())
+    size_t bundled_size;
+    if (const char *bundled = bundled_map_data(cache_name, bundled_size))
+    {
+        reader inf(bundled, bundled_size, TAG_MINOR_VERSION);
+        inf.advance(cache_offset);
+        read_full(inf);
+    }
+    else
     {
-        throw map_load_exception(
-                make_stringf("Map inf is invalid: %s", name.c_str()));
+        const string descache_base = get_descache_path(cache_name, "");
+        file_lock deslock(descache_base + ".lk", "rb", false);
+        const string loadfile = descache_base + ".dsc";
+
+        reader inf(loadfile, TAG_MINOR_VERSION);
+        if (!inf.valid())
+        {
+            throw map_load_exception(
+                    make_stringf("Map inf is invalid: %s", name.c_str()));
+        }
+        inf.advance(cache_offset);
+        read_full(inf);
     }
-    inf.advance(cache_offset);
-    read_full(inf);
 
     index_only = false;
 }
@@ -10,11 +10,17 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <unordered_map>
 #include <sys/param.h>
 #include <sys/types.h>
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
 #endif
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "branch.h"
 #include "coord.h"
@@ -786,7 +792,7 @@ mapref_vector find_maps_for_tag(const string &tag,
 
 struct map_selector
 {
-private:
+public:
     enum select_type
     {
         PLACE,
@@ -795,7 +801,6 @@ private:
         TAG,
     };
 
-public:
     bool accept(const map_def &md) const;
     void announce(const map_def *map) const;
 
@@ -994,13 +999,152 @@ string vault_chance_tag(const map_def &map)
 
 typedef vector<unsigned> vault_indices;
 
+// An inverted index over vdefs, so that a selector only has to look at the
+// maps that could possibly match it. The index only narrows the search:
+// map_selector::accept() is still run on every candidate. All lists are in
+// vdefs order, which the random choice depends on.
+struct map_index
+{
+    bool built = false;
+    // Maps carrying each tag.
+    unordered_map<string, vault_indices> tagged;
+    // Maps whose DEPTH: or PLACE: allows some level of the branch, split by
+    // [minivault][extra].
+    vault_indices depth[NUM_BRANCHES][2][2];
+    vault_indices place[NUM_BRANCHES][2][2];
+};
+
+static map_index vindex;
+
+// Must be called whenever vdefs, or the tags or depths of a map in it,
+// change.
+static void _invalidate_map_index()
+{
+    if (!vindex.built)
+        return;
+    vindex = map_index();
+}
+
+static void _index_ranges(vault_indices (&lists)[NUM_BRANCHES][2][2],
+                          const depth_ranges &ranges, const map_def &map,
+                          unsigned index)
+{
+    bool in_branch[NUM_BRANCHES] = { false };
+    for (const level_range &lr : ranges.ranges())
+    {
+        // Deny ranges can only ever rule a level out.
+        if (lr.deny)
+            continue;
+        // A range without a branch is an absolute depth, which may be in any
+        // branch.
+        if (lr.branch == NUM_BRANCHES)
+        {
+            for (bool &in : in_branch)
+                in = true;
+        }
+        else
+            in_branch[lr.branch] = true;
+    }
+
+    for (int br = 0; br < NUM_BRANCHES; ++br)
+        if (in_branch[br])
+            lists[br][map.is_minivault()][map.is_extra_vault()].push_back(index);
+}
+
+static void _build_map_index()
+{
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+    {
+        const map_def &map = vdefs[i];
+        // Never accepted by any selector.
+        if (map.has_tag("no_descent"))
+            continue;
+
+        for (const string &tag : map.get_tags_unsorted())
+            vindex.tagged[tag].push_back(i);
+        _index_ranges(vindex.depth, map.depths, map, i);
+        _index_ranges(vindex.place, map.place, map, i);
+    }
+    vindex.built = true;
+}
+
+// Appends the given lists from the index, keeping vdefs order.
+static void _merge_candidates(vault_indices &cands,
+                              const vault_indices (&lists)[2][2],
+                              maybe_bool mini, maybe_bool extra)
+{
+    for (int m = 0; m < 2; ++m)
+    {
+        if (mini != maybe_bool::maybe && bool(mini) != bool(m))
+            continue;
+        for (int e = 0; e < 2; ++e)
+        {
+            if (!_is_extra_compatible(extra, e))
+                continue;
+            const vault_indices &list = lists[m][e];
+            const auto mid = cands.size();
+            cands.insert(cands.end(), list.begin(), list.end());
+            inplace_merge(cands.begin(), cands.begin() + mid, cands.end());
+        }
+    }
+}
+
+// The maps that sel could accept, a (usually much smaller) superset of the
+// ones it does.
+static const vault_indices &_candidate_maps(const map_selector &sel,
+                                            vault_indices &buf)
+{
+    static const vault_indices none;
+
+    if (!vindex.built)
+        _build_map_index();
+
+    switch (sel.sel)
+    {
+    case map_selector::PLACE:
+        _merge_candidates(buf, vindex.place[sel.place.branch],
+                          maybe_bool(sel.mini), sel.extra);
+        return buf;
+
+    case map_selector::DEPTH:
+        _merge_candidates(buf, vindex.depth[sel.place.branch],
+                          maybe_bool(sel.mini), sel.extra);
+        return buf;
+
+    case map_selector::DEPTH_AND_CHANCE:
+        _merge_candidates(buf, vindex.depth[sel.place.branch],
+                          maybe_bool::maybe, sel.extra);
+        return buf;
+
+    case map_selector::TAG:
+    {
+        // A map needs every tag, so the rarest one gives the fewest
+        // candidates.
+        const vault_indices *best = nullptr;
+        for (const string &tag : parse_tags(sel.tag))
+        {
+            auto it = vindex.tagged.find(tag);
+            if (it == vindex.tagged.end())
+                return none;
+            if (!best || it->second.size() < best->size())
+                best = &it->second;
+        }
+        return best ? *best : none;
+    }
+
+    default:
+        return none;
+    }
+}
+
 static vault_indices _eligible_maps_for_selector(const map_selector &sel)
 {
     vault_indices eligible;
 
     if (sel.valid())
     {
-        for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+        vault_indices buf;
+        for (unsigned i : _candidate_maps(sel, buf))
             if (sel.accept(vdefs[i]))
                 eligible.push_back(i);
     }
@@ -1313,35 +1457,27 @@ static bool _verify_map_full(const string &base, time_t mtime)
     return verify_file_version(base + ".dsc", mtime);
 }
 
-static bool _load_map_index(const string& cache, const string &base,
-                            time_t mtime)
+static bool _read_map_prelude(reader &inf, time_t mtime)
 {
-    // If there's a global prelude, load that first.
-    if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
+    const auto version = get_save_version(inf);
+    const auto major = version.major, minor = version.minor;
+    int8_t word = unmarshallByte(inf);
+    int64_t t = unmarshallSigned(inf);
+    if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
+        || word != WORD_LEN || t != mtime)
     {
-        reader inf(fp, TAG_MINOR_VERSION);
-        const auto version = get_save_version(inf);
-        const auto major = version.major, minor = version.minor;
-        int8_t word = unmarshallByte(inf);
-        int64_t t = unmarshallSigned(inf);
-        if (major != TAG_MAJOR_VERSION || minor > TAG_MINOR_VERSION
-            || word != WORD_LEN || t != mtime)
-        {
-            return false;
-        }
-
-        lc_global_prelude.read(inf);
-        fclose(fp);
-
-        global_preludes.push_back(lc_global_prelude);
+        return false;
     }
 
-    FILE* fp = fopen_u((base + ".idx").c_str(), "rb");
-    if (!fp)
-        end(1, true, "Unable to read %s", (base + ".idx").c_str());
+    // Only added to global_preludes once the index has been read too, so
+    // that a failed load can fall back to another source without leaving
+    // the prelude behind twice.
+    lc_global_prelude.read(inf);
+    return true;
+}
 
-    reader inf(fp, TAG_MINOR_VERSION);
-    // Re-check version, might have been modified in the meantime.
+static bool _read_map_index(reader &inf, const string &cache, time_t mtime)
+{
     const auto version = get_save_version(inf);
     const auto major = version.major, minor = version.minor;
     int8_t word = unmarshallByte(inf);
@@ -1360,6 +1496,7 @@ static bool _load_map_index(const string& cache, const string &base,
 
     const int nmaps = unmarshallShort(inf);
     const int nexist = vdefs.size();
+    _invalidate_map_index();
     vdefs.resize(nexist + nmaps, map_def());
     for (int i = 0; i < nmaps; ++i)
     {
@@ -1372,22 +1509,332 @@ static bool _load_map_index(const string& cache, const string &base,
         lc_loaded_maps[vdef.name] = vdef.place_loaded_from;
         vdef.place_loaded_from.clear();
     }
+
+    return true;
+}
+
+static bool _load_map_index(const string& cache, const string &base,
+                            time_t mtime)
+{
+    // If there's a global prelude, load that first.
+    bool has_prelude = false;
+    if (FILE *fp = fopen_u((base + ".lux").c_str(), "rb"))
+    {
+        reader inf(fp, TAG_MINOR_VERSION);
+        const bool ok = _read_map_prelude(inf, mtime);
+        fclose(fp);
+        if (!ok)
+            return false;
+        has_prelude = true;
+    }
+
+    FILE* fp = fopen_u((base + ".idx").c_str(), "rb");
+    if (!fp)
+        end(1, true, "Unable to read %s", (base + ".idx").c_str());
+
+    reader inf(fp, TAG_MINOR_VERSION);
+    // Re-check version, might have been modified in the meantime.
+    const bool ok = _read_map_index(inf, cache, mtime);
     fclose(fp);
 
+    if (ok && has_prelude)
+        global_preludes.push_back(lc_global_prelude);
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// The map bundle.
+//
+// Checking and reading the .lux, .idx and .dsc caches of every .des file
+// means several file opens per .des file at each startup. The bundle holds
+// the caches of all .des files in one file that is mapped into memory:
+// a header giving the name, mtime and where the data of each cache is,
+// followed by the cache files verbatim. Map indices are read from it at
+// startup and map bodies only when the map is first used, as with the
+// per-file caches, which stay the source the bundle is rebuilt from
+// whenever a .des file had to be loaded some other way.
+
+#define MAP_BUNDLE "maps.bundle"
+
+enum bundle_part
+{
+    BUNDLE_LUX,
+    BUNDLE_IDX,
+    BUNDLE_DSC,
+    NUM_BUNDLE_PARTS
+};
+
+static const char *bundle_exts[NUM_BUNDLE_PARTS] = { ".lux", ".idx", ".dsc" };
+
+struct bundled_des
+{
+    int64_t mtime;
+    uint32_t offset[NUM_BUNDLE_PARTS];
+    uint32_t length[NUM_BUNDLE_PARTS];
+};
+
+struct map_bundle
+{
+    bool opened = false;
+    const char *data = nullptr;
+    size_t size = 0;
+#ifndef UNIX
+    vector<char> buf;
+#endif
+    map<string, bundled_des> entries;
+    // The .des files whose maps were loaded from the bundle.
+    set<string> used;
+    // Every .des file loaded with the cache, in order, and whether any of
+    // them were not in the bundle.
+    vector<pair<string, time_t>> files;
+    bool stale = false;
+};
+
+static map_bundle bundle;
+
+static void _close_map_bundle()
+{
+#ifdef UNIX
+    if (bundle.data)
+        munmap(const_cast<char *>(bundle.data), bundle.size);
+#endif
+    bundle = map_bundle();
+}
+
+static bool _read_map_bundle_header()
+{
+    reader inf(bundle.data, bundle.size, TAG_MINOR_VERSION);
+    inf.set_safe_read(true);
+    try
+    {
+        const auto version = get_save_version(inf);
+        if (version.major != TAG_MAJOR_VERSION
+            || version.minor > TAG_MINOR_VERSION
+            || unmarshallByte(inf) != WORD_LEN)
+        {
+            return false;
+        }
+
+        const int nfiles = unmarshallInt(inf);
+        for (int i = 0; i < nfiles; ++i)
+        {
+            const string name = unmarshallString(inf);
+            bundled_des &des = bundle.entries[name];
+            des.mtime = unmarshallSigned(inf);
+            for (int part = 0; part < NUM_BUNDLE_PARTS; ++part)
+            {
+                des.offset[part] = unmarshallInt(inf);
+                des.length[part] = unmarshallInt(inf);
+                if (des.offset[part] > bundle.size
+                    || des.length[part] > bundle.size - des.offset[part])
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    catch (const short_read_exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool _open_map_bundle()
+{
+    if (bundle.opened)
+        return bundle.data;
+
+    const string filename = _des_cache_dir(MAP_BUNDLE);
+#ifdef UNIX
+    int fd = open_u(filename.c_str(), O_RDONLY, 0);
+    if (fd != -1)
+    {
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0)
+        {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE,
+                              fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                bundle.data = static_cast<const char *>(addr);
+                bundle.size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+#else
+    if (FILE *fp = fopen_u(filename.c_str(), "rb"))
+    {
+        bundle.buf.resize(file_size(fp));
+        if (!bundle.buf.empty()
+            && fread(&bundle.buf[0], 1, bundle.buf.size(), fp)
+               == bundle.buf.size())
+        {
+            bundle.data = &bundle.buf[0];
+            bundle.size = bundle.buf.size();
+        }
+        fclose(fp);
+    }
+#endif
+
+    if (bundle.data && !_read_map_bundle_header())
+    {
+        dprf("Discarding invalid map bundle %s", filename.c_str());
+        _close_map_bundle();
+    }
+    bundle.opened = true;
+    return bundle.data;
+}
+
+static bool _load_bundled_maps(const string &cache, time_t mtime)
+{
+    if (!_open_map_bundle())
+        return false;
+
+    auto it = bundle.entries.find(cache);
+    if (it == bundle.entries.end() || it->second.mtime != mtime)
+        return false;
+
+    const bundled_des &des = it->second;
+    if (des.length[BUNDLE_LUX])
+    {
+        reader inf(bundle.data + des.offset[BUNDLE_LUX],
+                   des.length[BUNDLE_LUX], TAG_MINOR_VERSION);
+        if (!_read_map_prelude(inf, mtime))
+            return false;
+    }
+
+    reader inf(bundle.data + des.offset[BUNDLE_IDX], des.length[BUNDLE_IDX],
+               TAG_MINOR_VERSION);
+    if (!_read_map_index(inf, cache, mtime))
+        return false;
+
+    if (des.length[BUNDLE_LUX])
+        global_preludes.push_back(lc_global_prelude);
+
+    bundle.used.insert(cache);
     return true;
 }
 
+const char *bundled_map_data(const string &cache_name, size_t &size)
+{
+    if (!bundle.used.count(cache_name))
+        return nullptr;
+
+    const bundled_des &des = bundle.entries[cache_name];
+    size = des.length[BUNDLE_DSC];
+    return bundle.data + des.offset[BUNDLE_DSC];
+}
+
+static bool _read_whole_file(const string &filename, string &data)
+{
+    FILE *fp = fopen_u(filename.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    data.resize(file_size(fp));
+    const bool ok = data.empty()
+                    || fread(&data[0], 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+// Rebuilds the bundle from the caches of the .des files loaded this time.
+static void _write_map_bundle()
+{
+    if (!bundle.stale || bundle.files.empty())
+        return;
+
+    vector<string> contents;
+    for (const auto &file : bundle.files)
+    {
+        const string &name = file.first;
+        if (bundle.used.count(name))
+        {
+            const bundled_des &des = bundle.entries[name];
+            for (int part = 0; part < NUM_BUNDLE_PARTS; ++part)
+            {
+                contents.emplace_back(bundle.data + des.offset[part],
+                                      des.length[part]);
+            }
+            continue;
+        }
+
+        const string base = get_descache_path(name, "");
+        file_lock deslock(base + ".lk", "rb", false);
+        for (int part = 0; part < NUM_BUNDLE_PARTS; ++part)
+        {
+            contents.emplace_back();
+            // A missing prelude just means the .des file doesn't have one.
+            if (!_read_whole_file(base + bundle_exts[part], contents.back())
+                && part != BUNDLE_LUX)
+            {
+                return;
+            }
+        }
+    }
+
+    // The header is the same size whatever the offsets in it, so write it
+    // once to find where the data starts.
+    auto write_header = [&](vector<unsigned char> &buf, uint32_t start)
+    {
+        buf.clear();
+        writer outf(&buf);
+        write_save_version(outf, save_version::current());
+        marshallByte(outf, WORD_LEN);
+        marshallInt(outf, bundle.files.size());
+        uint32_t offset = start;
+        for (size_t i = 0; i < bundle.files.size(); ++i)
+        {
+            marshallString(outf, bundle.files[i].first);
+            marshallSigned(outf, bundle.files[i].second);
+            for (int part = 0; part < NUM_BUNDLE_PARTS; ++part)
+            {
+                const string &data = contents[i * NUM_BUNDLE_PARTS + part];
+                marshallInt(outf, offset);
+                marshallInt(outf, data.size());
+                offset += data.size();
+            }
+        }
+    };
+    vector<unsigned char> header;
+    write_header(header, 0);
+    write_header(header, header.size());
+
+    // Other processes may have the old bundle mapped, so never write to it
+    // in place.
+    const string filename = _des_cache_dir(MAP_BUNDLE);
+    const string tmpname = filename + ".tmp";
+    file_lock bundlelock(filename + ".lk", "wb", false);
+    FILE *fp = fopen_replace(tmpname.c_str());
+    if (!fp)
+        return;
+    bool ok = fwrite(&header[0], 1, header.size(), fp) == header.size();
+    for (const string &data : contents)
+        ok = ok && fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = !fclose(fp) && ok;
+
+    if (!ok || rename_u(tmpname.c_str(), filename.c_str()))
+        unlink_u(tmpname.c_str());
+}
+
 static bool _load_map_cache(const string &filename, const string &cachename)
 {
     _check_des_index_dir();
     if (!crawl_state.use_des_cache)
         return false;
 
+    time_t mtime = file_modtime(filename);
+    bundle.files.emplace_back(cachename, mtime);
+    if (_load_bundled_maps(cachename, mtime))
+        return true;
+    bundle.stale = true;
+
     const string descache_base = get_descache_path(cachename, "");
 
     file_lock deslock(descache_base + ".lk", "rb", false);
 
-    time_t mtime = file_modtime(filename);
     string file_idx = descache_base + ".idx";
     string file_dsc = descache_base + ".dsc";
 
@@ -1521,8 +1968,10 @@ void read_map(const string &file)
 
 void read_maps()
 {
+    CLua::open_chunk_cache();
     if (dlua.execfile("dlua/loadmaps.lua", true, true, true))
         end(1, false, "Lua error: %s", dlua.error.c_str());
+    _write_map_bundle();
 
     lc_loaded_maps.clear();
 
@@ -1533,6 +1982,8 @@ void read_maps()
             brdepth[it->id] = it->numlevels;
         dlua.execfile("dlua/sanity.lua", true, true);
     }
+
+    CLua::save_chunk_cache();
 }
 
 // If a .dsc file has been changed under the running Crawl, discard
@@ -1547,7 +1998,9 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    _invalidate_map_index();
     map_files_read.clear();
+    _close_map_bundle();
     read_maps();
 }
 
@@ -1566,6 +2019,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    _invalidate_map_index();
 }
 
 void run_map_global_preludes()
@@ -1582,6 +2036,8 @@ void run_map_global_preludes()
 
 void run_map_local_preludes()
 {
+    // Preludes may set tags or depths.
+    _invalidate_map_index();
     for (map_def &vdef : vdefs)
     {
         if (!vdef.prelude.empty())
@@ -2666,17 +2666,14 @@ void clear_monster_flags()
 {
     // Clear any summoning flags so that lower indiced monsters get their
     // actions in the next round. Also clear one-turn deep sleep flag.
-    // Finally, track the highest index of monster still alive, for
-    // monster_iterator optimisation purposes.
-    env.max_mon_index = 0;
-    for (int i = 0; i < MAX_MONSTERS; ++i)
-    {
-        if (env.mons[i].defined())
-        {
-            env.max_mon_index = i;
-            env.mons[i].flags &= ~MF_JUST_SUMMONED & ~MF_JUST_SLEPT;
-        }
-    }
+    // Finally, drop the slots of monsters that are gone from the list
+    // monster_iterator walks.
+    vector<int> &slots = env.active_mons;
+    slots.erase(remove_if(slots.begin(), slots.end(),
+                          [](int i) { return !env.mons[i].defined(); }),
+                slots.end());
+    for (int i : slots)
+        env.mons[i].flags &= ~MF_JUST_SUMMONED & ~MF_JUST_SLEPT;
 }
 
 /**
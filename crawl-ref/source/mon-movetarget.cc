@@ -201,6 +201,22 @@ bool try_pathfind(monster* mon)
          mon->name(DESC_PLAIN).c_str(), mon->pos().x, mon->pos().y,
          targpos.x, targpos.y, range);
 #endif
+    // Hostiles hunting the player share a flow field per movement class.
+    // (Thorn hunters treat their briars specially, so path on their own.)
+    if (!crawl_state.game_is_arena() && !mon->wont_attack()
+        && mon->foe == MHITYOU && targpos == you.pos()
+        && mon->type != MONS_THORN_HUNTER)
+    {
+        if (player_flow_waypoints(mon, range, mon->travel_path))
+        {
+            mon->target = mon->travel_path[0];
+            mon->travel_target = MTRAV_FOE;
+            return true;
+        }
+        _set_no_path_found(mon);
+        return false;
+    }
+
     monster_pathfind mp;
     mp.set_range(range);
 
@@ -60,17 +60,94 @@ int mons_tracking_range(const monster* mon)
     return range;
 }
 
+// The per-cell state of a pathfind. A cell's entries are only valid if its
+// stamp matches the current generation; starting a new pathfind just bumps
+// the generation instead of clearing all arrays.
+struct pathfind_workspace
+{
+    pathfind_workspace() : generation(0), hash_min(INT_MAX), hash_max(-1),
+                           stamp(), hash()
+    {
+    }
+
+    void new_generation()
+    {
+        if (++generation == 0)
+        {
+            // Wrapped around: stale stamps could look current.
+            memset(stamp, 0, sizeof(stamp));
+            generation = 1;
+        }
+
+        // Only the buckets used last time can hold anything.
+        for (int i = hash_min; i <= hash_max; i++)
+            hash[i].clear();
+        hash_min = INT_MAX;
+        hash_max = -1;
+    }
+
+    uint32_t generation;
+    int hash_min, hash_max;
+    uint32_t stamp[GXM][GYM];
+
+    // The array of distances from start to any already tried point.
+    int dist[GXM][GYM];
+    // An array to store where we came from on a given shortest path.
+    int8_t prev[GXM][GYM];
+    maybe_bool traversable_cache[GXM][GYM];
+
+    // Positions by total estimated path length. The vectors keep their
+    // capacity between pathfinds.
+    FixedVector<vector<coord_def>, GXM * GYM> hash;
+};
+
+// Workspaces not held by any live monster_pathfind. Instances can be nested
+// (e.g. a pathfind started while another one's path is still in use), so
+// this is a pool rather than a single shared workspace.
+static vector<unique_ptr<pathfind_workspace>> free_workspaces;
+
 //#define DEBUG_PATHFIND
 monster_pathfind::monster_pathfind()
     : mons(nullptr), start(), target(), pos(), allow_diagonals(true),
       traverse_unmapped(false), fill_range(false),
-      range(0), min_length(0), max_length(0),
-      dist(), prev(), hash(), traversable_cache()
+      range(0), min_length(0), max_length(0), ws(nullptr)
 {
+    if (free_workspaces.empty())
+        ws = new pathfind_workspace();
+    else
+    {
+        ws = free_workspaces.back().release();
+        free_workspaces.pop_back();
+    }
+    ws->new_generation();
 }
 
 monster_pathfind::~monster_pathfind()
 {
+    free_workspaces.emplace_back(ws);
+}
+
+int monster_pathfind::dist_at(const coord_def& p) const
+{
+    return ws->stamp[p.x][p.y] == ws->generation ? ws->dist[p.x][p.y]
+                                                 : INFINITE_DISTANCE;
+}
+
+maybe_bool monster_pathfind::traversable_at(const coord_def& p) const
+{
+    return ws->stamp[p.x][p.y] == ws->generation
+           ? ws->traversable_cache[p.x][p.y] : maybe_bool::maybe;
+}
+
+// Bring p's entries up to date with the current pathfind.
+void monster_pathfind::touch(const coord_def& p)
+{
+    if (ws->stamp[p.x][p.y] != ws->generation)
+    {
+        ws->stamp[p.x][p.y] = ws->generation;
+        ws->dist[p.x][p.y] = INFINITE_DISTANCE;
+        ws->traversable_cache[p.x][p.y] = maybe_bool::maybe;
+    }
 }
 
 void monster_pathfind::set_range(int r)
@@ -81,7 +158,7 @@ void monster_pathfind::set_range(int r)
 
 coord_def monster_pathfind::next_pos(const coord_def &c) const
 {
-    return c + Compass[prev[c.x][c.y]];
+    return c + Compass[ws->prev[c.x][c.y]];
 }
 
 // The main method in the monster_pathfind class.
@@ -163,14 +240,10 @@ bool monster_pathfind::start_pathfind(bool msg)
         min_length = 1;
         max_length = range;
     }
-    for (int i = 0; i < GXM; i++)
-        for (int j = 0; j < GYM; j++)
-        {
-            dist[i][j] = INFINITE_DISTANCE;
-            traversable_cache[i][j] = maybe_bool::maybe;
-        }
+    ws->new_generation();
 
-    dist[pos.x][pos.y] = 0;
+    touch(pos);
+    ws->dist[pos.x][pos.y] = 0;
 
     bool success = false;
     do
@@ -240,8 +313,8 @@ bool monster_pathfind::calc_path_to_neighbours()
         if (!traversable_memoized(npos) && npos != target)
             continue;
 
-        distance = dist[pos.x][pos.y] + travel_cost(npos);
-        old_dist = dist[npos.x][npos.y];
+        distance = dist_at(pos) + travel_cost(npos);
+        old_dist = dist_at(npos);
 
         // Also bail out if this would make the path longer than twice the
         // allowed distance from the target. (This factor may need tuning.)
@@ -283,7 +356,8 @@ bool monster_pathfind::calc_path_to_neighbours()
             }
 
             // Update distance start->pos.
-            dist[npos.x][npos.y] = distance;
+            touch(npos);
+            ws->dist[npos.x][npos.y] = distance;
 
             // Set backtracking information.
             // Converts the Compass direction to its counterpart.
@@ -291,7 +365,7 @@ bool monster_pathfind::calc_path_to_neighbours()
             //      7  .  3   ==>   3  .  7       e.g. (3 + 4) % 8          = 7
             //      6  5  4         2  1  0            (7 + 4) % 8 = 11 % 8 = 3
 
-            prev[npos.x][npos.y] = (dir + 4) % 8;
+            ws->prev[npos.x][npos.y] = (dir + 4) % 8;
 
             // Are we finished?
             if (npos == target)
@@ -313,12 +387,12 @@ bool monster_pathfind::get_best_position()
 {
     for (int i = min_length; i <= max_length; i++)
     {
-        if (!hash[i].empty())
+        if (!ws->hash[i].empty())
         {
             if (i > min_length)
                 min_length = i;
 
-            vector<coord_def> &vec = hash[i];
+            vector<coord_def> &vec = ws->hash[i];
             // Pick the last position pushed into the vector as it's most
             // likely to be close to the target.
             pos = vec[vec.size()-1];
@@ -357,7 +431,7 @@ vector<coord_def> monster_pathfind::backtrack()
     int dir;
     do
     {
-        dir = prev[pos.x][pos.y];
+        dir = ws->prev[pos.x][pos.y];
         pos = pos + Compass[dir];
         ASSERT_IN_BOUNDS(pos);
 #ifdef DEBUG_PATHFIND
@@ -384,8 +458,11 @@ vector<coord_def> monster_pathfind::backtrack()
 // avoid plants and other monsters in the way.
 vector<coord_def> monster_pathfind::calc_waypoints()
 {
-    vector<coord_def> path = backtrack();
+    return path_waypoints(backtrack());
+}
 
+vector<coord_def> monster_pathfind::path_waypoints(const vector<coord_def>& path)
+{
     // If no path found, nothing to be done.
     if (path.empty())
         return path;
@@ -421,9 +498,11 @@ vector<coord_def> monster_pathfind::calc_waypoints()
 
 bool monster_pathfind::traversable_memoized(const coord_def& p)
 {
-    if (traversable_cache[p.x][p.y] == maybe_bool::maybe)
-        traversable_cache[p.x][p.y] = traversable(p);
-    return bool(traversable_cache[p.x][p.y]);
+    touch(p);
+    maybe_bool &cached = ws->traversable_cache[p.x][p.y];
+    if (cached == maybe_bool::maybe)
+        cached = traversable(p);
+    return bool(cached);
 }
 
 // Since traversable_memoized is only called for spaces that were at least
@@ -432,7 +511,7 @@ bool monster_pathfind::traversable_memoized(const coord_def& p)
 // pathfinding range.
 bool monster_pathfind::is_reachable(const coord_def& p)
 {
-    return dist[p.x][p.y] <= range && bool(traversable_cache[p.x][p.y]);
+    return dist_at(p) <= range && bool(traversable_at(p));
 }
 
 bool monster_pathfind::traversable(const coord_def& p)
@@ -535,16 +614,18 @@ int monster_pathfind::estimated_cost(coord_def p)
 
 void monster_pathfind::add_new_pos(coord_def npos, int total)
 {
-    hash[total].push_back(npos);
+    ws->hash[total].push_back(npos);
+    ws->hash_min = min(ws->hash_min, total);
+    ws->hash_max = max(ws->hash_max, total);
 }
 
 void monster_pathfind::update_pos(coord_def npos, int total)
 {
     // Find hash position of old distance and delete it,
     // then call_add_new_pos.
-    int old_total = dist[npos.x][npos.y] + estimated_cost(npos);
+    int old_total = dist_at(npos) + estimated_cost(npos);
 
-    vector<coord_def> &vec = hash[old_total];
+    vector<coord_def> &vec = ws->hash[old_total];
     for (unsigned int i = 0; i < vec.size(); i++)
     {
         if (vec[i] == npos)
@@ -556,3 +637,214 @@ void monster_pathfind::update_pos(coord_def npos, int total)
 
     add_new_pos(npos, total);
 }
+
+/////////////////////////////////////////////////////////////////////////////
+// player_flow
+//
+// Most pathfinds are hostile monsters tracking the player, and many of those
+// monsters move the same way. Rather than running one A* search per monster,
+// a flow field holds the distance from every cell to the player (within the
+// given range) for one movement class, and every monster of that class just
+// walks it downhill. The search is the same as monster_pathfind's, only run
+// backwards from the player, so the resulting paths are equally short.
+
+// Everything about a hostile monster that monster_pathfind's traversable()
+// and travel_cost() look at.
+struct flow_key
+{
+    habitat_type habitat;
+    bool deep_water;
+    bool ground_level;
+    bool extra_balanced;
+    bool doors;
+    int range;
+
+    bool operator==(const flow_key &other) const
+    {
+        return habitat == other.habitat && deep_water == other.deep_water
+               && ground_level == other.ground_level
+               && extra_balanced == other.extra_balanced
+               && doors == other.doors && range == other.range;
+    }
+};
+
+static flow_key _flow_key(const monster* mon, int range)
+{
+    flow_key key;
+    key.habitat = mons_habitat(*mon);
+    key.deep_water = mons_habitat(*mon, true) & HT_DEEP_WATER;
+    key.ground_level = mon->ground_level();
+    key.extra_balanced = mons_genus(mon->type) == MONS_NAGA
+                         || mons_genus(mon->type) == MONS_SALAMANDER
+                         || mon->body_size(PSIZE_BODY) >= SIZE_LARGE;
+    key.doors = mon->can_pass_through_feat(DNGN_FLOOR)
+                && (mons_itemuse(*mon) >= MONUSE_OPEN_DOORS
+                    || mons_eats_items(*mon)
+                    || mons_class_flag(mons_base_type(*mon), M_EAT_DOORS)
+                    || mons_class_flag(mons_base_type(*mon), M_CRASH_DOORS));
+    key.range = range;
+    return key;
+}
+
+class player_flow : public monster_pathfind
+{
+public:
+    player_flow() : valid(false), key(), place(), origin(), time(-1)
+    {
+    }
+
+    bool current() const
+    {
+        return valid && place == level_id::current() && origin == you.pos()
+               && time == you.elapsed_time;
+    }
+
+    void fill(const monster* mon, const flow_key &k);
+    bool waypoints_from(const monster* mon, vector<coord_def>& waypoints);
+
+    bool valid;
+    flow_key key;
+
+private:
+    level_id place;
+    coord_def origin;
+    int time;
+};
+
+// A Dijkstra search outward from the player. Costs are small integers, so
+// the hash doubles as a bucket queue; a cell may sit in several buckets, and
+// only the entry matching its final distance is expanded.
+void player_flow::fill(const monster* mon, const flow_key &k)
+{
+    mons = mon;
+    start = target = pos = you.pos();
+    allow_diagonals = true;
+    traverse_unmapped = false;
+    traverse_in_sight = false;
+    traverse_no_actors = false;
+    fill_range = false;
+    range = k.range;
+
+    valid = true;
+    key = k;
+    place = level_id::current();
+    origin = you.pos();
+    time = you.elapsed_time;
+
+    ws->new_generation();
+    touch(target);
+    ws->dist[target.x][target.y] = 0;
+    add_new_pos(target, 0);
+
+    const int rotate = random2(4) * 2;
+    for (int i = 0; i <= ws->hash_max; i++)
+    {
+        while (!ws->hash[i].empty())
+        {
+            pos = ws->hash[i].back();
+            ws->hash[i].pop_back();
+            if (dist_at(pos) != i)
+                continue;
+
+            // As in calc_path_to_neighbours(), the target itself need not
+            // be traversable.
+            if (pos != target && !traversable_memoized(pos))
+                continue;
+
+            // The cost of stepping from any neighbour onto pos.
+            const int distance = i + travel_cost(pos);
+            if (distance > range * 2)
+                continue;
+
+            for (int idir = 1; idir < 8; (idir += 2) == 9 && (idir = 0))
+            {
+                const int dir = (idir + rotate) % 8;
+                const coord_def npos = pos + Compass[dir];
+
+                if (!in_bounds(npos) || grid_distance(npos, target) > range)
+                    continue;
+
+                if (distance < dist_at(npos))
+                {
+                    touch(npos);
+                    ws->dist[npos.x][npos.y] = distance;
+                    // Monsters at npos step back towards pos.
+                    ws->prev[npos.x][npos.y] = (dir + 4) % 8;
+                    add_new_pos(npos, distance);
+                }
+            }
+        }
+    }
+}
+
+bool player_flow::waypoints_from(const monster* mon,
+                                 vector<coord_def>& waypoints)
+{
+    if (dist_at(mon->pos()) == INFINITE_DISTANCE)
+        return false;
+
+    vector<coord_def> path;
+    for (coord_def p = mon->pos(); p != target; p = next_pos(p))
+        path.push_back(p);
+    path.push_back(target);
+
+    mons = mon;
+    waypoints = path_waypoints(path);
+    return !waypoints.empty();
+}
+
+static vector<unique_ptr<player_flow>> player_flows;
+
+// How many movement classes to keep flow fields for at once.
+static const size_t MAX_PLAYER_FLOWS = 8;
+static size_t next_evicted_flow = 0;
+
+/**
+ * Find a path for a monster hunting the player using a flow field shared
+ * with other monsters that move the same way.
+ *
+ * @param mon        the monster; must be a hostile with the player as foe.
+ * @param range      the monster's tracking range.
+ * @param waypoints  set to the path's waypoints if one was found.
+ * @return           true if a path was found.
+ */
+bool player_flow_waypoints(const monster* mon, int range,
+                           vector<coord_def>& waypoints)
+{
+    ASSERT(!mon->wont_attack());
+    ASSERT(!crawl_state.game_is_arena());
+    ASSERT(mon->type != MONS_THORN_HUNTER);
+
+    const flow_key key = _flow_key(mon, range);
+    player_flow *flow = nullptr;
+    for (auto &f : player_flows)
+    {
+        if (f->current() && f->key == key)
+            return f->waypoints_from(mon, waypoints);
+        if (!flow && !f->current())
+            flow = f.get();
+    }
+
+    if (!flow)
+    {
+        if (player_flows.size() < MAX_PLAYER_FLOWS)
+        {
+            player_flows.emplace_back(new player_flow());
+            flow = player_flows.back().get();
+        }
+        else
+        {
+            flow = player_flows[next_evicted_flow].get();
+            next_evicted_flow = (next_evicted_flow + 1) % MAX_PLAYER_FLOWS;
+        }
+    }
+
+    flow->fill(mon, key);
+    return flow->waypoints_from(mon, waypoints);
+}
+
+void invalidate_player_flows()
+{
+    for (auto &f : player_flows)
+        f->valid = false;
+}
@@ -10,8 +10,12 @@
 using std::vector;
 
 class monster;
+struct pathfind_workspace;
 
 int mons_tracking_range(const monster* mon);
+bool player_flow_waypoints(const monster* mon, int range,
+                           vector<coord_def>& waypoints);
+void invalidate_player_flows();
 
 class monster_pathfind
 {
@@ -19,6 +23,10 @@ public:
     monster_pathfind();
     virtual ~monster_pathfind();
 
+    // Each instance holds a pooled workspace.
+    monster_pathfind(const monster_pathfind&) = delete;
+    monster_pathfind& operator=(const monster_pathfind&) = delete;
+
     // public methods
     void set_range(int r);
     coord_def next_pos(const coord_def &p) const;
@@ -47,6 +55,10 @@ protected:
     void add_new_pos(coord_def pos, int total);
     void update_pos(coord_def pos, int total);
     bool get_best_position();
+    vector<coord_def> path_waypoints(const vector<coord_def>& path);
+    int  dist_at(const coord_def& p) const;
+    maybe_bool traversable_at(const coord_def& p) const;
+    void touch(const coord_def& p);
 
     // The monster trying to find a path.
     const monster* mons;
@@ -85,12 +97,7 @@ protected:
     int min_length;
     int max_length;
 
-    // The array of distances from start to any already tried point.
-    int dist[GXM][GYM];
-    // An array to store where we came from on a given shortest path.
-    int prev[GXM][GYM];
-
-    FixedVector<vector<coord_def>, GXM * GYM> hash;
-
-    maybe_bool traversable_cache[GXM][GYM];
+    // Distances, backtracking information and the traversability cache,
+    // reused between pathfinds rather than allocated and cleared each time.
+    pathfind_workspace *ws;
 };
@@ -827,8 +827,10 @@ monster* get_free_monster()
     for (auto &mons : menv_real)
         if (mons.type == MONS_NO_MONSTER)
         {
-            if (mons.mindex() > env.max_mon_index)
-                env.max_mon_index = mons.mindex();
+            vector<int> &slots = env.active_mons;
+            auto it = lower_bound(slots.begin(), slots.end(), mons.mindex());
+            if (it == slots.end() || *it != mons.mindex())
+                slots.insert(it, mons.mindex());
 
             mons.reset();
             return &mons;
@@ -4957,6 +4957,7 @@ void reset_all_monsters()
     }
 
     env.mid_cache.clear();
+    env.active_mons.clear();
 }
 
 bool mons_is_recallable(const actor* caller, const monster& targ)
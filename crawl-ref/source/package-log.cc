@@ -0,0 +1,764 @@
+/**
+ * @file
+ * @brief An append-only, memory-mapped save file backend.
+**/
+
+/*
+Built instead of package.cc when USE_SAVE_LOG is defined (make SAVE_LOG=y).
+The interface is the same, the file format is not: saves made by one backend
+can't be read by the other.
+
+Format:
+* A file header, followed by records. A chunk record holds a whole chunk,
+  stored raw or compressed. A commit record holds the directory: the names
+  and record offsets of all chunks as of that commit.
+* Records are only ever appended. The save's state is that of the last
+  commit record with an intact checksum; anything past it is the remains of
+  an interrupted write and is cut off when the save is opened for writing.
+
+Guarantees are the same as package.cc's:
+* A crash at any moment may not cause corruption -- commit() flushes the
+  chunk records before appending the commit record, and flushes again after.
+* Readers get the last complete write at the time they started, and are not
+  affected by later writes or compaction.
+
+Superseded records are left in place until they take up more than half of a
+sizeable file; commit() then copies the live records to a new file and
+renames it over the old one.
+
+Readers map the file and serve uncompressed chunks straight from the
+mapping; compressed ones are unpacked once, when the reader is created.
+Writers buffer their chunk and append it with a single write when closed.
+*/
+
+#include "AppHdr.h"
+
+#ifdef USE_SAVE_LOG
+
+#include "package.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#include "end.h"
+#include "endianness.h"
+#include "errors.h"
+#include "syscalls.h"
+#include "libutil.h" // map_find
+
+// debugging defines
+#undef  DEBUG_PACKAGE
+
+#ifdef DEBUG_PACKAGE
+#define dprintf(...) printf(__VA_ARGS__)
+#else
+#define dprintf(...) do {} while (0)
+#endif
+
+#define LOG_VERSION   1
+#define LOG_MAGIC     0x4c534344 /* "DCSL" */
+#define RECORD_MAGIC  0x52534344 /* "DCSR" */
+#define BLOCK_MAGIC   0x53534344 /* "DCSS", package.cc's format */
+
+// Chunks smaller than this are not worth compressing.
+#define MIN_COMPRESS_LEN 64
+// Files smaller than this are never compacted.
+#define MIN_COMPACT_LEN (1 << 20)
+
+enum record_type : uint8_t
+{
+    RECORD_CHUNK = 1,
+    RECORD_COMMIT,
+};
+
+enum record_codec : uint8_t
+{
+    CODEC_NONE,
+    CODEC_ZLIB,
+    CODEC_LZ4,
+};
+
+struct log_header
+{
+    uint32_t magic;
+    uint8_t version;
+    char padding[3];
+};
+
+struct record_header
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t codec;
+    uint8_t name_len;
+    uint8_t padding;
+    uint32_t raw_len;
+    uint32_t stored_len;
+    // crc32 of the name and the stored data
+    uint32_t checksum;
+};
+
+struct package_mapping
+{
+    package_mapping(int fd, plen_t _len) : len(_len)
+    {
+        void *m = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED)
+            sysfail("can't map the save file");
+        base = (const char*)m;
+    }
+
+    ~package_mapping()
+    {
+        munmap((void*)base, len);
+    }
+
+    const char *base;
+    plen_t len;
+};
+
+static record_header _record_at(const package_mapping &m, plen_t at)
+{
+    record_header rec;
+    memcpy(&rec, m.base + at, sizeof(rec));
+    rec.magic = htole32(rec.magic);
+    rec.raw_len = htole32(rec.raw_len);
+    rec.stored_len = htole32(rec.stored_len);
+    rec.checksum = htole32(rec.checksum);
+    return rec;
+}
+
+// The length of a whole record, or 0 if there's no valid one at this point.
+static plen_t _record_len(const package_mapping &m, plen_t at, plen_t end)
+{
+    if (at > end || end - at < sizeof(record_header))
+        return 0;
+
+    const record_header rec = _record_at(m, at);
+    if (rec.magic != RECORD_MAGIC)
+        return 0;
+
+    const uint64_t len = (uint64_t)sizeof(rec) + rec.name_len + rec.stored_len;
+    if (len > end - at)
+        return 0;
+    return len;
+}
+
+static uint32_t _checksum(const char *name, plen_t name_len,
+                          const char *data, plen_t len)
+{
+    uLong crc = crc32(0, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)name, name_len);
+    crc = crc32(crc, (const Bytef*)data, len);
+    return crc;
+}
+
+static bool _record_intact(const package_mapping &m, plen_t at)
+{
+    const record_header rec = _record_at(m, at);
+    const char *name = m.base + at + sizeof(rec);
+    return rec.checksum == _checksum(name, rec.name_len,
+                                     name + rec.name_len, rec.stored_len);
+}
+
+static void _write_at(int fd, const void *data, plen_t len, plen_t at)
+{
+    while (len)
+    {
+        ssize_t res = pwrite(fd, data, len, at);
+        if (res <= 0)
+            sysfail("write error while saving");
+        data = (const char*)data + res;
+        len -= res;
+        at += res;
+    }
+}
+
+package::package(const char* file, bool writeable, bool empty)
+  : n_users(0), dirty(false), aborted(false),
+#ifdef DO_FSYNC
+    tmp(false),
+#endif
+    temporary(false), live_len(0), commit_len(0)
+{
+    dprintf("package: initializing file=\"%s\" rw=%d\n", file, writeable);
+    ASSERT(writeable || !empty);
+    filename = file;
+    rw = writeable;
+
+    if (empty)
+    {
+        fd = open_u(file, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+        if (fd == -1)
+            sysfail("can't create save file (%s)", file);
+
+        if (!lock_file(fd, true))
+        {
+            close(fd);
+            sysfail("failed to lock newly created save (%s)", file);
+        }
+
+        write_header();
+        dirty = true;
+    }
+    else
+    {
+        fd = open_u(file, (writeable? O_RDWR : O_RDONLY) | O_BINARY, 0666);
+        if (fd == -1)
+            sysfail("can't open save file (%s)", file);
+
+        try
+        {
+            if (!lock_file(fd, writeable))
+            {
+                game_ended(game_exit::abort,
+                    "Another game is already in progress using this save!");
+            }
+
+            load();
+        }
+        catch (const exception&)
+        {
+            close(fd);
+            throw;
+        }
+    }
+}
+
+package::package()
+  : rw(true), n_users(0), dirty(false), aborted(false),
+#ifdef DO_FSYNC
+    tmp(true),
+#endif
+    temporary(true), live_len(0), commit_len(0)
+{
+    dprintf("package: initializing tmp file\n");
+    filename = "[tmp]";
+
+    char file[7] = "XXXXXX";
+    fd = mkstemp(file);
+    if (fd == -1)
+        sysfail("can't create temporary save file");
+
+    ::unlink(file);
+
+    if (!lock_file(fd, true))
+    {
+        close(fd);
+        sysfail("failed to lock newly created save (%s)", file);
+    }
+
+    write_header();
+    dirty = true;
+}
+
+package::~package()
+{
+    dprintf("package: finalizing\n");
+    ASSERT(!n_users || CrawlIsCrashing); // see package.cc
+
+    if (rw && !aborted)
+        commit();
+
+    mapping.reset();
+    // all errors here should be cached write errors
+    if (fd != -1)
+        if (close(fd) && !aborted)
+        {
+            sysfail(rw ? "write error while saving"
+                       : "can't close the save I've just read???");
+        }
+}
+
+void package::write_header()
+{
+    log_header head;
+    head.magic = htole32(LOG_MAGIC);
+    head.version = LOG_VERSION;
+    memset(&head.padding, 0, sizeof(head.padding));
+    _write_at(fd, &head, sizeof(head), 0);
+    file_len = sizeof(head);
+}
+
+// A mapping of the file that covers [0, end).
+shared_ptr<package_mapping> package::map_file(plen_t end)
+{
+    ASSERT(end <= file_len);
+    if (!mapping || mapping->len < end)
+        mapping = make_shared<package_mapping>(fd, file_len);
+    return mapping;
+}
+
+void package::load()
+{
+    struct stat st;
+    if (fstat(fd, &st))
+        sysfail("error reading the save file (%s)", filename.c_str());
+    if (!st.st_size)
+        corrupted("The save file (%s) is empty!", filename.c_str());
+    if ((size_t)st.st_size < sizeof(log_header))
+        corrupted("save file (%s) corrupted -- header truncated", filename.c_str());
+    if ((uint64_t)st.st_size > (plen_t)-1)
+        corrupted("save file (%s) corrupted -- too large", filename.c_str());
+    file_len = st.st_size;
+
+    const shared_ptr<package_mapping> m = map_file(file_len);
+
+    log_header head;
+    memcpy(&head, m->base, sizeof(head));
+    if (htole32(head.magic) == BLOCK_MAGIC)
+    {
+        corrupted("save file (%s) uses the block format, which this build "
+                  "can't read", filename.c_str());
+    }
+    if (htole32(head.magic) != LOG_MAGIC)
+    {
+        corrupted("save file (%s) corrupted -- not a DCSS save file",
+             filename.c_str());
+    }
+    if (head.version != LOG_VERSION)
+    {
+        corrupted("save file (%s) uses an unknown format %u", filename.c_str(),
+             head.version);
+    }
+
+    // Find the last intact commit.
+    plen_t at = sizeof(head), last_commit = 0, end = at;
+    while (plen_t len = _record_len(*m, at, file_len))
+    {
+        const record_header rec = _record_at(*m, at);
+        if (rec.type == RECORD_COMMIT)
+        {
+            if (!_record_intact(*m, at))
+                break;
+            last_commit = at;
+            end = at + len;
+        }
+        else if (rec.type != RECORD_CHUNK)
+            break;
+        at += len;
+    }
+
+    if (!last_commit)
+        corrupted("The save file (%s) is empty!", filename.c_str());
+
+    commit_len = end - last_commit;
+    const record_header rec = _record_at(*m, last_commit);
+    const char *dir = m->base + last_commit + sizeof(rec) + rec.name_len;
+    const char *dir_end = dir + rec.stored_len;
+    while (dir < dir_end)
+    {
+        const uint8_t name_len = *dir++;
+        plen_t start;
+        if (dir_end - dir < name_len + (ptrdiff_t)sizeof(start))
+            corrupted("save file corrupted -- truncated directory");
+        const string chname(dir, name_len);
+        dir += name_len;
+        memcpy(&start, dir, sizeof(start));
+        dir += sizeof(start);
+        start = htole32(start);
+
+        const plen_t len = _record_len(*m, start, last_commit);
+        if (!len || _record_at(*m, start).type != RECORD_CHUNK)
+            corrupted("save file corrupted -- chunk \"%s\" missing", chname.c_str());
+        directory[chname] = make_pair(start, len);
+        live_len += len;
+        dprintf("* %s\n", chname.c_str());
+    }
+
+    // Drop whatever a crash left behind the last commit.
+    if (rw && end < file_len)
+    {
+        mapping.reset();
+        if (ftruncate(fd, end))
+            sysfail("failed to update save file");
+        file_len = end;
+    }
+}
+
+void package::commit()
+{
+    ASSERT(rw);
+    if (!dirty)
+        return;
+    ASSERT(!aborted);
+
+#ifdef DO_FSYNC
+    // The chunks must be on disk before the commit that refers to them.
+    if (!tmp && fdatasync(fd))
+        sysfail("flush error while saving");
+#endif
+
+    vector<char> dir;
+    for (const auto &entry : directory)
+    {
+        dir.push_back((uint8_t)entry.first.length());
+        dir.insert(dir.end(), entry.first.begin(), entry.first.end());
+        const plen_t start = htole32(entry.second.first);
+        dir.insert(dir.end(), (const char*)&start,
+                   (const char*)&start + sizeof(start));
+    }
+
+    const plen_t at = append_record(RECORD_COMMIT, "", CODEC_NONE, dir.size(),
+                                    dir.data(), dir.size());
+    commit_len = file_len - at;
+#ifdef DO_FSYNC
+    if (!tmp && fdatasync(fd))
+        sysfail("flush error while saving");
+#endif
+    dirty = false;
+
+    if (file_len >= MIN_COMPACT_LEN && get_slack() > file_len / 2)
+        compact();
+}
+
+plen_t package::append_record(uint8_t type, const string &name, uint8_t codec,
+                              plen_t raw_len, const char *data, plen_t len)
+{
+    ASSERT(!aborted);
+    ASSERT(name.length() < MAX_CHUNK_NAME_LENGTH);
+
+    if ((uint64_t)file_len + sizeof(record_header) + name.length() + len
+        > (plen_t)-1)
+    {
+        fail("save file too large");
+    }
+
+    record_header rec;
+    rec.magic = htole32(RECORD_MAGIC);
+    rec.type = type;
+    rec.codec = codec;
+    rec.name_len = name.length();
+    rec.padding = 0;
+    rec.raw_len = htole32(raw_len);
+    rec.stored_len = htole32(len);
+    rec.checksum = htole32(_checksum(name.data(), name.length(), data, len));
+
+    // Header and name go out together; the data usually is the bulk.
+    string head((const char*)&rec, sizeof(rec));
+    head += name;
+
+    const plen_t at = file_len;
+    _write_at(fd, head.data(), head.length(), at);
+    _write_at(fd, data, len, at + head.length());
+    file_len += head.length() + len;
+    return at;
+}
+
+// Copy the current chunks into a new file, and replace the old one with it.
+void package::compact()
+{
+    ASSERT(!dirty);
+    dprintf("package: compacting %u bytes, %u live\n", file_len,
+            live_len + commit_len);
+
+    const shared_ptr<package_mapping> old = map_file(file_len);
+
+    int nfd;
+    string tmpname;
+    if (temporary)
+    {
+        char file[7] = "XXXXXX";
+        nfd = mkstemp(file);
+        // The template, or the name it was filled in with, for messages.
+        tmpname = file;
+        if (nfd != -1)
+            ::unlink(file);
+    }
+    else
+    {
+        tmpname = filename + ".compact";
+        nfd = open_u(tmpname.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY,
+                     0666);
+    }
+    if (nfd == -1)
+        sysfail("can't create save file (%s)", tmpname.c_str());
+    if (!lock_file(nfd, true))
+    {
+        close(nfd);
+        sysfail("failed to lock newly created save (%s)", tmpname.c_str());
+    }
+
+    const int old_fd = fd;
+    fd = nfd;
+    mapping.reset();
+    write_header();
+
+    // Records are copied whole, so their checksums stay valid.
+    live_len = 0;
+    for (auto &entry : directory)
+    {
+        const plen_t len = entry.second.second;
+        _write_at(fd, old->base + entry.second.first, len, file_len);
+        entry.second.first = file_len;
+        file_len += len;
+        live_len += len;
+    }
+
+    dirty = true;
+    commit();
+
+    if (!temporary && rename_u(tmpname.c_str(), filename.c_str()))
+        sysfail("failed to update save file (%s)", filename.c_str());
+    // Readers may still hold the old mapping; it outlives the descriptor.
+    close(old_fd);
+}
+
+chunk_writer* package::writer(const string &name)
+{
+    return new chunk_writer(this, name);
+}
+
+chunk_reader* package::reader(const string &name)
+{
+    if (directory.count(name))
+        return new chunk_reader(this, name);
+    return 0;
+}
+
+void package::finish_chunk(const string &name, plen_t at, plen_t len)
+{
+    free_chunk(name);
+    directory[name] = make_pair(at, len);
+    live_len += len;
+    dirty = true;
+}
+
+void package::free_chunk(const string &name)
+{
+    if (auto *entry = map_find(directory, name))
+    {
+        live_len -= entry->second;
+        dirty = true;
+    }
+}
+
+void package::delete_chunk(const string &name)
+{
+    free_chunk(name);
+    directory.erase(name);
+}
+
+bool package::has_chunk(const string &name)
+{
+    return !name.empty() && directory.count(name);
+}
+
+vector<string> package::list_chunks()
+{
+    vector<string> list;
+    list.reserve(directory.size());
+    for (const auto &entry : directory)
+        list.push_back(entry.first);
+
+    return list;
+}
+
+void package::abort()
+{
+    // Disable any further operations, allow a shutdown. All writes since
+    // the last commit() are lost.
+    aborted = true;
+}
+
+void package::unlink()
+{
+    abort();
+    mapping.reset();
+    close(fd);
+    fd = -1;
+    ::unlink_u(filename.c_str());
+}
+
+// Chunks are compressed in one go when closed, so there's nothing to overlap.
+void package::compress_in_background(bool on)
+{
+    UNUSED(on);
+}
+
+// the space taken by superseded records
+plen_t package::get_slack()
+{
+    return file_len - sizeof(log_header) - live_len - commit_len;
+}
+
+// Chunks are never split; "" stands for the directory, as in package.cc.
+plen_t package::get_chunk_fragmentation(const string &name)
+{
+    ASSERT(name.empty() || directory.count(name));
+    return 1;
+}
+
+plen_t package::get_chunk_compressed_length(const string &name)
+{
+    if (name.empty())
+        return commit_len - sizeof(record_header);
+    ASSERT(directory.count(name));
+    return directory[name].second - sizeof(record_header) - name.length();
+}
+
+chunk_writer::chunk_writer(package *parent, const string &_name)
+{
+    ASSERT(parent);
+    ASSERT(!parent->aborted);
+    ASSERT(_name.length() < MAX_CHUNK_NAME_LENGTH);
+
+    pkg = parent;
+    pkg->n_users++;
+    name = _name;
+}
+
+chunk_writer::~chunk_writer()
+{
+    ASSERT(pkg->n_users > 0);
+    pkg->n_users--;
+    if (pkg->aborted)
+        return;
+
+    uint8_t codec = CODEC_NONE;
+    const char *out = buf.data();
+    plen_t out_len = buf.size();
+    vector<char> packed;
+    if (buf.size() >= MIN_COMPRESS_LEN)
+    {
+#ifdef USE_LZ4
+        packed.resize(LZ4_compressBound(buf.size()));
+        const int len = LZ4_compress_default(buf.data(), packed.data(),
+                                             buf.size(), packed.size());
+        if (len > 0 && (plen_t)len < buf.size())
+        {
+            codec = CODEC_LZ4;
+            out = packed.data();
+            out_len = len;
+        }
+#else
+        uLongf len = compressBound(buf.size());
+        packed.resize(len);
+        if (compress2((Bytef*)packed.data(), &len, (const Bytef*)buf.data(),
+                      buf.size(), Z_BEST_SPEED) != Z_OK)
+        {
+            fail("save file compression failed");
+        }
+        if (len < buf.size())
+        {
+            codec = CODEC_ZLIB;
+            out = packed.data();
+            out_len = len;
+        }
+#endif
+    }
+
+    const plen_t at = pkg->append_record(RECORD_CHUNK, name, codec,
+                                         buf.size(), out, out_len);
+    pkg->finish_chunk(name, at, pkg->file_len - at);
+}
+
+void chunk_writer::write(const void *data, plen_t len)
+{
+    ASSERT(data);
+    ASSERT(!pkg->aborted);
+
+    buf.insert(buf.end(), (const char*)data, (const char*)data + len);
+}
+
+chunk_reader::chunk_reader(package *parent, const string &_name)
+    : data(nullptr), len(0), off(0)
+{
+    ASSERT(parent);
+    if (!parent->has_chunk(_name))
+        corrupted("save file corrupted -- chunk \"%s\" missing", _name.c_str());
+    pkg = parent;
+    ASSERT(!pkg->aborted);
+    pkg->n_users++;
+
+    const pair<plen_t, plen_t> entry = pkg->directory[_name];
+    mapping = pkg->map_file(entry.first + entry.second);
+    if (!_record_intact(*mapping, entry.first))
+        corrupted("save file corrupted -- chunk \"%s\" damaged", _name.c_str());
+
+    const record_header rec = _record_at(*mapping, entry.first);
+    const char *stored = mapping->base + entry.first + sizeof(rec)
+                         + rec.name_len;
+    len = rec.raw_len;
+
+    switch (rec.codec)
+    {
+    case CODEC_NONE:
+        if (rec.stored_len != rec.raw_len)
+            corrupted("save file corrupted -- chunk \"%s\" damaged", _name.c_str());
+        data = stored;
+        return;
+    case CODEC_ZLIB:
+    {
+        unpacked.resize(len);
+        uLongf unpacked_len = len;
+        if (uncompress((Bytef*)unpacked.data(), &unpacked_len,
+                       (const Bytef*)stored, rec.stored_len) != Z_OK
+            || unpacked_len != len)
+        {
+            corrupted("save file decompression failed");
+        }
+        break;
+    }
+#ifdef USE_LZ4
+    case CODEC_LZ4:
+        unpacked.resize(len);
+        if (LZ4_decompress_safe(stored, unpacked.data(), rec.stored_len, len)
+            != (int)len)
+        {
+            corrupted("save file decompression failed");
+        }
+        break;
+#endif
+    default:
+        corrupted("save file (%s) uses an unknown compression %u",
+                  pkg->filename.c_str(), rec.codec);
+    }
+
+    // Nothing points into the file any more.
+    mapping.reset();
+    data = unpacked.data();
+}
+
+chunk_reader::~chunk_reader()
+{
+    ASSERT(pkg->n_users > 0);
+    pkg->n_users--;
+}
+
+plen_t chunk_reader::read(void *buf, plen_t size)
+{
+    ASSERT(buf);
+    if (pkg->aborted)
+        return 0;
+
+    if (size > len - off)
+        size = len - off;
+    if (size)
+        memcpy(buf, data + off, size);
+    off += size;
+    return size;
+}
+
+void chunk_reader::read_all(vector<char> &buf)
+{
+    buf.insert(buf.end(), data + off, data + len);
+    off = len;
+}
+
+const char *chunk_reader::contents(plen_t &size) const
+{
+    size = len - off;
+    return data + off;
+}
+
+#endif
@@ -16,15 +16,26 @@ Notes:
 * Readers always get the last complete (but not necessarily committed) write
   (ie, READ_UNCOMMITTED) at the time they started; it is safe to continue
   reading even if the chunk has been changed since.
+* With DO_FSYNC on Unix, commit() only writes the directory; the barriers and
+  the header update are done by a background thread. Blocks freed by that
+  commit are not reused until it is on disk, so the game may go on writing
+  chunks meanwhile. The next commit(), unlink() or the destructor wait for it.
+* After compress_in_background(true), closed chunks are compressed by another
+  thread and stored in the order they were written, the next time the package
+  is used. Anything that looks at the stored chunks waits for them first.
 */
 
 #include "AppHdr.h"
 
+// See package-log.cc for the alternative backend.
+#ifndef USE_SAVE_LOG
+
 #include "package.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <sstream>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -38,6 +49,17 @@ Notes:
 #include "errors.h"
 #include "syscalls.h"
 #include "libutil.h" // map_find
+#if defined(DO_FSYNC) && defined(UNIX)
+#define ASYNC_COMMIT
+#include <atomic>
+#endif
+#if defined(USE_ZLIB) && defined(UNIX)
+#define ASYNC_COMPRESS
+#include <deque>
+#endif
+#if defined(ASYNC_COMMIT) || defined(ASYNC_COMPRESS)
+#include "threads.h"
+#endif
 
 // debugging defines
 #undef  FSCK_VERBOSE
@@ -62,6 +84,9 @@ static plen_t htole(plen_t x)
 #define PACKAGE_VERSION 1
 #define PACKAGE_MAGIC   0x53534344 /* "DCSS" */
 
+// How many chunks may wait for compression before writers have to wait.
+#define MAX_QUEUED_CHUNKS 4
+
 struct file_header
 {
     uint32_t magic;
@@ -81,11 +106,126 @@ typedef pair<plen_t, plen_t> bm_p;
 typedef map<plen_t, bm_p> bm_t;
 typedef map<plen_t, plen_t> fb_t;
 
+#ifdef DO_FSYNC
+struct commit_flush
+{
+#ifdef ASYNC_COMMIT
+    thread_t thread;
+    bool joinable;
+    atomic<bool> done;
+#endif
+    int fd;
+    file_header head;
+    // blocks unlinked by this commit, to be freed once it's on disk
+    vector<plen_t> unlinked_blocks;
+    const char *error;
+    int error_no;
+};
+
+#ifdef ASYNC_COMMIT
+static void *_flush_commit(void *arg)
+{
+    commit_flush *fl = (commit_flush*)arg;
+
+    // We need a barrier before updating the link to point at the new directory.
+    if (fdatasync(fl->fd))
+        fl->error = "flush error while saving";
+    // The game thread may be seeking around, so don't touch the file offset.
+    else if (pwrite(fl->fd, &fl->head, sizeof(fl->head), 0)
+             != sizeof(fl->head))
+    {
+        fl->error = "write error while saving";
+    }
+    else if (fdatasync(fl->fd))
+        fl->error = "flush error while saving";
+
+    if (fl->error)
+        fl->error_no = errno;
+    fl->done = true;
+    return 0;
+}
+#endif
+#endif
+
+#ifdef ASYNC_COMPRESS
+struct chunk_job
+{
+    string name;
+    vector<char> raw;
+    vector<char> packed;
+    bool done;
+    bool failed;
+};
+
+struct chunk_compressor
+{
+    thread_t thread;
+    mutex_t lock;
+    // signalled when a job is queued, or the thread should quit
+    cond_t queued;
+    // signalled when a job is done
+    cond_t compressed;
+    // all unstored jobs, oldest first, and those not yet started
+    deque<chunk_job*> jobs;
+    deque<chunk_job*> todo;
+    bool quit;
+};
+
+// The same stream chunk_writer::write() would produce.
+static bool _deflate_chunk(chunk_job &job)
+{
+    z_stream zs;
+    zs.data_type = Z_BINARY;
+    zs.zalloc    = 0;
+    zs.zfree     = 0;
+    zs.opaque    = Z_NULL;
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION))
+        return false;
+
+    job.packed.resize(deflateBound(&zs, job.raw.size()));
+    zs.next_in   = (Bytef*)job.raw.data();
+    zs.avail_in  = job.raw.size();
+    zs.next_out  = (Bytef*)job.packed.data();
+    zs.avail_out = job.packed.size();
+    const int res = deflate(&zs, Z_FINISH);
+    job.packed.resize(zs.next_out - (Bytef*)job.packed.data());
+    return deflateEnd(&zs) == Z_OK && res == Z_STREAM_END;
+}
+
+static void *_compress_chunks(void *arg)
+{
+    chunk_compressor *cc = (chunk_compressor*)arg;
+
+    mutex_lock(cc->lock);
+    while (true)
+    {
+        while (cc->todo.empty() && !cc->quit)
+            cond_wait(cc->queued, cc->lock);
+        if (cc->todo.empty())
+            break;
+
+        chunk_job *job = cc->todo.front();
+        cc->todo.pop_front();
+        mutex_unlock(cc->lock);
+
+        job->failed = !_deflate_chunk(*job);
+        vector<char>().swap(job->raw);
+
+        mutex_lock(cc->lock);
+        job->done = true;
+        cond_wake(cc->compressed);
+    }
+    mutex_unlock(cc->lock);
+    return 0;
+}
+#endif
+
 package::package(const char* file, bool writeable, bool empty)
   : n_users(0), dirty(false), aborted(false)
 #ifdef DO_FSYNC
-    , tmp(false)
+    , tmp(false), flush(nullptr)
 #endif
+    , compressor(nullptr)
 {
     dprintf("package: initializing file=\"%s\" rw=%d\n", file, writeable);
     ASSERT(writeable || !empty);
@@ -134,8 +274,9 @@ package::package(const char* file, bool writeable, bool empty)
 package::package()
   : rw(true), n_users(0), dirty(false), aborted(false)
 #ifdef DO_FSYNC
-    , tmp(true)
+    , tmp(true), flush(nullptr)
 #endif
+    , compressor(nullptr)
 {
     dprintf("package: initializing tmp file\n");
     filename = "[tmp]";
@@ -214,12 +355,21 @@ package::~package()
         // catching missing manual deletes. The C++ exit handler is the
         // only place that can be legitimately call things in wrong order.
 
+    compress_in_background(false);
+
     if (rw && !aborted)
     {
         commit();
+#ifdef DO_FSYNC
+        finish_flush();
+#endif
         if (ftruncate(fd, file_len))
             sysfail("failed to update save file");
     }
+#ifdef DO_FSYNC
+    else
+        finish_flush();
+#endif
 
     // all errors here should be cached write errors
     if (fd != -1)
@@ -238,15 +388,43 @@ void package::commit()
         return;
     ASSERT(!aborted);
 
+    store_chunks(true);
+
 #ifdef COSTLY_ASSERTS
     fsck();
 #endif
 
+#ifdef DO_FSYNC
+    // Commits must reach the disk in order.
+    finish_flush();
+#endif
+
     file_header head;
     head.magic = htole(PACKAGE_MAGIC);
     head.version = PACKAGE_VERSION;
     memset(&head.padding, 0, sizeof(head.padding));
     head.start = htole(write_directory());
+#ifdef ASYNC_COMMIT
+    if (!tmp)
+    {
+        flush = new commit_flush;
+        flush->fd = fd;
+        flush->head = head;
+        flush->error = nullptr;
+        flush->error_no = 0;
+        flush->done = false;
+        // Blocks unlinked from now on belong to the next commit.
+        flush->unlinked_blocks.swap(unlinked_blocks);
+        flush->joinable = !thread_create_joinable(&flush->thread,
+                                                  _flush_commit, flush);
+        if (!flush->joinable)
+            _flush_commit(flush);
+
+        new_chunks.clear();
+        dirty = false;
+        return;
+    }
+#endif
 #ifdef DO_FSYNC
     // We need a barrier before updating the link to point at the new directory.
     if (!tmp && fdatasync(fd))
@@ -269,6 +447,38 @@ void package::commit()
 #endif
 }
 
+#ifdef DO_FSYNC
+// Wait for the commit being flushed in the background, and free the blocks
+// it has made unused.
+void package::finish_flush()
+{
+    if (!flush)
+        return;
+
+#ifdef ASYNC_COMMIT
+    if (flush->joinable)
+        thread_join(flush->thread);
+#endif
+    const char *error = flush->error;
+    const int error_no = flush->error_no;
+    vector<plen_t> blocks;
+    blocks.swap(flush->unlinked_blocks);
+    delete flush;
+    flush = nullptr;
+
+    if (aborted)
+        return;
+    if (error)
+    {
+        errno = error_no;
+        sysfail("%s", error);
+    }
+
+    for (plen_t at : blocks)
+        free_block_chain(at);
+}
+#endif
+
 void package::seek(plen_t to)
 {
     ASSERT(!aborted);
@@ -281,11 +491,18 @@ void package::seek(plen_t to)
 
 chunk_writer* package::writer(const string &name)
 {
+#ifdef ASYNC_COMMIT
+    // Reclaim the space of a commit that has reached the disk meanwhile.
+    if (flush && flush->done)
+        finish_flush();
+#endif
+    store_chunks(false);
     return new chunk_writer(this, name);
 }
 
 chunk_reader* package::reader(const string &name)
 {
+    store_chunks(true);
     if (plen_t *ch = map_find(directory, name))
         return new chunk_reader(this, *ch);
     return 0;
@@ -384,6 +601,7 @@ void package::free_chunk(const string &name)
 
 void package::delete_chunk(const string &name)
 {
+    store_chunks(true);
     free_chunk(name);
     directory.erase(name);
 }
@@ -564,11 +782,12 @@ void package::read_directory(plen_t start, uint8_t version)
 
 bool package::has_chunk(const string &name)
 {
-    return !name.empty() && directory.count(name);
+    return !name.empty() && (directory.count(name) || chunk_queued(name));
 }
 
 vector<string> package::list_chunks()
 {
+    store_chunks(true);
     vector<string> list;
     list.reserve(directory.size());
     for (const auto &entry : directory)
@@ -625,14 +844,152 @@ void package::abort()
 void package::unlink()
 {
     abort();
+    compress_in_background(false);
+#ifdef DO_FSYNC
+    finish_flush();
+#endif
     close(fd);
     fd = -1;
     ::unlink_u(filename.c_str());
 }
 
+// Compress chunks on another thread while the game goes on; worth it when
+// many are written in a row, as during level pregeneration.
+void package::compress_in_background(bool on)
+{
+#ifdef ASYNC_COMPRESS
+    if (on == !!compressor)
+        return;
+
+    if (on)
+    {
+        ASSERT(rw);
+        chunk_compressor *cc = new chunk_compressor;
+        mutex_init(cc->lock);
+        cond_init(cc->queued);
+        cond_init(cc->compressed);
+        cc->quit = false;
+        if (thread_create_joinable(&cc->thread, _compress_chunks, cc))
+        {
+            // no thread, so compress as usual
+            cond_destroy(cc->compressed);
+            cond_destroy(cc->queued);
+            mutex_destroy(cc->lock);
+            delete cc;
+            return;
+        }
+        compressor = cc;
+        return;
+    }
+
+    chunk_compressor *cc = compressor;
+    mutex_lock(cc->lock);
+    cc->quit = true;
+    cond_wake(cc->queued);
+    mutex_unlock(cc->lock);
+    // The thread finishes every queued job before quitting.
+    thread_join(cc->thread);
+
+    store_chunks(true);
+    compressor = nullptr;
+    cond_destroy(cc->compressed);
+    cond_destroy(cc->queued);
+    mutex_destroy(cc->lock);
+    delete cc;
+#else
+    UNUSED(on);
+#endif
+}
+
+void package::queue_chunk(const string &name, vector<char> *raw)
+{
+#ifdef ASYNC_COMPRESS
+    chunk_job *job = new chunk_job;
+    job->name = name;
+    job->raw.swap(*raw);
+    job->done = false;
+    job->failed = false;
+
+    mutex_lock(compressor->lock);
+    compressor->jobs.push_back(job);
+    compressor->todo.push_back(job);
+    const bool full = compressor->jobs.size() > MAX_QUEUED_CHUNKS;
+    cond_wake(compressor->queued);
+    mutex_unlock(compressor->lock);
+
+    if (full)
+        store_chunks(true);
+#else
+    UNUSED(name, raw);
+    die("no background compression");
+#endif
+}
+
+// Write compressed chunks to the file, oldest first. Unless `wait` is set,
+// stop at the first one that isn't compressed yet.
+void package::store_chunks(bool wait)
+{
+#ifdef ASYNC_COMPRESS
+    if (!compressor)
+        return;
+
+    while (true)
+    {
+        mutex_lock(compressor->lock);
+        if (compressor->jobs.empty())
+        {
+            mutex_unlock(compressor->lock);
+            return;
+        }
+        chunk_job *job = compressor->jobs.front();
+        if (!job->done)
+        {
+            if (wait)
+                cond_wait(compressor->compressed, compressor->lock);
+            mutex_unlock(compressor->lock);
+            if (wait)
+                continue;
+            return;
+        }
+        compressor->jobs.pop_front();
+        mutex_unlock(compressor->lock);
+
+        unique_ptr<chunk_job> done(job);
+        if (aborted)
+            continue;
+        if (done->failed)
+            fail("save file compression failed");
+        chunk_writer out(this, done->name, true);
+        out.write(done->packed.data(), done->packed.size());
+    }
+#else
+    UNUSED(wait);
+#endif
+}
+
+bool package::chunk_queued(const string &name)
+{
+#ifdef ASYNC_COMPRESS
+    if (!compressor)
+        return false;
+
+    mutex_lock(compressor->lock);
+    bool found = false;
+    for (const chunk_job *job : compressor->jobs)
+        if (job->name == name)
+            found = true;
+    mutex_unlock(compressor->lock);
+    return found;
+#else
+    UNUSED(name);
+    return false;
+#endif
+}
+
 // the amount of free space not at the end of file
 plen_t package::get_slack()
 {
+    store_chunks(true);
     load_traces();
 
     plen_t slack = 0;
@@ -643,6 +1000,7 @@ plen_t package::get_slack()
 
 plen_t package::get_chunk_fragmentation(const string &name)
 {
+    store_chunks(true);
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t frags = 0;
@@ -659,6 +1017,7 @@ plen_t package::get_chunk_fragmentation(const string &name)
 
 plen_t package::get_chunk_compressed_length(const string &name)
 {
+    store_chunks(true);
     load_traces();
     ASSERT(directory.count(name)); // not has_chunk(), "" is valid
     plen_t len = 0;
@@ -674,7 +1033,13 @@ plen_t package::get_chunk_compressed_length(const string &name)
 }
 
 chunk_writer::chunk_writer(package *parent, const string &_name)
-    : first_block(0), cur_block(0), block_len(0)
+    : chunk_writer(parent, _name, false)
+{
+}
+
+chunk_writer::chunk_writer(package *parent, const string &_name, bool packed)
+    : first_block(0), cur_block(0), block_len(0), stored(packed),
+      deferred(nullptr)
 {
     ASSERT(parent);
     ASSERT(!parent->aborted);
@@ -688,6 +1053,12 @@ chunk_writer::chunk_writer(package *parent, const string &_name)
     pkg->n_users++;
     name = _name;
 
+    // The directory is needed right away, so it's never deferred.
+    if (pkg->compressor && !stored && !name.empty())
+        deferred = new vector<char>;
+    if (stored || deferred)
+        return;
+
 #ifdef USE_ZLIB
     zs.data_type = Z_BINARY;
     zs.zalloc    = 0;
@@ -710,28 +1081,42 @@ chunk_writer::~chunk_writer()
     if (pkg->aborted)
     {
 #ifdef USE_ZLIB
-        // ignore errors, they're not relevant anymore
-        deflateEnd(&zs);
-        free(z_buffer);
+        if (!stored && !deferred)
+        {
+            // ignore errors, they're not relevant anymore
+            deflateEnd(&zs);
+            free(z_buffer);
+        }
 #endif
+        delete deferred;
+        return;
+    }
+
+    if (deferred)
+    {
+        unique_ptr<vector<char>> raw(deferred);
+        pkg->queue_chunk(name, raw.get());
         return;
     }
 
 #ifdef USE_ZLIB
-    zs.avail_in = 0;
-    int res;
-    do
+    if (!stored)
     {
-        res = deflate(&zs, Z_FINISH);
-        if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
-            fail("save file compression failed: %s", zs.msg);
-        raw_write(z_buffer, zs.next_out - z_buffer);
-        zs.next_out = z_buffer;
-        zs.avail_out = ZB_SIZE;
-    } while (res != Z_STREAM_END);
-    if (deflateEnd(&zs) != Z_OK)
-        fail("save file compression failed during clean-up: %s", zs.msg);
-    free(z_buffer);
+        zs.avail_in = 0;
+        int res;
+        do
+        {
+            res = deflate(&zs, Z_FINISH);
+            if (res != Z_STREAM_END && res != Z_OK && res != Z_BUF_ERROR)
+                fail("save file compression failed: %s", zs.msg);
+            raw_write(z_buffer, zs.next_out - z_buffer);
+            zs.next_out = z_buffer;
+            zs.avail_out = ZB_SIZE;
+        } while (res != Z_STREAM_END);
+        if (deflateEnd(&zs) != Z_OK)
+            fail("save file compression failed during clean-up: %s", zs.msg);
+        free(z_buffer);
+    }
 #endif
     if (cur_block)
         finish_block(0);
@@ -782,6 +1167,18 @@ void chunk_writer::write(const void *data, plen_t len)
     ASSERT(data);
     ASSERT(!pkg->aborted);
 
+    if (deferred)
+    {
+        deferred->insert(deferred->end(), (const char*)data,
+                         (const char*)data + len);
+        return;
+    }
+    if (stored)
+    {
+        raw_write(data, len);
+        return;
+    }
+
 #ifdef USE_ZLIB
     zs.next_in  = (Bytef*)data;
     zs.avail_in = len;
@@ -955,3 +1352,5 @@ void chunk_reader::read_all(vector<char> &data)
     data.resize(at + s);
 #undef SPACE
 }
+
+#endif
@@ -3,6 +3,9 @@
 #define USE_ZLIB
 
 #include <map>
+#ifdef USE_SAVE_LOG
+#include <memory>
+#endif
 #include <set>
 #include <string>
 #include <vector>
@@ -27,14 +30,61 @@ typedef uint32_t plen_t;
 
 class package;
 
+#ifdef USE_SAVE_LOG
+// The append-only log backend, see package-log.cc.
+
+struct package_mapping;
+
 class chunk_writer
 {
 private:
+    package *pkg;
+    string name;
+    vector<char> buf;
+public:
+    chunk_writer(package *parent, const string &_name);
+    ~chunk_writer();
+    void write(const void *data, plen_t len);
+    friend class package;
+};
+
+class chunk_reader
+{
+private:
+    package *pkg;
+    // Keeps the mapped file alive for as long as we point into it.
+    std::shared_ptr<package_mapping> mapping;
+    vector<char> unpacked;
+    const char *data;
+    plen_t len, off;
+public:
+    chunk_reader(package *parent, const string &_name);
+    ~chunk_reader();
+    plen_t read(void *data, plen_t len);
+    void read_all(vector<char> &data);
+    // The whole chunk, to be read in place; valid while this reader lives.
+    const char *contents(plen_t &size) const;
+    friend class package;
+};
+#else
+#ifdef DO_FSYNC
+struct commit_flush;
+#endif
+struct chunk_compressor;
+
+class chunk_writer
+{
+private:
+    chunk_writer(package *parent, const string &_name, bool packed);
     package *pkg;
     string name;
     plen_t first_block;
     plen_t cur_block;
     plen_t block_len;
+    // Whether write() is given data that is already compressed.
+    bool stored;
+    // The raw data, when the package compresses chunks in the background.
+    vector<char> *deferred;
 #ifdef USE_ZLIB
     z_stream zs;
     Bytef *z_buffer;
@@ -69,6 +119,7 @@ public:
     void read_all(vector<char> &data);
     friend class package;
 };
+#endif
 
 class package
 {
@@ -84,6 +135,7 @@ public:
     vector<string> list_chunks();
     void abort();
     void unlink();
+    void compress_in_background(bool on);
     string get_filename() { return filename; }
 
     // statistics
@@ -102,12 +154,39 @@ private:
 #ifdef DO_FSYNC
     bool tmp;
 #endif
+#ifdef USE_SAVE_LOG
+    bool temporary;
+    // Chunk name to the offset and length of its record.
+    map<string, pair<plen_t, plen_t> > directory;
+    // Bytes taken by the current chunk records, and by the last commit.
+    plen_t live_len;
+    plen_t commit_len;
+    std::shared_ptr<package_mapping> mapping;
+    std::shared_ptr<package_mapping> map_file(plen_t end);
+    plen_t append_record(uint8_t type, const string &name, uint8_t codec,
+                         plen_t raw_len, const char *data, plen_t len);
+    void finish_chunk(const string &name, plen_t at, plen_t len);
+    void free_chunk(const string &name);
+    void write_header();
+    void load();
+    void compact();
+#else
     map<string, plen_t> directory;
     map<plen_t, plen_t> free_blocks;
     vector<plen_t> unlinked_blocks;
     map<plen_t, pair<plen_t, plen_t> > block_map;
     set<plen_t> new_chunks;
     map<plen_t, uint32_t> reader_count;
+#ifdef DO_FSYNC
+    // The commit whose header is still being written, if any.
+    commit_flush *flush;
+    void finish_flush();
+#endif
+    // Chunks waiting to be compressed and stored, if any.
+    chunk_compressor *compressor;
+    void queue_chunk(const string &name, vector<char> *raw);
+    void store_chunks(bool wait);
+    bool chunk_queued(const string &name);
     plen_t extend_block(plen_t at, plen_t size, plen_t by);
     plen_t alloc_block(plen_t &size);
     void finish_chunk(const string &name, plen_t at);
@@ -122,6 +201,7 @@ private:
     void trace_chunk(plen_t start);
     void load();
     void load_traces();
+#endif
     friend class chunk_writer;
     friend class chunk_reader;
 };
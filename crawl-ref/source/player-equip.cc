@@ -312,11 +312,40 @@ player_equip_set::player_equip_set()
     items.clear();
     unrand_active.init(false);
     artprop_cache.init(0);
+    weapon_ego_cache.init(0);
+    armour_ego_cache.init(0);
+    ego_cache_valid = false;
     do_unrand_reacts = 0;
     do_unrand_death_effects = 0;
 }
 
 int player_equip_set::wearing_ego(object_class_type obj_type, int ego) const
+{
+    if (!ego_cache_valid || ego < 0
+        || obj_type != OBJ_WEAPONS && obj_type != OBJ_ARMOUR)
+    {
+        return scan_ego(obj_type, ego);
+    }
+
+    int total = 0;
+    if (obj_type == OBJ_WEAPONS)
+        total = ego < NUM_SPECIAL_WEAPONS ? weapon_ego_cache[ego] : 0;
+    else
+        total = ego < NUM_SPECIAL_ARMOURS ? armour_ego_cache[ego] : 0;
+
+#ifdef DEBUG
+    // Catch anything which changes an equipped item's ego without calling
+    // update() afterward.
+    ASSERTM(total == scan_ego(obj_type, ego),
+            "stale ego cache for type %d ego %d", obj_type, ego);
+#endif
+
+    return total;
+}
+
+// Count equipped items of the given ego the slow way, by looking at all of
+// them.
+int player_equip_set::scan_ego(object_class_type obj_type, int ego) const
 {
     int total = 0;
     for (const player_equip_entry& entry : items)
@@ -539,6 +568,8 @@ void player_equip_set::update()
 {
     unrand_active.reset();
     artprop_cache.init(0);
+    weapon_ego_cache.init(0);
+    armour_ego_cache.init(0);
 
     artefact_properties_t artprops;
     for (const player_equip_entry& entry : items)
@@ -550,6 +581,22 @@ void player_equip_set::update()
 
         const item_def& item = entry.get_item();
 
+        if (!entry.melded && entry.slot != SLOT_UNUSED)
+        {
+            if (item.base_type == OBJ_WEAPONS)
+            {
+                const int ego = get_weapon_brand(item);
+                if (ego >= 0 && ego < NUM_SPECIAL_WEAPONS)
+                    ++weapon_ego_cache[ego];
+            }
+            else if (item.base_type == OBJ_ARMOUR)
+            {
+                const int ego = get_armour_ego_type(item);
+                if (ego >= 0 && ego < NUM_SPECIAL_ARMOURS)
+                    ++armour_ego_cache[ego];
+            }
+        }
+
         if (is_artefact(item))
         {
             if (is_unrandom_artefact(item))
@@ -580,6 +627,8 @@ void player_equip_set::update()
 
     for (int i = SLOT_UNUSED; i < NUM_EQUIP_SLOTS; ++i)
         num_slots[i] = get_player_equip_slot_count(static_cast<equipment_slot>(i));
+
+    ego_cache_valid = true;
 }
 
 /**
@@ -913,6 +962,7 @@ void player_equip_set::add(item_def& item, equipment_slot slot)
 {
     ASSERT(slot != SLOT_UNUSED);
 
+    ego_cache_valid = false;
     items.emplace_back(item, slot);
 
     // Any slots past the first must be overflow slots, so place an overflow
@@ -953,6 +1003,7 @@ void player_equip_set::add(item_def& item, equipment_slot slot)
 
 void player_equip_set::remove(const item_def& item)
 {
+    ego_cache_valid = false;
     for (int i = (int)items.size() - 1; i >= 0; --i)
     {
         if (items[i].item == item.link)
@@ -1042,6 +1093,7 @@ bool player_equip_set::is_melded(const item_def& item)
  */
 void player_equip_set::meld_equipment(int slots, bool skip_effects)
 {
+    ego_cache_valid = false;
     vector<item_def*> was_melded;
     for (player_equip_entry& entry : items)
     {
@@ -1072,6 +1124,7 @@ void player_equip_set::meld_equipment(int slots, bool skip_effects)
 
 void player_equip_set::meld_equipment(vector<item_def*> to_meld, bool skip_effects)
 {
+    ego_cache_valid = false;
     for (player_equip_entry& entry : items)
     {
         for (item_def* meld_item : to_meld)
@@ -1159,6 +1212,7 @@ void player_equip_set::handle_melding(vector<item_def*>& to_meld, bool skip_effe
  */
 void player_equip_set::unmeld_slot(equipment_slot slot, bool skip_effects)
 {
+    ego_cache_valid = false;
     vector<item_def*> was_unmelded;
     for (player_equip_entry& entry : items)
     {
@@ -1218,6 +1272,7 @@ void player_equip_set::unmeld_slot(equipment_slot slot, bool skip_effects)
  */
 void player_equip_set::unmeld_all_equipment(bool skip_effects)
 {
+    ego_cache_valid = false;
     vector<item_def*> was_unmelded;
     for (player_equip_entry& entry : items)
     {
@@ -56,6 +56,14 @@ struct player_equip_set
     FixedBitVector<NUM_UNRANDARTS> unrand_equipped;
     FixedBitVector<NUM_UNRANDARTS> unrand_active;
 
+    // Number of active (unmelded, non-overflow) weapons and armour of each
+    // ego, so that wearing_ego() need not walk every item. Only trusted while
+    // ego_cache_valid is set; anything which changes the item list or melds
+    // things clears it until the next update().
+    FixedVector<int, NUM_SPECIAL_WEAPONS> weapon_ego_cache;
+    FixedVector<int, NUM_SPECIAL_ARMOURS> armour_ego_cache;
+    bool ego_cache_valid;
+
     // Number of unrands that we should run the _*_world_reacts function for.
     int do_unrand_reacts;
 
@@ -70,6 +78,7 @@ struct player_equip_set
 
     // Querying methods
     int wearing_ego(object_class_type obj_type, int ego) const;
+    int scan_ego(object_class_type obj_type, int ego) const;
     int wearing(object_class_type obj_type, int sub_type,
                 bool count_plus, bool check_attunement) const;
     int get_artprop(artefact_prop_type prop) const;
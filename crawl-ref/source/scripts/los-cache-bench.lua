@@ -0,0 +1,14 @@
+-- Compares lookup throughput and size of the global LOS cache layouts.
+
+local args = script.simple_args()
+local rounds = tonumber(args[1] or 100)
+if not rounds or rounds < 1 then
+  script.usage("Usage: los-cache-bench [<rounds>]")
+end
+
+local bytes_ns, packed_ns, bytes_size, packed_size =
+  debug.los_cache_benchmark(rounds)
+crawl.stderr(string.format("byte layout:   %6.2f ns/lookup, %4d KB",
+                           bytes_ns, bytes_size / 1024))
+crawl.stderr(string.format("packed layout: %6.2f ns/lookup, %4d KB",
+                           packed_ns, packed_size / 1024))
@@ -175,6 +175,12 @@ static void _initialize()
         objstat_generate_stats();
         end(0, false);
     }
+    else if (crawl_state.builder_bench)
+    {
+        release_cli_signals();
+        builder_bench_generate_stats();
+        end(0, false);
+    }
 #endif
 
     if (!crawl_state.test_list)
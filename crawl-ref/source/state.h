@@ -71,6 +71,7 @@ struct game_state
     bool map_stat_dump_disconnect; // Set if we dump disconnected maps and exit
                                    // under mapstat.
     bool obj_stat_gen;      // Set if we're generating object stats.
+    bool builder_bench;     // Set if we're timing the level builder.
 
     string force_map;       // Set if we're forcing a specific map to generate.
 
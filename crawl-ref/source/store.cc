@@ -1203,6 +1203,106 @@ string &CrawlStoreValue::operator += (const string &_val)
     return get_string() += _val;
 }
 
+/////////////////////////////
+// Construction and destruction
+
+CrawlHashTable::CrawlHashTable()
+{
+}
+
+CrawlHashTable::CrawlHashTable(const CrawlHashTable &other)
+{
+    *this = other;
+}
+
+CrawlHashTable::CrawlHashTable(CrawlHashTable &&other)
+{
+    nodes.take(other.nodes);
+    index.swap(other.index);
+}
+
+CrawlHashTable::~CrawlHashTable()
+{
+    clear();
+}
+
+CrawlHashTable &CrawlHashTable::operator = (const CrawlHashTable &other)
+{
+    if (this == &other)
+        return *this;
+
+    clear();
+    nodes.reserve(other.nodes.size());
+    for (const node *n : other.nodes)
+        nodes.push_back(new node(n->entry.first, n->hash, n->entry.second));
+    // Entries keep their positions, so the index carries over as it is.
+    index = other.index;
+
+    return *this;
+}
+
+CrawlHashTable &CrawlHashTable::operator = (CrawlHashTable &&other)
+{
+    if (this != &other)
+    {
+        clear();
+        nodes.take(other.nodes);
+        index.swap(other.index);
+    }
+    return *this;
+}
+
+void CrawlHashTable::clear()
+{
+    for (node *n : nodes)
+        delete n;
+    nodes.clear();
+    index.clear();
+}
+
+void CrawlHashTable::node_list::reserve(size_t n)
+{
+    if (n <= cap)
+        return;
+
+    node **grown = new node*[n];
+    copy(ptrs, ptrs + len, grown);
+    if (ptrs != small)
+        delete[] ptrs;
+    ptrs = grown;
+    cap = n;
+}
+
+void CrawlHashTable::node_list::clear()
+{
+    if (ptrs != small)
+        delete[] ptrs;
+    ptrs = small;
+    len = 0;
+    cap = HASH_LINEAR_MAX;
+}
+
+void CrawlHashTable::node_list::take(node_list &other)
+{
+    ASSERT(empty());
+    clear();
+
+    if (other.ptrs == other.small)
+    {
+        copy(other.small, other.small + other.len, small);
+        len = other.len;
+    }
+    else
+    {
+        ptrs = other.ptrs;
+        len = other.len;
+        cap = other.cap;
+        other.ptrs = other.small;
+        other.cap = HASH_LINEAR_MAX;
+    }
+    other.len = 0;
+}
+
 //////////////////////////////
 // Read/write from/to savefile
 void CrawlHashTable::write(writer &th) const
@@ -1262,11 +1362,153 @@ static map<string, int> accesses;
 //////////////////
 // Misc functions
 
-bool CrawlHashTable::exists(const string &key) const
+// FNV-1a; keys are short, and this only has to beat comparing strings.
+static uint32_t _key_hash(const char *key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ static_cast<uint8_t>(key[i])) * 16777619u;
+    return hash;
+}
+
+int CrawlHashTable::_find(const char *key, size_t len) const
 {
-    ACCESS(key);
+    ACCESS(string(key, len));
     ASSERT_VALIDITY();
-    return find(key) != end();
+    return _find(key, len, _key_hash(key, len));
+}
+
+int CrawlHashTable::_find(const char *key, size_t len, uint32_t hash) const
+{
+    auto matches = [&](const node *n)
+    {
+        return n->hash == hash && n->entry.first.size() == len
+               && !memcmp(n->entry.first.data(), key, len);
+    };
+
+    if (index.empty())
+    {
+        for (int i = 0, size = nodes.size(); i < size; ++i)
+            if (matches(nodes[i]))
+                return i;
+        return -1;
+    }
+
+    for (size_t b = _bucket(hash); index[b] >= 0;
+         b = (b + 1) & (index.size() - 1))
+    {
+        if (matches(nodes[index[b]]))
+            return index[b];
+    }
+    return -1;
+}
+
+size_t CrawlHashTable::_erase(const char *key, size_t len)
+{
+    const int pos = _find(key, len);
+    if (pos < 0)
+        return 0;
+
+    _erase_at(pos);
+    return 1;
+}
+
+CrawlHashTable::iterator CrawlHashTable::erase(const_iterator it)
+{
+    const int pos = it.pos - nodes.data();
+    ASSERT_RANGE(pos, 0, (int)nodes.size());
+
+    _erase_at(pos);
+    return iterator(nodes.data() + pos);
+}
+
+// Remove the entry at pos, moving the last entry into its place.
+void CrawlHashTable::_erase_at(int pos)
+{
+    const int last = nodes.size() - 1;
+
+    if (!index.empty())
+    {
+        _index_remove(pos);
+        if (pos != last)
+            _index_move(last, pos);
+    }
+
+    delete nodes[pos];
+    nodes[pos] = nodes[last];
+    nodes.pop_back();
+
+    if (nodes.size() <= HASH_LINEAR_MAX)
+        index.clear();
+}
+
+void CrawlHashTable::_rebuild_index()
+{
+    // Keep the load factor at most 1/4 after a rebuild; _index_insert()
+    // rebuilds again once it would pass 1/2.
+    size_t buckets = 16;
+    while (buckets < nodes.size() * 4)
+        buckets *= 2;
+
+    index.assign(buckets, -1);
+    for (int pos = 0, size = nodes.size(); pos < size; ++pos)
+    {
+        size_t b = _bucket(nodes[pos]->hash);
+        while (index[b] >= 0)
+            b = (b + 1) & (buckets - 1);
+        index[b] = pos;
+    }
+}
+
+// Index the (new) entry at pos, if the table is large enough to need it.
+void CrawlHashTable::_index_insert(int pos)
+{
+    if (index.empty() && nodes.size() <= HASH_LINEAR_MAX)
+        return;
+
+    if (index.size() < nodes.size() * 2)
+    {
+        _rebuild_index();
+        return;
+    }
+
+    size_t b = _bucket(nodes[pos]->hash);
+    while (index[b] >= 0)
+        b = (b + 1) & (index.size() - 1);
+    index[b] = pos;
+}
+
+// Drop the entry at pos from the index, shifting back later members of its
+// probe run so that no lookup stops short at the gap.
+void CrawlHashTable::_index_remove(int pos)
+{
+    const size_t mask = index.size() - 1;
+
+    size_t hole = _bucket(nodes[pos]->hash);
+    while (index[hole] != pos)
+        hole = (hole + 1) & mask;
+
+    for (size_t b = (hole + 1) & mask; index[b] >= 0; b = (b + 1) & mask)
+    {
+        // An entry may fill the hole only if the hole lies between its
+        // home bucket and where it is now.
+        const size_t home = _bucket(nodes[index[b]]->hash);
+        if (((b - home) & mask) >= ((b - hole) & mask))
+        {
+            index[hole] = index[b];
+            hole = b;
+        }
+    }
+    index[hole] = -1;
+}
+
+// Point the index entry for the node at from to position to instead.
+void CrawlHashTable::_index_move(int from, int to)
+{
+    size_t b = _bucket(nodes[from]->hash);
+    while (index[b] != from)
+        b = (b + 1) & (index.size() - 1);
+    index[b] = to;
 }
 
 void CrawlHashTable::assert_validity() const
@@ -1327,28 +1569,46 @@ void CrawlHashTable::assert_validity() const
     }
 
     ASSERT(size() == actual_size);
+
+    ASSERT(index.empty() || nodes.size() > HASH_LINEAR_MAX);
+    for (int pos = 0, size = nodes.size(); pos < size; ++pos)
+    {
+        const string &key = nodes[pos]->entry.first;
+        ASSERT(nodes[pos]->hash == _key_hash(key.data(), key.size()));
+        ASSERT(_find(key.data(), key.size(), nodes[pos]->hash) == pos);
+    }
 #endif
 }
 
 ////////////////////////////////
 // Accessors to contained values
 
-CrawlStoreValue& CrawlHashTable::get_value(const string &key)
+CrawlStoreValue& CrawlHashTable::_get_value(const char *key, size_t len)
 {
     ASSERT_VALIDITY();
-    ACCESS(key);
-    // Inserts CrawlStoreValue() if the key was not found.
-    return map::operator[](key);
+    ACCESS(string(key, len));
+
+    const uint32_t hash = _key_hash(key, len);
+    int pos = _find(key, len, hash);
+    if (pos < 0)
+    {
+        // Inserts CrawlStoreValue() if the key was not found.
+        nodes.push_back(new node(string(key, len), hash));
+        pos = nodes.size() - 1;
+        _index_insert(pos);
+    }
+
+    return nodes[pos]->entry.second;
 }
 
-const CrawlStoreValue& CrawlHashTable::get_value(const string &key) const
+const CrawlStoreValue& CrawlHashTable::_get_value(const char *key,
+                                                  size_t len) const
 {
-    ASSERT_VALIDITY();
-    ACCESS(key);
-    auto iter = find(key);
-    ASSERTM(iter != end(), "trying to read non-existent property \"%s\"", key.c_str());
+    const int pos = _find(key, len);
+    ASSERTM(pos >= 0, "trying to read non-existent property \"%s\"",
+            string(key, len).c_str());
 
-    const CrawlStoreValue& store = iter->second;
+    const CrawlStoreValue& store = nodes[pos]->entry.second;
     ASSERT(store.type != SV_NONE);
     ASSERT(!(store.flags & SFLAG_UNSET));
 
@@ -7,8 +7,12 @@
 #pragma once
 
 #include <climits>
+#include <cstring>
+#include <iterator>
 #include <map>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 class  reader;
@@ -29,6 +33,9 @@ typedef uint8_t store_flags;
 
 #define VEC_MAX_SIZE  0xFFFF
 
+// CrawlHashTables with more entries than this get a hashed index.
+#define HASH_LINEAR_MAX 8
+
 // NOTE: Changing the ordering of these enums will break savefile
 // compatibility.
 enum store_val_type
@@ -241,27 +248,145 @@ protected:
     friend class CrawlVector;
 };
 
-class CrawlHashTable : public map<string, CrawlStoreValue>
+// A string-keyed table of CrawlStoreValues.
+//
+// Most tables (the props of items and monsters) only ever hold a handful of
+// keys, so entries are kept in a flat array and found by comparing a hash
+// of the key before the key itself; tables which grow past
+// HASH_LINEAR_MAX entries (you.props, env.properties) also get an
+// open-addressing index into that array. Each entry is allocated on its
+// own, so references into the table stay valid as it grows, as they did
+// when this was a std::map. Iteration order is insertion order, except
+// that erasing an entry moves the last one into its place.
+class CrawlHashTable
 {
 public:
     friend class CrawlStoreValue;
 
+    typedef pair<const string, CrawlStoreValue> value_type;
+
+private:
+    struct node
+    {
+        node(const string &key, uint32_t _hash)
+            : entry(piecewise_construct, forward_as_tuple(key),
+                    forward_as_tuple()),
+              hash(_hash)
+        {
+        }
+
+        node(const string &key, uint32_t _hash, const CrawlStoreValue &val)
+            : entry(piecewise_construct, forward_as_tuple(key),
+                    forward_as_tuple(val)),
+              hash(_hash)
+        {
+        }
+
+        value_type entry;
+        uint32_t   hash;
+    };
+
+    template<typename Value, typename NodePtr>
+    class iterator_base
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Value                     value_type;
+        typedef ptrdiff_t                 difference_type;
+        typedef Value*                    pointer;
+        typedef Value&                    reference;
+
+        iterator_base() : pos(nullptr) { }
+        explicit iterator_base(NodePtr *_pos) : pos(_pos) { }
+
+        // Allow iterator -> const_iterator.
+        template<typename V, typename N>
+        iterator_base(const iterator_base<V, N> &other) : pos(other.pos) { }
+
+        reference operator*() const { return (*pos)->entry; }
+        pointer operator->() const { return &(*pos)->entry; }
+
+        iterator_base &operator++() { ++pos; return *this; }
+        iterator_base operator++(int)
+        {
+            iterator_base old = *this;
+            ++pos;
+            return old;
+        }
+
+        template<typename V, typename N>
+        bool operator==(const iterator_base<V, N> &other) const
+        {
+            return pos == other.pos;
+        }
+        template<typename V, typename N>
+        bool operator!=(const iterator_base<V, N> &other) const
+        {
+            return pos != other.pos;
+        }
+
+    private:
+        NodePtr *pos;
+
+        template<typename V, typename N> friend class iterator_base;
+        friend class CrawlHashTable;
+    };
+
+public:
+    typedef iterator_base<value_type, node* const>       iterator;
+    typedef iterator_base<const value_type, node* const> const_iterator;
+
+    CrawlHashTable();
+    CrawlHashTable(const CrawlHashTable &other);
+    CrawlHashTable(CrawlHashTable &&other);
+    ~CrawlHashTable();
+
+    CrawlHashTable &operator = (const CrawlHashTable &other);
+    CrawlHashTable &operator = (CrawlHashTable &&other);
+
     void write(writer &) const;
     void read(reader &);
 
-    bool exists(const string &key) const;
+    bool exists(const string &key) const
+    { return _find(key.data(), key.size()) >= 0; }
+    bool exists(const char *key) const
+    { return _find(key, strlen(key)) >= 0; }
 
     void assert_validity() const;
 
+    size_t size() const  { return nodes.size(); }
+    bool   empty() const { return nodes.empty(); }
+    void   clear();
+
+    iterator begin() { return iterator(nodes.data()); }
+    iterator end()   { return iterator(nodes.data() + nodes.size()); }
+    const_iterator begin() const { return const_iterator(nodes.data()); }
+    const_iterator end() const
+    { return const_iterator(nodes.data() + nodes.size()); }
+
+    iterator find(const string &key)
+    { return _iter(_find(key.data(), key.size())); }
+    const_iterator find(const string &key) const
+    { return _iter(_find(key.data(), key.size())); }
+
+    size_t count(const string &key) const { return exists(key); }
+
+    // Returns the number of entries erased (zero or one).
+    size_t erase(const string &key) { return _erase(key.data(), key.size()); }
+    size_t erase(const char *key)   { return _erase(key, strlen(key)); }
+    // Returns an iterator to the entry which took the erased one's place.
+    iterator erase(const_iterator it);
+
     // NOTE: If the const versions of get_value() or [] are given a
     // key which doesn't exist, they will assert.
-    const CrawlStoreValue& get_value(const string &key) const;
+    const CrawlStoreValue& get_value(const string &key) const
+    { return _get_value(key.data(), key.size()); }
     const CrawlStoreValue& get_value(const char *key) const
-    { return get_value(string(key)); }
+    { return _get_value(key, strlen(key)); }
     const CrawlStoreValue& operator[] (const string &key) const
     { return get_value(key); }
     const CrawlStoreValue& operator[] (const char *key) const
-    { return get_value(string(key)); }
+    { return get_value(key); }
 
     // NOTE: If get_value() or [] is given a key which doesn't exist
     // in the table, an unset/empty CrawlStoreValue will be created
@@ -270,12 +395,81 @@ public:
     // hash table has a type (rather than being heterogeneous)
     // then trying to assign a different type to the CrawlStoreValue
     // will assert.
-    CrawlStoreValue& get_value(const string &key);
+    CrawlStoreValue& get_value(const string &key)
+    { return _get_value(key.data(), key.size()); }
     CrawlStoreValue& get_value(const char *key)
-    { return get_value(string(key)); }
-    using map::operator[];
+    { return _get_value(key, strlen(key)); }
+    CrawlStoreValue& operator[] (const string &key)
+    { return get_value(key); }
     CrawlStoreValue& operator[] (const char *key)
-    { return get_value(string(key)); }
+    { return get_value(key); }
+
+private:
+    // The entries in iteration order. Up to HASH_LINEAR_MAX pointers are
+    // kept inline, so a small table allocates nothing but its entries;
+    // those stay separate so that references to them survive the table
+    // growing.
+    class node_list
+    {
+    public:
+        node_list() : ptrs(small), len(0), cap(HASH_LINEAR_MAX) { }
+        ~node_list() { clear(); }
+        node_list(const node_list &other) = delete;
+        node_list &operator = (const node_list &other) = delete;
+
+        node **data() { return ptrs; }
+        node * const *data() const { return ptrs; }
+        size_t size() const { return len; }
+        bool empty() const { return !len; }
+        node *&operator[] (size_t i) { return ptrs[i]; }
+        node *operator[] (size_t i) const { return ptrs[i]; }
+        node * const *begin() const { return ptrs; }
+        node * const *end() const { return ptrs + len; }
+
+        void push_back(node *n)
+        {
+            if (len == cap)
+                reserve(cap * 2);
+            ptrs[len++] = n;
+        }
+        void pop_back() { --len; }
+
+        void reserve(size_t n);
+        // Forget the pointers, going back to the inline array; the
+        // entries themselves are the table's to delete.
+        void clear();
+        // Take over other's pointers, leaving it empty; this must be empty.
+        void take(node_list &other);
+
+    private:
+        node   **ptrs;
+        uint32_t len;
+        uint32_t cap;
+        node    *small[HASH_LINEAR_MAX];
+    };
+
+    node_list nodes;
+    // Open-addressing index of positions in nodes, or -1 for an empty
+    // bucket; only used when there are more than HASH_LINEAR_MAX entries.
+    vector<int>   index;
+
+    iterator _iter(int pos)
+    { return pos < 0 ? end() : iterator(nodes.data() + pos); }
+    const_iterator _iter(int pos) const
+    { return pos < 0 ? end() : const_iterator(nodes.data() + pos); }
+
+    int _find(const char *key, size_t len) const;
+    int _find(const char *key, size_t len, uint32_t hash) const;
+    size_t _erase(const char *key, size_t len);
+    void _erase_at(int pos);
+    CrawlStoreValue& _get_value(const char *key, size_t len);
+    const CrawlStoreValue& _get_value(const char *key, size_t len) const;
+
+    size_t _bucket(uint32_t hash) const { return hash & (index.size() - 1); }
+    void _rebuild_index();
+    void _index_insert(int pos);
+    void _index_remove(int pos);
+    void _index_move(int from, int to);
 };
 
 // A CrawlVector is the vector version of CrawlHashTable, except that
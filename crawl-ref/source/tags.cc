@@ -117,19 +117,26 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 extern abyss_state abyssal_state;
 
 reader::reader(const string &_read_filename, int minorVersion)
-    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
-      _minorVersion(minorVersion), _safe_read(false)
+    : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _mapped(nullptr),
+      _mapped_size(0), _read_offset(0), _minorVersion(minorVersion),
+      _safe_read(false)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
     opened_file = !!_file;
 }
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
-    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+    : _file(0), _chunk(0), opened_file(false), _pbuf(0), _mapped(0),
+      _mapped_size(0), _read_offset(0), _minorVersion(minorVersion),
+      _safe_read(false)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
+#ifdef USE_SAVE_LOG
+    plen_t size;
+    _mapped = _chunk->contents(size);
+    _mapped_size = size;
+#endif
 }
 
 reader::~reader()
@@ -148,6 +155,12 @@ void reader::close()
 
 void reader::advance(size_t offset)
 {
+    if (_mapped)
+    {
+        read(nullptr, offset);
+        return;
+    }
+
     char junk[128];
 
     while (offset)
@@ -161,7 +174,8 @@ void reader::advance(size_t offset)
 bool reader::valid() const
 {
     return (_file && !feof(_file)) ||
-           (_pbuf && _read_offset < _pbuf->size());
+           (_pbuf && _read_offset < _pbuf->size()) ||
+           (_mapped && _read_offset < _mapped_size);
 }
 
 static NORETURN void _short_read(bool safe_read)
@@ -183,6 +197,12 @@ unsigned char reader::readByte()
             _short_read(_safe_read);
         return b;
     }
+    else if (_mapped)
+    {
+        if (_read_offset >= _mapped_size)
+            _short_read(_safe_read);
+        return _mapped[_read_offset++];
+    }
     else if (_chunk)
     {
         unsigned char buf;
@@ -210,6 +230,15 @@ void reader::read(void *data, size_t size)
         else
             fseek(_file, (long)size, SEEK_CUR);
     }
+    else if (_mapped)
+    {
+        if (_read_offset + size > _mapped_size)
+            _short_read(_safe_read);
+        if (data && size)
+            memcpy(data, _mapped + _read_offset, size);
+
+        _read_offset += size;
+    }
     else if (_chunk)
     {
         if (_chunk->read(data, size) != size)
@@ -240,9 +269,10 @@ void reader::setMinorVersion(int minorVersion)
 void reader::fail_if_not_eof(const string &name)
 {
     char dummy;
-    if (_chunk ? _chunk->read(&dummy, 1) :
+    if (_mapped ? _read_offset < _mapped_size :
+        _chunk ? _chunk->read(&dummy, 1) :
         _file ? (fgetc(_file) != EOF) :
-        _read_offset >= _pbuf->size())
+        _pbuf && _read_offset < _pbuf->size())
     {
         fail("Incomplete read of \"%s\" - aborting.", name.c_str());
     }
@@ -5025,6 +5055,71 @@ static int _last_used_index(const Z &thinglist, int max_things)
 
 // ------------------------------- level tags ---------------------------- //
 
+// Clouds go out in coord_def order, as they did from a map.
+void marshall_clouds(writer &th, cloud_store &clouds)
+{
+    // how many clouds?
+    marshallShort(th, clouds.size());
+    for (coord_def pos : clouds.positions())
+    {
+        const cloud_struct& cloud = *clouds.find(pos);
+        marshallByte(th, cloud.type);
+        ASSERT(cloud.type != CLOUD_NONE);
+        ASSERT_IN_BOUNDS(cloud.pos);
+        marshallByte(th, cloud.pos.x);
+        marshallByte(th, cloud.pos.y);
+        marshallShort(th, cloud.decay);
+        marshallByte(th, cloud.spread_rate);
+        marshallByte(th, cloud.whose);
+        marshallByte(th, cloud.killer);
+        marshallInt(th, cloud.source);
+        marshallInt(th, cloud.excl_rad);
+    }
+}
+
+void unmarshall_clouds(reader &th, cloud_store &clouds)
+{
+    clouds.clear();
+    // how many clouds?
+    const int num_clouds = unmarshallShort(th);
+    cloud_struct cloud;
+    for (int i = 0; i < num_clouds; i++)
+    {
+        cloud.type  = static_cast<cloud_type>(unmarshallByte(th));
+#if TAG_MAJOR_VERSION == 34
+        // old system marshalled empty clouds this way
+        if (cloud.type == CLOUD_NONE)
+            continue;
+#else
+        ASSERT(cloud.type != CLOUD_NONE);
+#endif
+        cloud.pos.x = unmarshallByte(th);
+        cloud.pos.y = unmarshallByte(th);
+        ASSERT_IN_BOUNDS(cloud.pos);
+        cloud.decay = unmarshallShort(th);
+        cloud.spread_rate = unmarshallUByte(th);
+        cloud.whose = static_cast<kill_category>(unmarshallUByte(th));
+        cloud.killer = static_cast<killer_type>(unmarshallUByte(th));
+        cloud.source = unmarshallInt(th);
+#if TAG_MAJOR_VERSION == 34
+        if (th.getMinorVersion() < TAG_MINOR_DECUSTOM_CLOUDS)
+        {
+            unmarshallShort(th); // was cloud.colour
+            unmarshallString(th); // was cloud.name
+            unmarshallString(th); // was cloud.tile
+        }
+#endif
+        cloud.excl_rad = unmarshallInt(th);
+
+#if TAG_MAJOR_VERSION == 34
+        // Remove clouds stuck in walls, from 0.18-a0-603-g332275c to
+        // 0.18-a0-629-g16988c9.
+        if (!cell_is_solid(cloud.pos))
+#endif
+            clouds.set(cloud);
+    }
+}
+
 static void _tag_construct_level(writer &th)
 {
     marshallByte(th, env.floor_colour);
@@ -5061,23 +5156,7 @@ static void _tag_construct_level(writer &th)
 
     CANARY;
 
-    // how many clouds?
-    marshallShort(th, env.cloud.size());
-    for (const auto& entry : env.cloud)
-    {
-        const cloud_struct& cloud = entry.second;
-        marshallByte(th, cloud.type);
-        ASSERT(cloud.type != CLOUD_NONE);
-        ASSERT_IN_BOUNDS(cloud.pos);
-        marshallByte(th, cloud.pos.x);
-        marshallByte(th, cloud.pos.y);
-        marshallShort(th, cloud.decay);
-        marshallByte(th, cloud.spread_rate);
-        marshallByte(th, cloud.whose);
-        marshallByte(th, cloud.killer);
-        marshallInt(th, cloud.source);
-        marshallInt(th, cloud.excl_rad);
-    }
+    marshall_clouds(th, env.cloud);
 
     CANARY;
 
@@ -5157,7 +5236,14 @@ void marshallItem(writer &th, const item_def &item, bool iinfo)
     marshallShort(th, item.orig_monnum);
     marshallString(th, item.inscription);
 
-    item.props.write(th);
+    if (item.has_artprops)
+    {
+        CrawlHashTable props = item.props;
+        artefact_save_props(item, props);
+        props.write(th);
+    }
+    else
+        item.props.write(th);
 }
 
 #if TAG_MAJOR_VERSION == 34
@@ -5270,6 +5356,7 @@ void unmarshallItem(reader &th, item_def &item)
     item.inscription = unmarshallString(th);
 
     item.props.clear();
+    item.has_artprops = false;
     item.props.read(th);
 #if TAG_MAJOR_VERSION == 34
     if (th.getMinorVersion() < TAG_MINOR_CORPSE_COLOUR
@@ -5518,7 +5605,7 @@ void unmarshallItem(reader &th, item_def &item)
     {
         int acc, dam, slay = 0;
 
-        if (item.props.exists(ARTEFACT_PROPS_KEY))
+        if (item.has_artprops)
         {
             acc = artefact_property(item, ARTP_ACCURACY);
             dam = artefact_property(item, ARTP_SLAYING);
@@ -6639,45 +6726,7 @@ static void _tag_read_level(reader &th)
 
     EAT_CANARY;
 
-    env.cloud.clear();
-    // how many clouds?
-    const int num_clouds = unmarshallShort(th);
-    cloud_struct cloud;
-    for (int i = 0; i < num_clouds; i++)
-    {
-        cloud.type  = static_cast<cloud_type>(unmarshallByte(th));
-#if TAG_MAJOR_VERSION == 34
-        // old system marshalled empty clouds this way
-        if (cloud.type == CLOUD_NONE)
-            continue;
-#else
-        ASSERT(cloud.type != CLOUD_NONE);
-#endif
-        cloud.pos.x = unmarshallByte(th);
-        cloud.pos.y = unmarshallByte(th);
-        ASSERT_IN_BOUNDS(cloud.pos);
-        cloud.decay = unmarshallShort(th);
-        cloud.spread_rate = unmarshallUByte(th);
-        cloud.whose = static_cast<kill_category>(unmarshallUByte(th));
-        cloud.killer = static_cast<killer_type>(unmarshallUByte(th));
-        cloud.source = unmarshallInt(th);
-#if TAG_MAJOR_VERSION == 34
-        if (th.getMinorVersion() < TAG_MINOR_DECUSTOM_CLOUDS)
-        {
-            unmarshallShort(th); // was cloud.colour
-            unmarshallString(th); // was cloud.name
-            unmarshallString(th); // was cloud.tile
-        }
-#endif
-        cloud.excl_rad = unmarshallInt(th);
-
-#if TAG_MAJOR_VERSION == 34
-        // Remove clouds stuck in walls, from 0.18-a0-603-g332275c to
-        // 0.18-a0-629-g16988c9.
-        if (!cell_is_solid(cloud.pos))
-#endif
-            env.cloud[cloud.pos] = cloud;
-    }
+    unmarshall_clouds(th, env.cloud);
 
     EAT_CANARY;
 
@@ -7483,11 +7532,13 @@ static void _tag_read_level_monsters(reader &th)
     count = unmarshallShort(th);
     ASSERT_RANGE(count, 0, MAX_MONSTERS + 1);
 
-    env.max_mon_index = max(0, count - 1);
+    env.active_mons.clear();
     for (int i = 0; i < count; i++)
     {
         monster& m = env.mons[i];
         unmarshallMonster(th, m);
+        if (m.defined())
+            env.active_mons.push_back(i);
 
         // place monster
         if (!m.alive())
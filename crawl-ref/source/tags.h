@@ -25,6 +25,7 @@ struct player_save_info;
 struct show_type;
 struct monster_info;
 struct map_cell;
+class cloud_store;
 class ghost_demon;
 struct item_def;
 class monster;
@@ -116,13 +117,21 @@ public:
     reader(const string &filename, int minorVersion = TAG_MINOR_INVALID);
     reader(FILE* input, int minorVersion = TAG_MINOR_INVALID)
         : _file(input), _chunk(0), opened_file(false), _pbuf(0),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+          _mapped(0), _mapped_size(0), _read_offset(0),
+          _minorVersion(minorVersion), _safe_read(false) {}
     reader(const vector<unsigned char>& input,
            int minorVersion = TAG_MINOR_INVALID)
         : _file(0), _chunk(0), opened_file(false), _pbuf(&input),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+          _mapped(0), _mapped_size(0), _read_offset(0),
+          _minorVersion(minorVersion), _safe_read(false) {}
     reader(package *save, const string &chunkname,
            int minorVersion = TAG_MINOR_INVALID);
+    // Reads data in place, which must outlive the reader.
+    reader(const char *data, size_t size,
+           int minorVersion = TAG_MINOR_INVALID)
+        : _file(0), _chunk(0), opened_file(false), _pbuf(0),
+          _mapped(data), _mapped_size(size), _read_offset(0),
+          _minorVersion(minorVersion), _safe_read(false) {}
     ~reader();
 
     unsigned char readByte();
@@ -144,6 +153,10 @@ private:
     chunk_reader *_chunk;
     bool  opened_file;
     const vector<unsigned char>* _pbuf;
+    // Data that can be read in place: a chunk (with USE_SAVE_LOG), or a
+    // memory buffer such as the map bundle.
+    const char* _mapped;
+    size_t _mapped_size;
     unsigned int _read_offset;
     int _minorVersion;
     // always throw an exception rather than dying when reading past EOF
@@ -198,6 +211,9 @@ FixedVector<int, 52> unmarshall_player_spell_letter_table(reader &th);
 
 void remove_removed_library_spells(FixedBitVector<NUM_SPELLS>& lib);
 
+void marshall_clouds(writer &th, cloud_store &clouds);
+void unmarshall_clouds(reader &th, cloud_store &clouds);
+
 /* ***********************************************************************
  * Tag interface
  * *********************************************************************** */
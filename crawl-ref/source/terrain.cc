@@ -38,6 +38,7 @@
 #include "message.h"
 #include "mon-behv.h"
 #include "mon-gear.h"
+#include "mon-pathfind.h"
 #include "mon-place.h"
 #include "mon-poly.h"
 #include "mon-util.h"
@@ -1987,6 +1988,8 @@ void set_terrain_changed(const coord_def p)
     dungeon_events.fire_position_event(DET_FEAT_CHANGE, p);
 
     los_terrain_changed(p);
+    invalidate_player_flows();
+    invalidate_travel_distances();
 }
 
 /**
@@ -52,6 +52,12 @@ local function run_los_tests(depth, nlevels, tests_per_level)
   end
 end
 
-for depth = 1, 5 do
-  run_los_tests(depth, 1, 1)
+-- Both losight() engines must pass.
+local engine = debug.los_engine()
+for _, e in ipairs({ "raycast", "bitboard" }) do
+  debug.los_engine(e)
+  for depth = 1, 5 do
+    run_los_tests(depth, 1, 1)
+  end
 end
+debug.los_engine(engine)
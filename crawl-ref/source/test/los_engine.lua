@@ -0,0 +1,57 @@
+-- Check that the losight() engines agree with each other.
+
+local FAILMAP = 'losfail.map'
+local checks = 0
+
+local function view_with(engine, cx, cy)
+  debug.los_engine(engine)
+  local seen = { }
+  for y = -8, 8 do
+    for x = -8, 8 do
+      local px, py = x + cx, y + cy
+      if dgn.in_bounds(px, py) then
+        seen[x .. "," .. y] = los.cell_see_cell(cx, cy, px, py)
+      end
+    end
+  end
+  return seen
+end
+
+local function test_engines_agree()
+  you.random_teleport()
+
+  checks = checks + 1
+  local you_x, you_y = you.pos()
+
+  local raycast = view_with("raycast", you_x, you_y)
+  local bitboard = view_with("bitboard", you_x, you_y)
+  for k, v in pairs(raycast) do
+    if bitboard[k] ~= v then
+      debug.dump_map(FAILMAP)
+      assert(false,
+             "LOS engines disagree (iter #" .. checks .. ") at offset "
+               .. k .. " from " .. dgn.point(you_x, you_y) .. "."
+               .. " Map saved to " .. FAILMAP)
+    end
+  end
+end
+
+local function run_los_tests(depth, nlevels, tests_per_level)
+  local place = "D:" .. depth
+  crawl.message("Running LOS engine tests on " .. place)
+  debug.goto_place(place)
+
+  for lev_i = 1, nlevels do
+    debug.reset_player_data()
+    debug.generate_level()
+    for t_i = 1, tests_per_level do
+      test_engines_agree()
+    end
+  end
+end
+
+local engine = debug.los_engine()
+for depth = 1, 5 do
+  run_los_tests(depth, 1, 3)
+end
+debug.los_engine(engine)
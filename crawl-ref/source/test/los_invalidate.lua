@@ -0,0 +1,68 @@
+-- Vet selective invalidation of the global LOS cache: after terrain
+-- changes, cached cell_see_cell must agree with a freshly wiped cache.
+
+local FAILMAP = 'losfail.map'
+local checks = 0
+
+local function cached_view(cx, cy)
+  local seen = { }
+  for y = -8, 8 do
+    for x = -8, 8 do
+      local px, py = x + cx, y + cy
+      if dgn.in_bounds(px, py) then
+        seen[x .. "," .. y] = los.cell_see_cell(cx, cy, px, py)
+      end
+    end
+  end
+  return seen
+end
+
+local function test_invalidate_around()
+  you.random_teleport()
+
+  checks = checks + 1
+  local you_x, you_y = you.pos()
+
+  -- Fill the cache, then dig and build some nearby cells.
+  cached_view(you_x, you_y)
+  for i = 1, 6 do
+    local px = you_x + crawl.random_range(-5, 5)
+    local py = you_y + crawl.random_range(-5, 5)
+    if (px ~= you_x or py ~= you_y) and dgn.in_bounds(px, py) then
+      local feat = crawl.coinflip() and "rock_wall" or "floor"
+      dgn.terrain_changed(px, py, feat, false, false)
+    end
+  end
+
+  local incremental = cached_view(you_x, you_y)
+  debug.los_changed()
+  local full = cached_view(you_x, you_y)
+
+  for k, v in pairs(full) do
+    if incremental[k] ~= v then
+      debug.dump_map(FAILMAP)
+      assert(false,
+             "stale LOS cache entry (iter #" .. checks .. ") at offset "
+               .. k .. " from " .. dgn.point(you_x, you_y) .. "."
+               .. " Map saved to " .. FAILMAP)
+    end
+  end
+end
+
+local function run_los_tests(depth, nlevels, tests_per_level)
+  local place = "D:" .. depth
+  crawl.message("Running LOS invalidation tests on " .. place)
+  debug.goto_place(place)
+
+  for lev_i = 1, nlevels do
+    debug.reset_player_data()
+    debug.generate_level()
+    for t_i = 1, tests_per_level do
+      test_invalidate_around()
+    end
+  end
+end
+
+for depth = 1, 5 do
+  run_los_tests(depth, 1, 3)
+end
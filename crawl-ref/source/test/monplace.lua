@@ -27,3 +27,61 @@ assert_place_monster_on("cyan ugly thing")
 assert_place_monster_on("purple very ugly thing")
 
 dgn.dismiss_monsters()
+
+-- monster_iterator walks a list of the slots in use rather than all of
+-- env.mons; check it against a full scan as monsters come and go.
+local function check_iterators(when)
+  assert(debug.check_monster_iterator(),
+         "monster iterators disagree with env.mons " .. when)
+end
+
+local function place_monsters(from, to, monster)
+  local placed = { }
+  local ux, uy = you.pos()
+  for x = from, to do
+    for y = 20, 24 do
+      if x ~= ux or y ~= uy then
+        dgn.grid(x, y, "floor")
+        local mons = dgn.create_monster(x, y, monster)
+        if mons then
+          table.insert(placed, mons)
+        end
+      end
+    end
+  end
+  assert(#placed > 0, "Could not place any " .. monster)
+  return placed
+end
+
+check_iterators("with no monsters")
+
+local placed = place_monsters(10, 40, "rat")
+check_iterators("after placing monsters")
+
+for i = 1, #placed, 3 do
+  placed[i].dismiss()
+end
+check_iterators("after killing some monsters")
+
+-- These fill the freed slots, below monsters still alive.
+place_monsters(10, 40, "quokka")
+check_iterators("after refilling freed slots")
+
+debug.clear_monster_flags()
+check_iterators("after the end of a turn")
+
+for i = 2, #placed, 3 do
+  placed[i].dismiss()
+end
+debug.clear_monster_flags()
+check_iterators("after killing more monsters")
+
+dgn.dismiss_monsters()
+check_iterators("after killing every monster")
+debug.clear_monster_flags()
+check_iterators("after the turn everything died")
+
+place_monsters(10, 12, "rat")
+check_iterators("after placing monsters into an empty list")
+
+dgn.dismiss_monsters()
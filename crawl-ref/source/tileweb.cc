@@ -13,6 +13,7 @@
 #include <sys/un.h>
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
+#include <zlib.h>
 #endif
 
 #include "artefact.h"
@@ -93,6 +94,7 @@ TilesFramework::TilesFramework() :
       m_next_view_tl(0, 0),
       m_next_view_br(-1, -1),
       m_need_full_map(true),
+      m_frame_zs(nullptr),
       m_text_menu("menu_txt"),
       m_print_fg(15)
 {
@@ -104,6 +106,11 @@ TilesFramework::TilesFramework() :
 
 TilesFramework::~TilesFramework()
 {
+    if (m_frame_zs)
+    {
+        deflateEnd(m_frame_zs);
+        delete m_frame_zs;
+    }
 }
 
 void TilesFramework::shutdown()
@@ -111,6 +118,7 @@ void TilesFramework::shutdown()
     if (m_sock_name.empty())
         return;
 
+    _flush_frame_batch();
     close(m_sock);
     remove(m_sock_name.c_str());
 }
@@ -200,6 +208,18 @@ void TilesFramework::finish_message()
         return;
     }
 
+    // Everything but server control messages and frames waits for the next
+    // flush, to go out as one shared frame.
+    if (_shared_frames() && m_msg_buf[0] != '*' && m_msg_buf[0] != '#')
+    {
+        if (!m_frame_batch.empty())
+            m_frame_batch.push_back(',');
+        m_frame_batch.append(m_msg_buf);
+        m_msg_buf.clear();
+        m_need_flush = true;
+        return;
+    }
+
     m_msg_buf.append("\n");
     const char* fragment_start = m_msg_buf.data();
     const char* data_end = m_msg_buf.data() + m_msg_buf.size();
@@ -257,6 +277,8 @@ void TilesFramework::finish_message()
                             "failed (%s), breaking.\n", errmsg);
 #endif
                         m_dest_addrs.erase(m_dest_addrs.begin() + i);
+                        m_dest_binary.erase(m_dest_binary.begin() + i);
+                        m_dest_shared.erase(m_dest_shared.begin() + i);
                         i--;
                         break;
                     }
@@ -315,6 +337,7 @@ void TilesFramework::flush_messages()
         return;
     unwind_bool no_rentry(_send_lock, true);
 
+    _flush_frame_batch();
     if (m_need_flush)
     {
         send_message("*{\"msg\":\"flush_messages\"}");
@@ -439,8 +462,30 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         JsonWrapper primary = json_find_member(obj.node, "primary");
         primary.check(JSON_BOOL);
 
+        // Anything batched so far is for the destinations we already have.
+        _flush_frame_batch();
+
         m_dest_addrs.push_back(addr);
         m_controlled_from_web = primary->bool_;
+
+        JsonWrapper binary = json_find_member(obj.node, "binary_maps");
+        m_dest_binary.push_back(binary.node && binary->tag == JSON_BOOL
+                                && binary->bool_);
+
+        JsonWrapper shared = json_find_member(obj.node, "shared_frames");
+        m_dest_shared.push_back(shared.node && shared->tag == JSON_BOOL
+                                && shared->bool_);
+        if (m_dest_shared.back())
+            _send_frame_dictionary();
+    }
+    else if (msgtype == "binary_maps")
+    {
+        JsonWrapper enabled = json_find_member(obj.node, "enabled");
+        enabled.check(JSON_BOOL);
+
+        for (unsigned int i = 0; i < m_dest_addrs.size(); ++i)
+            if (!strcmp(m_dest_addrs[i].sun_path, addr.sun_path))
+                m_dest_binary[i] = enabled->bool_;
     }
     else if (msgtype == "key")
     {
@@ -1504,6 +1549,19 @@ static bool _needs_flavour(const packed_cell &cell)
 
 }
 
+static bool _overlays_changed(const packed_cell &current_pc,
+                              const packed_cell &next_pc)
+{
+    if (next_pc.num_dngn_overlay != current_pc.num_dngn_overlay)
+        return true;
+
+    for (int i = 0; i < next_pc.num_dngn_overlay; i++)
+        if (next_pc.dngn_overlay[i] != current_pc.dngn_overlay[i])
+            return true;
+
+    return false;
+}
+
 // XX code duplicateion
 static inline unsigned _get_highlight(int col)
 {
@@ -1531,6 +1589,108 @@ void TilesFramework::write_tileidx(tileidx_t t)
         tiles.write_message("[%d,%d]", lo, hi);
 }
 
+// XXX: Encode spell school overlays for parchments.
+void TilesFramework::_send_parchment_schools(const packed_cell &pc)
+{
+    const tileidx_t fg_idx = pc.fg & TILE_FLAG_MASK;
+    if (fg_idx < TILE_PARCHMENT_LOW || fg_idx > TILE_PARCHMENT_HIGH)
+        return;
+
+    const item_def* item = pc.map_knowledge.item();
+    if (item)
+    {
+        spell_type spell = static_cast<spell_type>(item->plus);
+        const tileidx_t school1 = tileidx_parchment_overlay(spell, 0);
+        const tileidx_t school2 = tileidx_parchment_overlay(spell, 1);
+
+        if (school1 > 0)
+            json_write_int("overlay1", school1);
+        if (school2 > 0)
+            json_write_int("overlay2", school2);
+    }
+}
+
+void TilesFramework::_send_doll_fields(const packed_cell &next_pc,
+                                       bool fg_changed)
+{
+    const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
+    const bool in_water = _in_water(next_pc);
+
+    if (fg_idx >= TILEP_MCACHE_START)
+    {
+        if (fg_changed)
+        {
+            mcache_entry *entry = mcache.get(fg_idx);
+            if (entry)
+                send_mcache(entry, in_water);
+            else
+            {
+                json_write_comma();
+                write_message("\"doll\":[[%d,%d]]", TILEP_MONS_UNKNOWN, TILE_Y);
+                json_write_null("mcache");
+            }
+        }
+    }
+    else if (fg_idx == TILEP_PLAYER)
+    {
+        bool player_doll_changed = false;
+        dolls_data result = player_doll;
+        fill_doll_equipment(result);
+        if (result != last_player_doll)
+        {
+            player_doll_changed = true;
+            last_player_doll = result;
+        }
+        if (fg_changed || player_doll_changed)
+        {
+            send_doll(last_player_doll, in_water, false);
+            if (player_uses_monster_tile())
+            {
+                monster_info minfo(MONS_PLAYER, MONS_PLAYER);
+                minfo.props[MONSTER_TILE_KEY] =
+                    int(last_player_doll.parts[TILEP_PART_BASE]);
+                item_def *item;
+                if (item = you.equipment.get_first_slot_item(SLOT_WEAPON))
+                {
+                    item = new item_def(*item);
+                    minfo.inv[MSLOT_WEAPON].reset(item);
+                }
+                if (item = you.equipment.get_first_slot_item(SLOT_OFFHAND))
+                {
+                    item = new item_def(*item);
+                    minfo.inv[MSLOT_SHIELD].reset(item);
+                }
+                tileidx_t mcache_idx = mcache.register_monster(minfo);
+                mcache_entry *entry = mcache.get(mcache_idx);
+                if (entry)
+                    send_mcache(entry, in_water, false);
+                else
+                    json_write_null("mcache");
+            }
+            else
+                json_write_null("mcache");
+        }
+    }
+    else if (get_tile_texture(fg_idx) == TEX_PLAYER)
+    {
+        if (fg_changed)
+        {
+            json_write_comma();
+            write_message("\"doll\":[[%u,%d]]", (unsigned int) fg_idx, TILE_Y);
+            json_write_null("mcache");
+        }
+    }
+    else
+    {
+        if (fg_changed)
+        {
+            json_write_comma();
+            json_write_null("doll");
+            json_write_null("mcache");
+        }
+    }
+}
+
 void TilesFramework::_send_cell(const coord_def &gc,
                                 const screen_cell_t &current_sc, const screen_cell_t &next_sc,
                                 const map_cell &current_mc, const map_cell &next_mc,
@@ -1577,7 +1737,6 @@ void TilesFramework::_send_cell(const coord_def &gc,
 
         const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
 
-        const bool in_water = _in_water(next_pc);
         bool fg_changed = false;
 
         if (next_pc.fg != current_pc.fg)
@@ -1589,22 +1748,7 @@ void TilesFramework::_send_cell(const coord_def &gc,
             if (get_tile_texture(fg_idx) == TEX_DEFAULT)
                 json_write_int("base", (int) tileidx_known_base_item(fg_idx));
 
-            // XXX: Encode spell school overlays for parchments.
-            if (fg_idx >= TILE_PARCHMENT_LOW && fg_idx <= TILE_PARCHMENT_HIGH)
-            {
-                const item_def* item = next_pc.map_knowledge.item();
-                if (item)
-                {
-                    spell_type spell = static_cast<spell_type>(item->plus);
-                    const tileidx_t school1 = tileidx_parchment_overlay(spell, 0);
-                    const tileidx_t school2 = tileidx_parchment_overlay(spell, 1);
-
-                    if (school1 > 0)
-                        json_write_int("overlay1", school1);
-                    if (school2 > 0)
-                        json_write_int("overlay2", school2);
-                }
-            }
+            _send_parchment_schools(next_pc);
         }
 
         if (next_pc.bg != current_pc.bg)
@@ -1688,105 +1832,624 @@ void TilesFramework::_send_cell(const coord_def &gc,
             json_close_object();
         }
 
-        if (fg_idx >= TILEP_MCACHE_START)
+        _send_doll_fields(next_pc, fg_changed);
+
+        if (_overlays_changed(current_pc, next_pc))
         {
-            if (fg_changed)
-            {
-                mcache_entry *entry = mcache.get(fg_idx);
-                if (entry)
-                    send_mcache(entry, in_water);
-                else
-                {
-                    json_write_comma();
-                    write_message("\"doll\":[[%d,%d]]", TILEP_MONS_UNKNOWN, TILE_Y);
-                    json_write_null("mcache");
-                }
-            }
+            json_open_array("ov");
+            for (int i = 0; i < next_pc.num_dngn_overlay; ++i)
+                json_write_int(next_pc.dngn_overlay[i]);
+            json_close_array();
         }
-        else if (fg_idx == TILEP_PLAYER)
+    }
+    json_close_object(true);
+}
+
+/*
+  Binary map frames
+
+  When every destination has asked for them (see the "binary_maps" control
+  message), map updates go out as a compact binary frame rather than the
+  JSON "map" message. The webserver forwards them as binary websocket
+  frames, and decode_binary_map() in game_data/static/display.js turns them
+  back into the same structure as the JSON message, so keep the two in
+  sync.
+
+  Integers are LEB128 varints; coordinates are zigzag-encoded. A frame is
+
+      0x00 MAP_FRAME_VERSION
+      flags                 MAP_FRAME_*
+      [vgrdc x, y]          if MAP_FRAME_VGRDC
+      origin x, y
+      row width
+
+  followed, up to the end of the frame, by cell records
+
+      skip * 2 + repeat     cells left unchanged before this record
+      [count]               cells the record applies to, if repeat
+      mask                  MCF_*
+      fields                one per bit set in mask, in bit order
+*/
+
+#define MAP_FRAME_VERSION 1
+
+enum map_frame_flag
+{
+    MAP_FRAME_CLEAR          = 1 << 0,
+    MAP_FRAME_SPECT_ONLY     = 1 << 1,
+    MAP_FRAME_ON_LEVEL       = 1 << 2,
+    MAP_FRAME_ON_LEVEL_VALUE = 1 << 3,
+    MAP_FRAME_VGRDC          = 1 << 4,
+};
+
+enum map_cell_field
+{
+    MCF_FEAT            = 1 << 0,
+    MCF_MAP_FEATURE     = 1 << 1,
+    MCF_GLYPH           = 1 << 2,
+    MCF_COLOUR          = 1 << 3,
+    MCF_FLASH_COLOUR    = 1 << 4,
+    MCF_FLASH_ALPHA     = 1 << 5,
+    MCF_NO_MONSTER      = 1 << 6,
+    MCF_FG              = 1 << 7,
+    MCF_BASE            = 1 << 8,
+    MCF_BG              = 1 << 9,
+    MCF_CLOUD           = 1 << 10,
+    MCF_ICONS           = 1 << 11,
+    MCF_FLAGS           = 1 << 12, // changed MCB_* bits, then their values
+    MCF_HALO            = 1 << 13,
+    MCF_ORB_GLOW        = 1 << 14,
+    MCF_BLOOD_ROTATION  = 1 << 15,
+    MCF_TRAVEL_TRAIL    = 1 << 16,
+    MCF_FLAVOUR         = 1 << 17,
+    MCF_OVERLAYS        = 1 << 18,
+    MCF_NO_DOLL         = 1 << 19,
+    MCF_JSON            = 1 << 20, // length-prefixed JSON, see _pack_cell()
+};
+
+enum map_cell_bool
+{
+    MCB_BLOODY,
+    MCB_OLD_BLOOD,
+    MCB_SILENCED,
+    MCB_HIGHLIGHTED_SUMMONER,
+    MCB_SANCTUARY,
+    MCB_BLASPHEMY,
+    MCB_BFB_CORPSE,
+    MCB_LIQUEFIED,
+    MCB_QUAD_GLOW,
+    MCB_DISJUNCT,
+    MCB_MANGROVE_WATER,
+    MCB_AWAKENED_FOREST,
+};
+
+static void _pack_varint(string &buf, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+// Sent as the 32-bit pattern; the client recovers negative values with |0.
+static void _pack_int(string &buf, int v)
+{
+    _pack_varint(buf, static_cast<uint32_t>(v));
+}
+
+static void _pack_coord(string &buf, int v)
+{
+    const uint32_t u = static_cast<uint32_t>(v);
+    _pack_varint(buf, v < 0 ? ~(u << 1) : u << 1);
+}
+
+static void _base64_append(string &out, const string &in)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3)
+    {
+        const uint32_t n = (uint8_t) in[i] << 16 | (uint8_t) in[i + 1] << 8
+                           | (uint8_t) in[i + 2];
+        out.push_back(digits[n >> 18]);
+        out.push_back(digits[n >> 12 & 0x3F]);
+        out.push_back(digits[n >> 6 & 0x3F]);
+        out.push_back(digits[n & 0x3F]);
+    }
+    if (i < in.size())
+    {
+        const bool two = i + 1 < in.size();
+        const uint32_t n = (uint8_t) in[i] << 16
+                           | (two ? (uint8_t) in[i + 1] << 8 : 0);
+        out.push_back(digits[n >> 18]);
+        out.push_back(digits[n >> 12 & 0x3F]);
+        out.push_back(two ? digits[n >> 6 & 0x3F] : '=');
+        out.push_back('=');
+    }
+}
+
+bool TilesFramework::_binary_maps() const
+{
+    return !m_dest_binary.empty()
+           && all_of(m_dest_binary.begin(), m_dest_binary.end(),
+                     [](bool b) { return b; });
+}
+
+void TilesFramework::_finish_binary_message(const string &frame)
+{
+    if (_shared_frames())
+    {
+        _flush_frame_batch();
+        _send_shared_frame(frame, (uint8_t) frame[2]
+                                  & (MAP_FRAME_CLEAR | MAP_FRAME_SPECT_ONLY));
+        return;
+    }
+
+    // The socket to the webserver carries newline-terminated text, so the
+    // frame is base64-encoded behind a '#'. The server decodes it once and
+    // forwards the raw bytes.
+    m_msg_buf.append("#");
+    _base64_append(m_msg_buf, frame);
+    finish_message();
+}
+
+/*
+  Shared frames
+
+  Deflating every message once per websocket is what costs a webserver with
+  many spectators the most, so destinations that attach with "shared_frames"
+  get everything but server control messages pre-compressed, and the server
+  can forward the same bytes to every watcher. Messages are batched up to
+  the next flush_messages() and sent as a single frame:
+
+      0x02
+      flags                 MAP_FRAME_CLEAR, MAP_FRAME_SPECT_ONLY
+      raw deflate           of a {"msg":"multi","msgs":[...]} batch or a
+                            binary map frame, with a sync flush and the
+                            trailing 00 00 ff ff cut off
+
+  Each frame is compressed on its own, starting from _frame_dictionary,
+  so that it doesn't depend on what any particular watcher has seen before.
+  The dictionary is sent to the server in a "frame_dictionary" control
+  message on attach; it may be changed freely, since clients always get it
+  from the game they're watching.
+*/
+
+#define SHARED_FRAME 0x02
+
+// Fragments of the most common messages, the most common ones last, since
+// deflate reaches the end of the dictionary most cheaply. ASCII only, as the
+// clients rebuild the bytes from a JSON string.
+static const char _frame_dictionary[] =
+    "{\"msg\":\"ui_state\",\"msg\":\"update_menu\",\"msg\":\"menu\",\"items\":["
+    "{\"msg\":\"txt\",\"id\":\"lines\":{\"msg\":\"cursor\",\"id\":\"loc\":"
+    "{\"msg\":\"input_mode\",\"mode\":\"msg\":\"player\",\"name\":\"place\":"
+    "\"Dungeon\",\"depth\":\"god\":\"piety_rank\":\"penance\":\"xl\":"
+    "\"progress\":\"gold\":\"time\":\"turn\":\"str\":\"int\":\"dex\":\"ac\":"
+    "\"ev\":\"sh\":\"hp\":\"hp_max\":\"real_hp_max\":\"mp\":\"mp_max\":"
+    "\"contam\":\"noise\":\"adjusted_noise\":\"status\":[{\"light\":\"text\":"
+    "\"desc\":\"inv\":{\"0\":{\"name\":\"base_type\":\"sub_type\":\"qty_field\":"
+    "\"quantity\":\"flags\":\"tile\":\"action_panel_order\":\"equip\":"
+    "{\"msg\":\"msgs\",\"messages\":[{\"text\":\"<lightgrey>\",\"turn\":"
+    "\"channel\":\"more\":false,\"mon\":{\"id\":\"name\":\"plural\":\"type\":"
+    "\"typedata\":{\"avghp\":\"att\":\"btype\":\"threat\":\"mon\":null,"
+    "\"doll\":null,\"mcache\":null,\"icons\":[\"ov\":[\"halo\":\"cloud\":"
+    "\"bloody\":true,\"travel_trail\":\"orb_glow\":\"sanctuary\":true,"
+    "{\"msg\":\"map\",\"cells\":[{\"x\":\"y\":\"f\":\"mf\":\"g\":\"col\":"
+    "\"t\":{\"fg\":\"bg\":\"base\":\"flv\":{\"f\":\"s\":\"}},{\"x\":\"},{\"f\":"
+    "\"},{\"g\":\"},{\"mf\":\"},{\"t\":{\"bg\":\"},{\"col\":\"}},{\"t\":{\"fg\":";
+
+bool TilesFramework::_shared_frames() const
+{
+    return !m_dest_shared.empty()
+           && all_of(m_dest_shared.begin(), m_dest_shared.end(),
+                     [](bool b) { return b; });
+}
+
+void TilesFramework::_send_frame_dictionary()
+{
+    write_message("*{\"msg\":\"frame_dictionary\",\"dictionary\":\"");
+    write_message_escaped(_frame_dictionary);
+    write_message("\"}");
+    finish_message();
+}
+
+void TilesFramework::_send_shared_frame(const string &payload, int flags)
+{
+    if (!m_frame_zs)
+    {
+        m_frame_zs = new z_stream();
+        if (deflateInit2(m_frame_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         {
-            bool player_doll_changed = false;
-            dolls_data result = player_doll;
-            fill_doll_equipment(result);
-            if (result != last_player_doll)
-            {
-                player_doll_changed = true;
-                last_player_doll = result;
-            }
-            if (fg_changed || player_doll_changed)
-            {
-                send_doll(last_player_doll, in_water, false);
-                if (player_uses_monster_tile())
-                {
-                    monster_info minfo(MONS_PLAYER, MONS_PLAYER);
-                    minfo.props[MONSTER_TILE_KEY] =
-                        int(last_player_doll.parts[TILEP_PART_BASE]);
-                    item_def *item;
-                    if (item = you.equipment.get_first_slot_item(SLOT_WEAPON))
-                    {
-                        item = new item_def(*item);
-                        minfo.inv[MSLOT_WEAPON].reset(item);
-                    }
-                    if (item = you.equipment.get_first_slot_item(SLOT_OFFHAND))
-                    {
-                        item = new item_def(*item);
-                        minfo.inv[MSLOT_SHIELD].reset(item);
-                    }
-                    tileidx_t mcache_idx = mcache.register_monster(minfo);
-                    mcache_entry *entry = mcache.get(mcache_idx);
-                    if (entry)
-                        send_mcache(entry, in_water, false);
-                    else
-                        json_write_null("mcache");
-                }
-                else
-                    json_write_null("mcache");
-            }
+            die("Can't initialise the webtiles frame compressor: %s",
+                m_frame_zs->msg ? m_frame_zs->msg : "unknown error");
         }
-        else if (get_tile_texture(fg_idx) == TEX_PLAYER)
+    }
+    else if (deflateReset(m_frame_zs) != Z_OK)
+        die("Can't reset the webtiles frame compressor");
+
+    if (deflateSetDictionary(m_frame_zs, (const Bytef*) _frame_dictionary,
+                             sizeof(_frame_dictionary) - 1) != Z_OK)
+    {
+        die("Can't set the webtiles frame dictionary");
+    }
+
+    string frame;
+    frame.push_back(SHARED_FRAME);
+    frame.push_back(flags);
+
+    m_frame_zs->next_in = (Bytef*) payload.data();
+    m_frame_zs->avail_in = payload.size();
+    Bytef buf[16384];
+    do
+    {
+        m_frame_zs->next_out = buf;
+        m_frame_zs->avail_out = sizeof(buf);
+        const int ret = deflate(m_frame_zs, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            die("Webtiles frame compression error: %d", ret);
+        frame.append((const char*) buf, sizeof(buf) - m_frame_zs->avail_out);
+    }
+    while (m_frame_zs->avail_out == 0);
+
+    ASSERT(frame.size() >= 6
+           && !frame.compare(frame.size() - 4, 4, "\0\0\xff\xff", 4));
+    frame.resize(frame.size() - 4);
+
+    m_msg_buf.append("#");
+    _base64_append(m_msg_buf, frame);
+    finish_message();
+}
+
+void TilesFramework::_flush_frame_batch(int flags)
+{
+    if (m_frame_batch.empty())
+        return;
+
+    string batch = "{\"msg\":\"multi\",\"msgs\":[";
+    batch.append(m_frame_batch);
+    batch.append("]}");
+    m_frame_batch.clear();
+
+    if (_shared_frames())
+        _send_shared_frame(batch, flags);
+    else
+    {
+        // Every destination that wanted shared frames has gone away.
+        m_msg_buf.append(batch);
+        finish_message();
+    }
+}
+
+// Packs the changes between two states of a cell into rec, which is left
+// empty if nothing changed. The fields mirror _send_cell(); monsters, dolls
+// and parchment overlays are rare and irregular, so they're carried as a
+// JSON fragment of the form {"mon":...,"t":{...}} instead.
+void TilesFramework::_pack_cell(string &rec, const coord_def &gc,
+                                const screen_cell_t &current_sc, const screen_cell_t &next_sc,
+                                const map_cell &current_mc, const map_cell &next_mc,
+                                map<uint32_t, coord_def>& new_monster_locs,
+                                bool force_full)
+{
+    const packed_cell &next_pc = next_sc.tile;
+    const packed_cell &current_pc = current_sc.tile;
+    const tileidx_t fg_idx = next_pc.fg & TILE_FLAG_MASK;
+    const bool fg_changed = next_pc.fg != current_pc.fg;
+
+    uint32_t mask = 0;
+    string fields;
+
+    if (current_mc.feat() != next_mc.feat())
+    {
+        mask |= MCF_FEAT;
+        _pack_int(fields, next_mc.feat());
+    }
+
+    map_feature mf = get_cell_map_feature(gc);
+    if (get_cell_map_feature(current_mc) != mf)
+    {
+        mask |= MCF_MAP_FEATURE;
+        _pack_int(fields, mf);
+    }
+
+    char32_t glyph = next_sc.glyph;
+    if (current_sc.glyph != glyph)
+    {
+        mask |= MCF_GLYPH;
+        _pack_varint(fields, glyph);
+    }
+    if ((current_sc.colour != next_sc.colour
+         || current_sc.glyph == ' ') && glyph != ' ')
+    {
+        int col = next_sc.colour;
+        mask |= MCF_COLOUR;
+        _pack_int(fields, (_get_highlight(col) << 4) | macro_colour(col & 0xF));
+    }
+    if (current_sc.flash_colour != next_sc.flash_colour)
+    {
+        mask |= MCF_FLASH_COLOUR;
+        _pack_int(fields, next_sc.flash_colour);
+    }
+    if (current_sc.flash_alpha != next_sc.flash_alpha)
+    {
+        mask |= MCF_FLASH_ALPHA;
+        _pack_int(fields, next_sc.flash_alpha);
+    }
+
+    if (!next_mc.monsterinfo() && current_mc.monsterinfo())
+        mask |= MCF_NO_MONSTER;
+
+    if (fg_changed)
+    {
+        mask |= MCF_FG;
+        _pack_varint(fields, next_pc.fg);
+        if (get_tile_texture(fg_idx) == TEX_DEFAULT)
         {
-            if (fg_changed)
-            {
-                json_write_comma();
-                write_message("\"doll\":[[%u,%d]]", (unsigned int) fg_idx, TILE_Y);
-                json_write_null("mcache");
-            }
+            mask |= MCF_BASE;
+            _pack_int(fields, tileidx_known_base_item(fg_idx));
         }
-        else
+    }
+
+    if (next_pc.bg != current_pc.bg)
+    {
+        mask |= MCF_BG;
+        _pack_varint(fields, next_pc.bg);
+    }
+
+    if (next_pc.cloud != current_pc.cloud)
+    {
+        mask |= MCF_CLOUD;
+        _pack_varint(fields, next_pc.cloud);
+    }
+
+    if (next_pc.icons != current_pc.icons)
+    {
+        mask |= MCF_ICONS;
+        _pack_varint(fields, next_pc.icons.size());
+        for (const tileidx_t icon : next_pc.icons)
+            _pack_varint(fields, icon);
+    }
+
+    uint32_t changed = 0, values = 0;
+    auto flag = [&](map_cell_bool bit, bool differs, bool value)
+    {
+        if (!differs)
+            return;
+        changed |= 1 << bit;
+        if (value)
+            values |= 1 << bit;
+    };
+    if (Options.show_blood)
+    {
+        flag(MCB_BLOODY, next_pc.is_bloody != current_pc.is_bloody,
+             next_pc.is_bloody);
+        flag(MCB_OLD_BLOOD, next_pc.old_blood != current_pc.old_blood,
+             next_pc.old_blood);
+    }
+    flag(MCB_SILENCED, next_pc.is_silenced != current_pc.is_silenced,
+         next_pc.is_silenced);
+    flag(MCB_HIGHLIGHTED_SUMMONER,
+         next_pc.is_highlighted_summoner != current_pc.is_highlighted_summoner,
+         next_pc.is_highlighted_summoner);
+    flag(MCB_SANCTUARY, next_pc.is_sanctuary != current_pc.is_sanctuary,
+         next_pc.is_sanctuary);
+    flag(MCB_BLASPHEMY, next_pc.is_blasphemy != current_pc.is_blasphemy,
+         next_pc.is_blasphemy);
+    flag(MCB_BFB_CORPSE, next_pc.has_bfb_corpse != current_pc.has_bfb_corpse,
+         next_pc.has_bfb_corpse);
+    flag(MCB_LIQUEFIED, next_pc.is_liquefied != current_pc.is_liquefied,
+         next_pc.is_liquefied);
+    flag(MCB_QUAD_GLOW, next_pc.quad_glow != current_pc.quad_glow,
+         next_pc.quad_glow);
+    flag(MCB_DISJUNCT, next_pc.disjunct != current_pc.disjunct,
+         next_pc.disjunct);
+    flag(MCB_MANGROVE_WATER, next_pc.mangrove_water != current_pc.mangrove_water,
+         next_pc.mangrove_water);
+    flag(MCB_AWAKENED_FOREST,
+         next_pc.awakened_forest != current_pc.awakened_forest,
+         next_pc.awakened_forest);
+    if (changed)
+    {
+        mask |= MCF_FLAGS;
+        _pack_varint(fields, changed);
+        _pack_varint(fields, values);
+    }
+
+    if (next_pc.halo != current_pc.halo)
+    {
+        mask |= MCF_HALO;
+        _pack_int(fields, next_pc.halo);
+    }
+
+    if (next_pc.orb_glow != current_pc.orb_glow)
+    {
+        mask |= MCF_ORB_GLOW;
+        _pack_int(fields, next_pc.orb_glow);
+    }
+
+    if (next_pc.blood_rotation != current_pc.blood_rotation)
+    {
+        mask |= MCF_BLOOD_ROTATION;
+        _pack_int(fields, next_pc.blood_rotation);
+    }
+
+    if (next_pc.travel_trail != current_pc.travel_trail)
+    {
+        mask |= MCF_TRAVEL_TRAIL;
+        _pack_int(fields, next_pc.travel_trail);
+    }
+
+    if (_needs_flavour(next_pc) &&
+        (next_pc.flv.floor != current_pc.flv.floor
+         || next_pc.flv.special != current_pc.flv.special
+         || !_needs_flavour(current_pc)
+         || force_full))
+    {
+        mask |= MCF_FLAVOUR;
+        _pack_int(fields, next_pc.flv.floor);
+        _pack_int(fields, next_pc.flv.special);
+    }
+
+    if (_overlays_changed(current_pc, next_pc))
+    {
+        mask |= MCF_OVERLAYS;
+        _pack_varint(fields, next_pc.num_dngn_overlay);
+        for (int i = 0; i < next_pc.num_dngn_overlay; ++i)
+            _pack_int(fields, next_pc.dngn_overlay[i]);
+    }
+
+    const bool plain_fg = fg_idx < TILEP_MCACHE_START
+                          && fg_idx != TILEP_PLAYER
+                          && get_tile_texture(fg_idx) != TEX_PLAYER;
+    if (plain_fg && fg_changed)
+        mask |= MCF_NO_DOLL;
+
+    json_open_object();
+    if (next_mc.monsterinfo())
+        _send_monster(gc, next_mc.monsterinfo(), new_monster_locs, force_full);
+    json_open_object("t");
+    if (fg_changed)
+        _send_parchment_schools(next_pc);
+    if (!plain_fg)
+        _send_doll_fields(next_pc, fg_changed);
+    json_close_object(true);
+    json_close_object(true);
+    if (!m_msg_buf.empty())
+    {
+        mask |= MCF_JSON;
+        _pack_varint(fields, m_msg_buf.size());
+        fields.append(m_msg_buf);
+        m_msg_buf.clear();
+    }
+
+    rec.clear();
+    if (mask)
+    {
+        _pack_varint(rec, mask);
+        rec.append(fields);
+    }
+}
+
+void TilesFramework::_send_binary_map(bool spectator_only, bool force_full,
+                                      map<uint32_t, coord_def>& new_monster_locs)
+{
+    // cautionary note: these two are read from the frame's third byte by
+    // process_handler.py, see `handle_process_binary`
+    int flags = 0;
+    if (spectator_only)
+        flags |= MAP_FRAME_SPECT_ONLY;
+    if (force_full)
+        flags |= MAP_FRAME_CLEAR;
+
+    if (force_full || you.on_current_level != m_player_on_level)
+    {
+        flags |= MAP_FRAME_ON_LEVEL;
+        if (you.on_current_level)
+            flags |= MAP_FRAME_ON_LEVEL_VALUE;
+        m_player_on_level = you.on_current_level;
+    }
+
+    string vgrdc;
+    if (force_full || m_current_gc != m_next_gc)
+    {
+        if (m_origin.equals(-1, -1))
+            m_origin = m_next_gc;
+        flags |= MAP_FRAME_VGRDC;
+        _pack_coord(vgrdc, m_next_gc.x - m_origin.x);
+        _pack_coord(vgrdc, m_next_gc.y - m_origin.y);
+        m_current_gc = m_next_gc;
+    }
+
+    screen_cell_t default_cell;
+    default_cell.tile.bg = TILE_FLAG_UNSEEN;
+    default_cell.glyph = ' ';
+    default_cell.colour = 7;
+    map_cell default_map_cell;
+
+    int flash_colour = you.flash_colour;
+    if (flash_colour == BLACK)
+        flash_colour = viewmap_flash_colour();
+
+    // Consecutive cells with identical records are sent as one run.
+    string cells, rec, run;
+    int run_start = 0, run_len = 0, sent_to = 0;
+    auto flush_run = [&]()
+    {
+        if (!run_len)
+            return;
+        _pack_varint(cells, (run_start - sent_to) * 2 + (run_len > 1));
+        if (run_len > 1)
+            _pack_varint(cells, run_len);
+        cells.append(run);
+        sent_to = run_start + run_len;
+        run_len = 0;
+    };
+
+    for (int y = 0; y < GYM; y++)
+        for (int x = 0; x < GXM; x++)
         {
-            if (fg_changed)
+            coord_def gc(x, y);
+
+            if (!is_dirty(gc) && !force_full)
+                continue;
+
+            if (cell_needs_redraw(gc))
             {
-                json_write_comma();
-                json_write_null("doll");
-                json_write_null("mcache");
+                screen_cell_t *cell = &m_next_view(gc);
+
+                if (you.flash_where && you.flash_where->is_affected(gc) <= 0)
+                    draw_cell(cell, gc, false, 0);
+                else
+                    draw_cell(cell, gc, false, flash_colour);
+
+                pack_cell_overlays(gc, m_next_view);
             }
-        }
 
-        bool overlays_changed = false;
+            mark_clean(gc);
 
-        if (next_pc.num_dngn_overlay != current_pc.num_dngn_overlay)
-            overlays_changed = true;
-        else
-        {
-            for (int i = 0; i < next_pc.num_dngn_overlay; i++)
+            if (m_origin.equals(-1, -1))
+                m_origin = gc;
+
+            const screen_cell_t& sc = force_full ? default_cell
+                : m_current_view(gc);
+            const map_cell& mc = force_full ? default_map_cell
+                : m_current_map_knowledge(gc);
+            _pack_cell(rec, gc, sc, m_next_view(gc), mc, env.map_knowledge(gc),
+                       new_monster_locs, force_full);
+            if (rec.empty())
+                continue;
+
+            const int index = y * GXM + x;
+            if (run_len && index == run_start + run_len && rec == run)
+                run_len++;
+            else
             {
-                if (next_pc.dngn_overlay[i] != current_pc.dngn_overlay[i])
-                {
-                    overlays_changed = true;
-                    break;
-                }
+                flush_run();
+                run.swap(rec);
+                run_start = index;
+                run_len = 1;
             }
         }
+    flush_run();
 
-        if (overlays_changed)
-        {
-            json_open_array("ov");
-            for (int i = 0; i < next_pc.num_dngn_overlay; ++i)
-                json_write_int(next_pc.dngn_overlay[i]);
-            json_close_array();
-        }
-    }
-    json_close_object(true);
+    if (!flags && cells.empty())
+        return;
+
+    string frame(1, '\0');
+    frame.push_back(MAP_FRAME_VERSION);
+    _pack_varint(frame, flags);
+    frame.append(vgrdc);
+    _pack_coord(frame, m_origin.x);
+    _pack_coord(frame, m_origin.y);
+    _pack_varint(frame, GXM);
+    frame.append(cells);
+
+    _finish_binary_message(frame);
 }
 
 void TilesFramework::_send_cursor(cursor_type type)
@@ -1838,6 +2501,38 @@ void TilesFramework::_send_map(bool spectator_only)
     bool force_full = spectator_only || m_need_full_map;
     m_need_full_map = false;
 
+    if (_binary_maps())
+        _send_binary_map(spectator_only, force_full, new_monster_locs);
+    else
+        _send_json_map(spectator_only, force_full, new_monster_locs);
+
+    if (force_full)
+        _send_cursor(CURSOR_MAP);
+
+    // Everything should already be up to date when called with spectator_only
+    if (spectator_only)
+        return;
+
+    if (m_mcache_ref_done)
+        _mcache_ref(false);
+
+    m_current_map_knowledge = env.map_knowledge;
+    m_current_view = m_next_view;
+
+    _mcache_ref(true);
+    m_mcache_ref_done = true;
+
+    m_monster_locs = new_monster_locs;
+}
+
+void TilesFramework::_send_json_map(bool spectator_only, bool force_full,
+                                    map<uint32_t, coord_def>& new_monster_locs)
+{
+    // A full map gets a shared frame of its own, so that the server can tell
+    // who it is for without decompressing it.
+    if (force_full)
+        _flush_frame_batch();
+
     json_open_object();
     json_write_string("msg", "map");
     json_treat_as_empty();
@@ -1939,24 +2634,11 @@ void TilesFramework::_send_map(bool spectator_only)
     json_close_object(true);
 
     finish_message();
-
     if (force_full)
-        _send_cursor(CURSOR_MAP);
-
-    // Everything should already be up to date when called with spectator_only
-    if (spectator_only)
-        return;
-
-    if (m_mcache_ref_done)
-        _mcache_ref(false);
-
-    m_current_map_knowledge = env.map_knowledge;
-    m_current_view = m_next_view;
-
-    _mcache_ref(true);
-    m_mcache_ref_done = true;
-
-    m_monster_locs = new_monster_locs;
+    {
+        _flush_frame_batch(MAP_FRAME_CLEAR
+                           | (spectator_only ? MAP_FRAME_SPECT_ONLY : 0));
+    }
 }
 
 void TilesFramework::_send_monster(const coord_def &gc, const monster_info* m,
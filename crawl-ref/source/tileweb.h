@@ -27,6 +27,7 @@ using std::vector;
 
 class xlog_fields;
 class Menu;
+struct z_stream_s;
 
 enum WebtilesUIState
 {
@@ -232,6 +233,20 @@ protected:
     int m_max_msg_size;
     string m_msg_buf;
     vector<sockaddr_un> m_dest_addrs;
+    // Whether each destination accepts binary map frames.
+    vector<bool> m_dest_binary;
+    bool _binary_maps() const;
+    void _finish_binary_message(const string &frame);
+
+    // Whether each destination takes shared, pre-compressed frames.
+    vector<bool> m_dest_shared;
+    // Messages waiting to go out as a single shared frame.
+    string m_frame_batch;
+    z_stream_s *m_frame_zs;
+    bool _shared_frames() const;
+    void _send_frame_dictionary();
+    void _send_shared_frame(const string &payload, int flags);
+    void _flush_frame_batch(int flags = 0);
 
     bool m_controlled_from_web;
     bool m_need_flush;
@@ -324,11 +339,22 @@ protected:
 
     void _send_cursor(cursor_type type);
     void _send_map(bool spectator_only = false);
+    void _send_json_map(bool spectator_only, bool force_full,
+                        map<uint32_t, coord_def>& new_monster_locs);
+    void _send_binary_map(bool spectator_only, bool force_full,
+                          map<uint32_t, coord_def>& new_monster_locs);
     void _send_cell(const coord_def &gc,
                     const screen_cell_t &current_sc, const screen_cell_t &next_sc,
                     const map_cell &current_mc, const map_cell &next_mc,
                     map<uint32_t, coord_def>& new_monster_locs,
                     bool force_full);
+    void _pack_cell(string &rec, const coord_def &gc,
+                    const screen_cell_t &current_sc, const screen_cell_t &next_sc,
+                    const map_cell &current_mc, const map_cell &next_mc,
+                    map<uint32_t, coord_def>& new_monster_locs,
+                    bool force_full);
+    void _send_parchment_schools(const packed_cell &pc);
+    void _send_doll_fields(const packed_cell &pc, bool fg_changed);
     void _send_monster(const coord_def &gc, const monster_info* m,
                        map<uint32_t, coord_def>& new_monster_locs,
                        bool force_full);
@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <cctype>
 #include <cstdarg>
 #include <cstdio>
@@ -577,6 +578,7 @@ static bool _is_safe_move(const coord_def& c)
 
 void travel_init_load_level()
 {
+    invalidate_travel_distances();
     curr_excludes.clear();
     travel_cache.set_level_excludes();
     travel_cache.update_waypoints();
@@ -1290,7 +1292,8 @@ static void _fill_exclude_radius(const travel_exclude &exc)
 /////////////////////////////////////////////////////////////////////////////
 // travel_pathfind
 
-FixedVector<coord_def, GXM * GYM> travel_pathfind::circumference[2];
+FixedVector<coord_def, GXM * GYM>
+    travel_pathfind::circumference[travel_pathfind::NUM_BUCKETS];
 
 // already defined in header
 // const int travel_pathfind::UNFOUND_DIST;
@@ -1303,8 +1306,8 @@ travel_pathfind::travel_pathfind()
       need_for_greed(false), autopickup(false),
       unexplored_place(), greedy_place(), unexplored_dist(0), greedy_dist(0),
       refdist(nullptr), reseed_points(), features(nullptr), unreachables(),
-      point_distance(travel_point_distance), next_iter_points(0),
-      traveled_distance(0), circ_index(0)
+      point_distance(travel_point_distance), bucket_points(),
+      queued_points(0), traveled_distance(0)
 {
 }
 
@@ -1448,44 +1451,40 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
                                  !actor_slime_wall_immune(&you));
     unwind_slime_wall_precomputer slime_neighbours(g_Slime_Wall_Check);
 
-    // How many points we'll consider next iteration.
-    next_iter_points = 0;
+    for (int &points : bucket_points)
+        points = 0;
+    queued_points = 0;
 
     // How far we've travelled from (start_x, start_y), in moves (a diagonal move
     // is no longer than an orthogonal move).
-    traveled_distance = 1;
-
-    // Which index of the circumference array are we currently looking at?
-    circ_index = 0;
+    traveled_distance = 0;
 
     ignore_hostile = false;
 
-    // For each round, circumference will store all points that were discovered
-    // in the previous round of a given distance. Because we check all grids of
-    // a certain distance from the starting point in one round, and move
-    // outwards in concentric circles, this is an implementation of Dijkstra.
-    // We use an array of size 2, so we can comfortably switch between the list
-    // of points to be investigated this round and the slowly growing list of
-    // points to be inspected next round. Once we've finished with the current
-    // round, i.e. there are no more points to be looked at in the current
-    // array, we switch circ_index over to !circ_index (between 0 and 1), so
-    // the "next round" becomes the current one, and the old points can be
-    // overwritten with newer ones. Since we count the number of points for
-    // next round in next_iter_points, we don't even need to reset the array.
-    circumference[circ_index][0] = start;
+    // This is Dijkstra's algorithm with a bucket queue. Each round examines
+    // the points from which a neighbour is traveled_distance moves away;
+    // since entering a square costs at most NUM_BUCKETS - 1 moves, a ring of
+    // NUM_BUCKETS buckets holds every round that can have points queued.
+    // Points in a slow square (see _feature_traverse_cost) go straight into
+    // a later bucket rather than being looked at again every round.
+    queue_point(start);
 
     bool found_target = false;
 
-    for (int points = 1; points > 0; ++traveled_distance,
-        circ_index = !circ_index, points = next_iter_points,
-        next_iter_points = 0)
+    for (traveled_distance = 1; queued_points > 0; ++traveled_distance)
     {
+        // Nothing is queued into this bucket while we work through it.
+        const int bucket = traveled_distance % NUM_BUCKETS;
+        const int points = bucket_points[bucket];
+        bucket_points[bucket] = 0;
+        queued_points -= points;
+
         for (int i = 0; i < points; ++i)
         {
             // Look at all neighbours of the current grid.
             // path_examine_point() returns true if the target is reached
             // and marked as such.
-            if (path_examine_point(circumference[circ_index][i]))
+            if (path_examine_point(circumference[bucket][i]))
             {
                 if (runmode == RMODE_TRAVEL)
                     return next_travel_move;
@@ -1500,12 +1499,12 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
         }
 
         // Handle exploration with wall bias
-        if (next_iter_points == 0 && found_target)
+        if (queued_points == 0 && found_target)
             return explore_target();
 
         // If there are no more points to look at, we're done, but we did
         // not find a path to our target.
-        if (next_iter_points == 0)
+        if (queued_points == 0)
         {
             // Don't reseed unless we've found no target for explore, OR
             // we're doing map annotation or feature tracking.
@@ -1526,10 +1525,9 @@ coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
                 && !reseed_points.empty())
             {
                 // Reseed here
-                for (unsigned i = 0, size = reseed_points.size(); i < size; ++i)
-                    circumference[!circ_index][i] = reseed_points[i];
+                for (const coord_def &p : reseed_points)
+                    queue_point(p);
 
-                next_iter_points  = reseed_points.size();
                 ignore_hostile    = true;
             }
         }
@@ -1593,28 +1591,32 @@ void travel_pathfind::get_features()
     }
 }
 
-bool travel_pathfind::square_slows_movement(const coord_def &c)
+// Queue c, whose point_distance must already be set, to have its neighbours
+// looked at.
+void travel_pathfind::queue_point(const coord_def &c)
 {
-    // c is a known (explored) location - we never put unknown points in the
-    // circumference vector, so we don't need to examine the map array, just the
-    // grid array.
+    int when = traveled_distance + 1;
+
+    // c is a known (explored) location - we never queue unknown points, so
+    // we don't need to examine the map array, just the grid array.
     const dungeon_feature_type feature = env.map_knowledge(c).feat();
 
     // If this is a feature that'll take time to travel past, we simulate that
-    // extra turn by taking this feature next turn, thereby artificially
-    // increasing traveled_distance.
+    // extra time by looking at its neighbours only once traveled_distance
+    // has caught up.
     //
     // Walking through shallow water and opening closed doors is considered to
-    // have the cost of two normal moves for travel purposes.
+    // have the cost of two normal moves for travel purposes. Squares reached
+    // while ignoring hostile terrain have negative distances, and so are never
+    // slowed.
     const int feat_cost = _feature_traverse_cost(feature);
-    if (feat_cost > 1
-        && point_distance[c.x][c.y] > traveled_distance - feat_cost)
-    {
-        circumference[!circ_index][next_iter_points++] = c;
-        return true;
-    }
+    if (feat_cost > 1)
+        when = max(when, point_distance[c.x][c.y] + feat_cost);
+    ASSERT(when - traveled_distance < NUM_BUCKETS);
 
-    return false;
+    const int bucket = when % NUM_BUCKETS;
+    circumference[bucket][bucket_points[bucket]++] = c;
+    ++queued_points;
 }
 
 void travel_pathfind::check_square_greed(const coord_def &c)
@@ -1809,9 +1811,6 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
 
     if (!point_distance[dc.x][dc.y])
     {
-        // This point is going to be on the agenda for the next
-        // iteration
-        circumference[!circ_index][next_iter_points++] = dc;
         point_distance[dc.x][dc.y] = traveled_distance;
 
         // Negative distances here so that show_map can colour
@@ -1825,6 +1824,9 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
                 point_distance[dc.x][dc.y] = PD_EXCLUDED_RADIUS;
         }
 
+        // This point is going to be on the agenda for a later iteration.
+        queue_point(dc);
+
         if (features && !ignore_hostile)
         {
             dungeon_feature_type feature = env.map_knowledge(dc).feat();
@@ -1857,25 +1859,12 @@ void travel_pathfind::good_square(const coord_def &c)
 {
     if (!point_distance[c.x][c.y])
     {
-        // This point is going to be on the agenda for the next iteration.
-        circumference[!circ_index][next_iter_points++] = c;
+        // This point is going to be on the agenda for a later iteration.
         point_distance[c.x][c.y] = traveled_distance;
+        queue_point(c);
     }
 }
 
-bool travel_pathfind::point_traverse_delay(const coord_def &c)
-{
-    if (square_slows_movement(c))
-        return true;
-
-    // Greedy explore check should happen on (x,y), not (dx,dy) as for
-    // regular explore.
-    if (need_for_greed)
-        check_square_greed(c);
-
-    return false;
-}
-
 // Checks all neighbours of c, adds them to next round's list of points
 // - happens in path_flood() - and returns true if one of them turns out
 // to be the target; otherwise, false.
@@ -1885,8 +1874,10 @@ bool travel_pathfind::path_examine_point(const coord_def &c)
     if (!in_bounds(c))
         return false;
 
-    if (point_traverse_delay(c))
-        return false;
+    // Greedy explore check should happen on (x,y), not (dx,dy) as for
+    // regular explore.
+    if (need_for_greed)
+        check_square_greed(c);
 
     bool found_target = false;
 
@@ -1947,6 +1938,98 @@ int travel_pathfind::explore_status()
 }
 
 
+// The player properties and options (beyond map knowledge) that travel
+// distances depend on.
+struct travel_traversal_key
+{
+    int flags;
+    FixedVector<int8_t, NUM_FEATURES> avoid_terrain;
+    // Whether each cloud type is safe, when not ours and when ours.
+    bitset<NUM_CLOUD_TYPES * 2> safe_clouds;
+    bitset<NUM_TRAPS> safe_traps;
+
+    bool operator==(const travel_traversal_key &other) const
+    {
+        return flags == other.flags
+               && equal(avoid_terrain.begin(), avoid_terrain.end(),
+                        other.avoid_terrain.begin())
+               && safe_clouds == other.safe_clouds
+               && safe_traps == other.safe_traps;
+    }
+};
+
+// Distance maps filled by fill_travel_point_distance(), kept for reuse. A map
+// of the level the player is on is only good for the turn it was made in,
+// since map knowledge changes as the player looks around; a map made during a
+// level excursion lasts until its level is loaded for real.
+struct travel_distance_map
+{
+    level_id place;
+    coord_def seed;
+    bool on_current_level;
+    int turn;
+    travel_traversal_key traversal;
+    travel_distance_grid_t distance;
+};
+
+static vector<unique_ptr<travel_distance_map>> travel_distance_maps;
+static size_t next_replaced_distance_map = 0;
+static const size_t MAX_TRAVEL_DISTANCE_MAPS = 32;
+
+static travel_traversal_key _travel_traversal_key()
+{
+    travel_traversal_key key;
+    key.flags = (you.permanent_flight() ? 1 : 0)
+                | (player_likes_water(true) ? 2 : 0)
+                | (have_passive(passive_t::water_walk) ? 4 : 0)
+                | (you.is_web_immune() ? 8 : 0)
+                | (you.is_binding_sigil_immune() ? 16 : 0)
+                | (actor_slime_wall_immune(&you) ? 32 : 0)
+                | (you.duration[DUR_NOXIOUS_BOG] ? 64 : 0);
+    key.avoid_terrain = Options.travel_avoid_terrain;
+
+    for (int i = CLOUD_NONE + 1; i < NUM_CLOUD_TYPES; ++i)
+    {
+        const cloud_type ctype = static_cast<cloud_type>(i);
+        key.safe_clouds[2 * i] = !is_damaging_cloud(ctype, true, false);
+        key.safe_clouds[2 * i + 1] = !is_damaging_cloud(ctype, true, true);
+    }
+
+    // As is_travelsafe_square() checks known traps.
+    for (int i = 0; i < NUM_TRAPS; ++i)
+    {
+        trap_def trap;
+        trap.type = static_cast<trap_type>(i);
+        trap.ammo_qty = 1;
+        key.safe_traps[i] = trap.is_safe();
+    }
+
+    return key;
+}
+
+static bool _travel_distances_current(const travel_distance_map &map,
+                                      const coord_def &seed,
+                                      const travel_traversal_key &key)
+{
+    return map.seed == seed
+           && map.place == level_id::current()
+           && map.on_current_level == you.on_current_level
+           && (!you.on_current_level || map.turn == you.elapsed_time)
+           && map.traversal == key;
+}
+
+/**
+ * Forget the travel distance maps for the current level, whose terrain or
+ * exclusions have changed or which is being loaded.
+ */
+void invalidate_travel_distances()
+{
+    const level_id here = level_id::current();
+    for (auto &map : travel_distance_maps)
+        if (map->place == here)
+            map->place = level_id();
+}
+
 /**
  * Run the travel_pathfind algorithm, from the given position in floodout mode
  * to populate travel_point_distance relative to that starting point.
@@ -1957,6 +2040,23 @@ int travel_pathfind::explore_status()
 void fill_travel_point_distance(const coord_def& youpos,
                                 vector<coord_def>* features)
 {
+    // Only plain distance maps are kept; the feature list depends on
+    // the stash tracker too.
+    const travel_traversal_key key = features ? travel_traversal_key()
+                                              : _travel_traversal_key();
+    if (!features)
+    {
+        for (auto &map : travel_distance_maps)
+        {
+            if (_travel_distances_current(*map, youpos, key))
+            {
+                memcpy(travel_point_distance, map->distance,
+                       sizeof(travel_distance_grid_t));
+                return;
+            }
+        }
+    }
+
     travel_pathfind tp;
     tp.set_floodseed(youpos);
     tp.set_feature_vector(features);
@@ -1966,6 +2066,30 @@ void fill_travel_point_distance(const coord_def& youpos,
     if (features)
         tp.pathfind(RMODE_NOT_RUNNING, false);
     tp.pathfind(RMODE_NOT_RUNNING, true);
+
+    if (features)
+        return;
+
+    travel_distance_map *map;
+    if (travel_distance_maps.size() < MAX_TRAVEL_DISTANCE_MAPS)
+    {
+        travel_distance_maps.emplace_back(new travel_distance_map);
+        map = travel_distance_maps.back().get();
+    }
+    else
+    {
+        map = travel_distance_maps[next_replaced_distance_map].get();
+        next_replaced_distance_map = (next_replaced_distance_map + 1)
+                                     % MAX_TRAVEL_DISTANCE_MAPS;
+    }
+
+    map->place = level_id::current();
+    map->seed = youpos;
+    map->on_current_level = you.on_current_level;
+    map->turn = you.elapsed_time;
+    map->traversal = key;
+    memcpy(map->distance, travel_point_distance,
+           sizeof(travel_distance_grid_t));
 }
 
 extern map<branch_type, set<level_id> > stair_level;
@@ -4508,6 +4632,7 @@ void TravelCache::set_level_excludes()
 
 void TravelCache::update_excludes()
 {
+    invalidate_travel_distances();
     get_level_info(level_id::current()).update_excludes();
 }
 
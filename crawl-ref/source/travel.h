@@ -78,6 +78,7 @@ bool is_unknown_transporter(const coord_def &p);
 
 void fill_travel_point_distance(const coord_def& youpos,
                      vector<coord_def>* coords = nullptr);
+void invalidate_travel_distances();
 
 bool is_stair_exclusion(const coord_def &p);
 
@@ -491,9 +492,8 @@ public:
 protected:
     bool is_greed_inducing_square(const coord_def &c) const;
     bool path_examine_point(const coord_def &c);
-    virtual bool point_traverse_delay(const coord_def &c);
     virtual bool path_flood(const coord_def &c, const coord_def &dc);
-    bool square_slows_movement(const coord_def &c);
+    void queue_point(const coord_def &c);
     void check_square_greed(const coord_def &c);
     void good_square(const coord_def &c);
 
@@ -501,6 +501,9 @@ protected:
     static const int UNFOUND_DIST  = -30000;
     static const int INFINITE_DIST =  INFINITE_DISTANCE;
 
+    // One more than the highest cost of entering a square.
+    static const int NUM_BUCKETS = 4;
+
 protected:
     run_mode_type runmode;
 
@@ -557,19 +560,19 @@ protected:
 
     travel_distance_col *point_distance;
 
-    // How many points we'll consider next iteration.
-    int next_iter_points;
+    // How many points are waiting in each bucket, and in all of them.
+    int bucket_points[NUM_BUCKETS];
+    int queued_points;
 
     // How far we've travelled from (start_x, start_y), in moves (a diagonal move
     // is no longer than an orthogonal move).
     int traveled_distance;
 
-    // Which index of the circumference array are we currently looking at?
-    int circ_index;
-
-    // Used by all instances of travel_pathfind. Happily, we do not need to be
-    // re-entrant or thread-safe.
-    static FixedVector<coord_def, GXM * GYM> circumference[2];
+    // Points to examine, bucketed by the traveled_distance at which to
+    // examine them (modulo NUM_BUCKETS). Used by all instances of
+    // travel_pathfind. Happily, we do not need to be re-entrant or
+    // thread-safe.
+    static FixedVector<coord_def, GXM * GYM> circumference[NUM_BUCKETS];
 
     // Attempt to path through temporary obstructions (like sealed doors)
     // due to the possibility they are no longer obstructing us
@@ -1407,6 +1407,30 @@ static bool _viewwindow_should_render()
     return !run_dont_draw;
 }
 
+#if defined(DEBUG_CONSOLE_OUTPUT) && defined(UNIX) && !defined(USE_TILE_LOCAL)
+// Log what puttext() handed to curses over each turn, once the turn is
+// over. Curses still decides what goes to the terminal; see
+// console_output_totals().
+static void _log_console_output()
+{
+    static int turn = -1;
+    static console_output_stats at_turn_start;
+    if (you.num_turns == turn)
+        return;
+
+    const console_output_stats &now = console_output_totals();
+    if (turn >= 0)
+    {
+        fprintf(stderr, "console: turn %d: %d cells in %d runs, %d bytes.\n",
+                turn, now.cells - at_turn_start.cells,
+                now.runs - at_turn_start.runs,
+                now.bytes - at_turn_start.bytes);
+    }
+    at_turn_start = now;
+    turn = you.num_turns;
+}
+#endif
+
 /**
  * Draws the main window using the character set returned
  * by get_show_glyph().
@@ -1493,6 +1517,9 @@ void viewwindow(bool show_updates, bool tiles_only, animation *a, view_renderer
 #ifndef USE_TILE_LOCAL
             if (!tiles_only)
             {
+#if defined(DEBUG_CONSOLE_OUTPUT) && defined(UNIX)
+                _log_console_output();
+#endif
                 puttext(crawl_view.viewp.x, crawl_view.viewp.y, vbuf);
                 update_monster_pane();
             }
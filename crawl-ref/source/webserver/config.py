@@ -277,6 +277,15 @@ init_player_program = "./util/webtiles-init-player.sh"
 
 # use_gzip = True
 
+# Send map updates to browsers as binary websocket frames when the game and
+# every connected client support them, instead of as JSON.
+# binary_map_frames = True
+
+# Have the game compress its output once, and send the same compressed frames
+# to every browser that supports them, rather than compressing separately for
+# each player and spectator.
+# shared_frames = True
+
 # Seconds until stale HTTP connections are closed
 # This corresponds to the tornado parameter `idle_connection_timeout`, which
 # will automatically close idle http connections that do not respond after a
@@ -107,8 +107,224 @@ function ($, comm, map_knowledge, view_data, monster_list, minimap,
     {
     }
 
+    // Binary map frames; the format is described above _pack_cell() in
+    // tileweb.cc, and must be kept in sync with it.
+    var MAP_FRAME_VERSION = 1;
+
+    var MAP_FRAME_CLEAR = 1 << 0,
+        MAP_FRAME_SPECT_ONLY = 1 << 1,
+        MAP_FRAME_ON_LEVEL = 1 << 2,
+        MAP_FRAME_ON_LEVEL_VALUE = 1 << 3,
+        MAP_FRAME_VGRDC = 1 << 4;
+
+    var MCF_FEAT = 1 << 0,
+        MCF_MAP_FEATURE = 1 << 1,
+        MCF_GLYPH = 1 << 2,
+        MCF_COLOUR = 1 << 3,
+        MCF_FLASH_COLOUR = 1 << 4,
+        MCF_FLASH_ALPHA = 1 << 5,
+        MCF_NO_MONSTER = 1 << 6,
+        MCF_FG = 1 << 7,
+        MCF_BASE = 1 << 8,
+        MCF_BG = 1 << 9,
+        MCF_CLOUD = 1 << 10,
+        MCF_ICONS = 1 << 11,
+        MCF_FLAGS = 1 << 12,
+        MCF_HALO = 1 << 13,
+        MCF_ORB_GLOW = 1 << 14,
+        MCF_BLOOD_ROTATION = 1 << 15,
+        MCF_TRAVEL_TRAIL = 1 << 16,
+        MCF_FLAVOUR = 1 << 17,
+        MCF_OVERLAYS = 1 << 18,
+        MCF_NO_DOLL = 1 << 19,
+        MCF_JSON = 1 << 20;
+
+    // Indexed by map_cell_bool
+    var cell_flags = ["bloody", "old_blood", "silenced",
+                      "highlighted_summoner", "sanctuary", "blasphemy",
+                      "has_bfb_corpse", "liquefied", "quad_glow", "disjunct",
+                      "mangrove_water", "awakened_forest"];
+
+    var utf8_decoder = null;
+
+    // Turns a binary map frame into the equivalent JSON map message.
+    function decode_binary_map(data)
+    {
+        var pos = 2, hi = 0;
+
+        // Returns the low 32 bits of a varint, leaving the rest in hi.
+        function varint()
+        {
+            var lo = 0, shift = 0, b;
+            hi = 0;
+            do
+            {
+                b = data[pos++];
+                var bits = b & 0x7f;
+                if (shift < 32)
+                {
+                    lo |= bits << shift;
+                    if (shift > 25)
+                        hi |= bits >>> (32 - shift);
+                }
+                else
+                    hi |= bits << (shift - 32);
+                shift += 7;
+            } while (b & 0x80);
+            return lo;
+        }
+
+        function int()
+        {
+            return varint() | 0;
+        }
+
+        function coord()
+        {
+            var u = varint();
+            return (u >>> 1) ^ -(u & 1);
+        }
+
+        // Same representation as TilesFramework::write_tileidx
+        function tileidx()
+        {
+            var lo = varint() | 0;
+            return hi ? [lo, hi | 0] : lo;
+        }
+
+        function cell()
+        {
+            var mask = varint(), c = {}, t = {}, i, n;
+
+            if (mask & MCF_FEAT)
+                c.f = int();
+            if (mask & MCF_MAP_FEATURE)
+                c.mf = int();
+            if (mask & MCF_GLYPH)
+            {
+                var glyph = varint() >>> 0;
+                c.g = glyph ? String.fromCodePoint(glyph) : "";
+            }
+            if (mask & MCF_COLOUR)
+                c.col = int();
+            if (mask & MCF_FLASH_COLOUR)
+                c.flc = int();
+            if (mask & MCF_FLASH_ALPHA)
+                c.fla = int();
+            if (mask & MCF_NO_MONSTER)
+                c.mon = null;
+            if (mask & MCF_FG)
+                t.fg = tileidx();
+            if (mask & MCF_BASE)
+                t.base = int();
+            if (mask & MCF_BG)
+                t.bg = tileidx();
+            if (mask & MCF_CLOUD)
+                t.cloud = tileidx();
+            if (mask & MCF_ICONS)
+            {
+                t.icons = [];
+                for (n = varint(), i = 0; i < n; i++)
+                    t.icons.push(tileidx());
+            }
+            if (mask & MCF_FLAGS)
+            {
+                var changed = varint(), values = varint();
+                for (i = 0; i < cell_flags.length; i++)
+                    if (changed & (1 << i))
+                        t[cell_flags[i]] = !!(values & (1 << i));
+            }
+            if (mask & MCF_HALO)
+                t.halo = int();
+            if (mask & MCF_ORB_GLOW)
+                t.orb_glow = int();
+            if (mask & MCF_BLOOD_ROTATION)
+                t.blood_rotation = int();
+            if (mask & MCF_TRAVEL_TRAIL)
+                t.travel_trail = int();
+            if (mask & MCF_FLAVOUR)
+            {
+                t.flv = { f: int() };
+                var special = int();
+                if (special)
+                    t.flv.s = special;
+            }
+            if (mask & MCF_OVERLAYS)
+            {
+                t.ov = [];
+                for (n = varint(), i = 0; i < n; i++)
+                    t.ov.push(int());
+            }
+            if (mask & MCF_NO_DOLL)
+            {
+                t.doll = null;
+                t.mcache = null;
+            }
+            if (mask & MCF_JSON)
+            {
+                n = varint();
+                var extra = JSON.parse(utf8_decoder.decode(
+                                            data.subarray(pos, pos + n)));
+                pos += n;
+                if ("mon" in extra)
+                    c.mon = extra.mon;
+                if (extra.t)
+                    $.extend(t, extra.t);
+            }
+
+            if (!$.isEmptyObject(t))
+                c.t = t;
+            return c;
+        }
+
+        if (data[0] !== 0 || data[1] !== MAP_FRAME_VERSION)
+            throw new Error("Unknown binary frame version " + data[1]);
+        if (!utf8_decoder)
+            utf8_decoder = new TextDecoder("utf-8");
+
+        var msg = { msg: "map" };
+        var flags = varint();
+        if (flags & MAP_FRAME_CLEAR)
+            msg.clear = true;
+        if (flags & MAP_FRAME_SPECT_ONLY)
+            msg.spect_only = true;
+        if (flags & MAP_FRAME_ON_LEVEL)
+            msg.player_on_level = !!(flags & MAP_FRAME_ON_LEVEL_VALUE);
+        if (flags & MAP_FRAME_VGRDC)
+            msg.vgrdc = { x: coord(), y: coord() };
+
+        var ox = coord(), oy = coord(), width = varint();
+        var cells = [], index = 0;
+        while (pos < data.length)
+        {
+            var head = varint();
+            index += head >>> 1;
+            var count = (head & 1) ? varint() : 1;
+            var start = pos;
+            // A repeated record is decoded afresh for each cell, since
+            // map_knowledge keeps the objects it is given.
+            for (var i = 0; i < count; i++, index++)
+            {
+                pos = start;
+                var c = cell();
+                c.x = index % width - ox;
+                c.y = Math.floor(index / width) - oy;
+                cells.push(c);
+            }
+        }
+        if (cells.length)
+            msg.cells = cells;
+        return msg;
+    }
+
+    function handle_binary_message(data)
+    {
+        handle_map_message(decode_binary_map(data.data));
+    }
+
     comm.register_handlers({
         "map": handle_map_message,
+        "binary": handle_binary_message,
     });
 
     return {
@@ -89,6 +89,16 @@ function (exports, $, key_conversion, chat, comm) {
         handle_message_backlog();
     }
 
+    // Binary frames (map updates, see display.js in the game client) are
+    // queued in order with the JSON messages.
+    function enqueue_binary(data)
+    {
+        if (window.log_message_size)
+            console.log("Binary message size: " + data.length);
+        message_queue.push({ msg: "binary", data: data });
+        handle_message_backlog();
+    }
+
     function handle_message_backlog()
     {
         while (message_queue.length
@@ -1562,9 +1572,22 @@ function (exports, $, key_conversion, chat, comm) {
     window.assert = function () {};
     window.abs = function (x) { if (x < 0) return -x; else return x; }
 
+    // Frames the game compressed once for all watchers start from this
+    // dictionary (see _send_shared_frame in tileweb.cc).
+    var frame_dictionary = null;
+    function set_frame_dictionary(data)
+    {
+        var s = data.dictionary;
+        frame_dictionary = new Uint8Array(s.length);
+        for (var i = 0; i < s.length; i++)
+            frame_dictionary[i] = s.charCodeAt(i);
+        return true;
+    }
+
     comm.register_immediate_handlers({
         "ping": pong,
         "close": connection_closed,
+        "frame_dictionary": set_frame_dictionary,
     });
 
     comm.register_handlers({
@@ -1700,7 +1723,11 @@ function (exports, $, key_conversion, chat, comm) {
         if ("WebSocket" in window)
         {
             // socket_server is set in the client.html template
-            if (inflater)
+            // Shared frames need to be decoded in order with the rest,
+            // so only ask for them along with synchronous text decoding.
+            if (inflater && text_decoder)
+                socket = new WebSocket(socket_server, "shared-frames");
+            else if (inflater)
                 socket = new WebSocket(socket_server);
             else
                 socket = new WebSocket(socket_server, "no-compression");
@@ -1710,35 +1737,78 @@ function (exports, $, key_conversion, chat, comm) {
             {
                 window.onhashchange = hash_changed;
 
+                // Binary frames are decoded synchronously, so only ask for
+                // them when text messages are too; otherwise the two could
+                // be handled out of order.
+                if (text_decoder)
+                    send_message("set_binary_maps");
+
                 start_login();
 
                 current_hash = null;
                 hash_changed();
             };
 
+            function inflate_frame(inf, bytes)
+            {
+                var data = new Uint8Array(bytes.length + 4);
+                data.set(bytes, 0);
+                data.set([0, 0, 255, 255], bytes.length);
+                var decompressed = inf.append(data);
+                if (decompressed === -1)
+                {
+                    console.error("Decompression error!");
+                    var x = inf.append(data);
+                }
+                // JSON batches start with '{', binary frames with 0
+                if (decompressed && decompressed[0] === 0)
+                {
+                    enqueue_binary(decompressed);
+                    return;
+                }
+                decode_utf8(decompressed, function (s) {
+                    if (window.log_messages === 2)
+                        console.log("Message: " + s);
+                    if (window.log_message_size)
+                    {
+                        console.log("Message size: " + s.length
+                            + " (compressed " + bytes.length + ")");
+                    }
+                    enqueue_messages(s);
+                });
+            }
+
             socket.onmessage = function (msg)
             {
-                if (inflater && msg.data instanceof ArrayBuffer)
+                if (inflater && msg.data instanceof ArrayBuffer
+                    && socket.protocol === "shared-frames")
                 {
-                    var data = new Uint8Array(msg.data.byteLength + 4);
-                    data.set(new Uint8Array(msg.data), 0);
-                    data.set([0, 0, 255, 255], msg.data.byteLength);
-                    var decompressed = inflater.append(data);
-                    if (decompressed === -1)
+                    // The first byte says how the rest was compressed: 1 for
+                    // this socket's own stream, 2 for a frame of its own
+                    // shared with the other watchers; 0 is an uncompressed
+                    // binary map frame.
+                    var bytes = new Uint8Array(msg.data);
+                    if (bytes[0] === 1)
+                        inflate_frame(inflater, bytes.subarray(1));
+                    else if (bytes[0] === 2)
                     {
-                        console.error("Decompression error!");
-                        var x = inflater.append(data);
+                        inflate_frame(new Inflater(frame_dictionary),
+                                      bytes.subarray(2));
                     }
-                    decode_utf8(decompressed, function (s) {
-                        if (window.log_messages === 2)
-                            console.log("Message: " + s);
-                        if (window.log_message_size)
-                        {
-                            console.log("Message size: " + s.length
-                                + " (compressed " + msg.data.byteLength + ")");
-                        }
-                        enqueue_messages(s);
-                    });
+                    else
+                        enqueue_binary(bytes);
+                    return;
+                }
+
+                if (inflater && msg.data instanceof ArrayBuffer)
+                {
+                    inflate_frame(inflater, new Uint8Array(msg.data));
+                    return;
+                }
+
+                if (msg.data instanceof ArrayBuffer)
+                {
+                    enqueue_binary(new Uint8Array(msg.data));
                     return;
                 }
 
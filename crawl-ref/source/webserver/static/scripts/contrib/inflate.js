@@ -2083,7 +2083,9 @@
 
         // Inflater
 
-        function Inflater() {
+        // dictionary, if given, is a Uint8Array preset as the start of the
+        // window, as with deflateSetDictionary() on a raw deflate stream.
+        function Inflater(dictionary) {
                 var that = this;
                 var z = new ZStream();
                 var bufsize = 512;
@@ -2092,6 +2094,8 @@
                 var nomoreinput = false;
 
                 z.inflateInit();
+                if (dictionary)
+                        z.istate.blocks.set_dictionary(dictionary, 0, dictionary.length);
                 z.next_out = buf;
 
                 that.append = function(data, onprogress) {
@@ -75,6 +75,8 @@ defaults = {
     'max_idle_time': 5 * 60 * 60,
     'max_lobby_idle_time': 3 * 60 * 60,
     'use_gzip': True,
+    'binary_map_frames': True,
+    'shared_frames': True,
     'kill_timeout': 10,
     'nick_regex': r"^[a-zA-Z0-9]{3,20}$",
     'max_passwd_length': 20,
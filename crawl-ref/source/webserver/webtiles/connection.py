@@ -29,10 +29,13 @@ class WebtilesSocketConnection(object):
 
         self.msg_buffer = None
 
-    def connect(self, primary = True):
+    def connect(self, primary = True, binary_maps = False,
+                shared_frames = False):
         if not os.path.exists(self.crawl_socketpath):
             # Wait until the socket exists
-            IOLoop.current().add_timeout(time.time() + 1, self.connect)
+            IOLoop.current().add_timeout(time.time() + 1,
+                                lambda: self.connect(primary, binary_maps,
+                                                     shared_frames))
             return
 
         self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
@@ -72,7 +75,9 @@ class WebtilesSocketConnection(object):
 
         msg = json_encode({
                 "msg": "attach",
-                "primary": primary
+                "primary": primary,
+                "binary_maps": binary_maps,
+                "shared_frames": shared_frames
                 })
 
         self.open = True
@@ -1,3 +1,4 @@
+import base64
 import datetime
 import errno
 import fcntl
@@ -8,6 +9,7 @@ import os.path
 import re
 import signal
 import time
+import zlib
 
 from tornado.escape import json_decode
 from tornado.escape import json_encode
@@ -212,6 +214,64 @@ class CrawlProcessHandlerBase(object):
         for receiver in self._receivers:
             receiver.append_message(msg, send)
 
+    def handle_process_binary(self, msg): # type: (str) -> None
+        # a binary map frame, base64-encoded behind a '#' on the game socket.
+        # Its third byte holds the flags `_is_full_map_msg` and
+        # `_is_spectator_only` look for; see _send_binary_map in tileweb.cc.
+        # Receivers that can't decode binary maps are skipped: they can only
+        # have joined since the game was asked to stop sending them, and the
+        # full JSON map sent on joining covers them.
+        data = base64.b64decode(msg[1:])
+        if data[0] == 2:
+            self.handle_shared_frame(data)
+            return
+        if self._fresh_watchers and data[2] & 1:
+            if data[2] & 2:
+                for w in self._fresh_watchers:
+                    w.append_binary(data)
+            else:
+                for receiver in self._receivers:
+                    if receiver.binary_maps:
+                        receiver.append_binary(data)
+            self._fresh_watchers = set()
+            return
+        for receiver in self._receivers:
+            if receiver.binary_maps:
+                receiver.append_binary(data)
+
+    def handle_shared_frame(self, data): # type: (bytes) -> None
+        # a frame compressed once by the crawl process, see _send_shared_frame
+        # in tileweb.cc. Its second byte holds the same flags as a binary map
+        # frame. Clients that can't take it as it is get the contents, which
+        # are only decompressed once for all of them.
+        if self._fresh_watchers and data[1] & 1:
+            if data[1] & 2:
+                receivers = self._fresh_watchers
+            else:
+                receivers = self._receivers
+            self._fresh_watchers = set()
+        else:
+            receivers = self._receivers
+
+        payload = None
+        for receiver in receivers:
+            if receiver.shared_frames and receiver.binary_maps:
+                receiver.append_shared(data)
+                continue
+            if payload is None:
+                inflater = zlib.decompressobj(-zlib.MAX_WBITS,
+                                              zdict=self._frame_dictionary)
+                payload = inflater.decompress(data[2:] + b"\x00\x00\xff\xff")
+            if payload[0] == 0:
+                # a binary map frame, as in handle_process_binary
+                if receiver.binary_maps:
+                    receiver.append_binary(payload)
+            elif receiver.shared_frames:
+                receiver.append_shared(data)
+            else:
+                receiver.append_message(to_unicode(payload),
+                                        not self.queue_messages)
+
     def send_to_all(self, msg, **data): # type: (str, Any) -> None
         for receiver in self._receivers:
             receiver.send_message(msg, **data)
@@ -763,6 +823,8 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
         self._process_hup_timeout = None
 
         self._fresh_watchers = set()
+        self._binary_maps = False
+        self._frame_dictionary = b""
 
     def start(self):
         self._purge_locks_and_start(True)
@@ -987,7 +1049,25 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
         self.conn.message_callback = self._on_socket_message
         self.conn.close_callback = self._on_socket_close
         self.conn.username = self.username
-        self.conn.connect(primary)
+        self._binary_maps = self._want_binary_maps()
+        self.conn.connect(primary, self._binary_maps,
+                          bool(config.get('shared_frames')))
+
+    def _want_binary_maps(self):
+        return bool(config.get('binary_map_frames') and self._receivers
+                    and all(r.binary_maps for r in self._receivers))
+
+    def _update_binary_maps(self):
+        # binary map frames are only used while every receiver can take them
+        if not self.conn or not self.conn.open:
+            return
+        wanted = self._want_binary_maps()
+        if wanted != self._binary_maps:
+            self._binary_maps = wanted
+            self.conn.send_message(json_encode({
+                        "msg": "binary_maps",
+                        "enabled": wanted
+                        }))
 
     def gen_inprogress_lock(self):
         self.inprogress_lock = os.path.join(self.config_path("inprogress_path"),
@@ -1059,9 +1139,22 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
         super(CrawlProcessHandler, self).add_watcher(watcher)
 
         if self.conn and self.conn.open:
+            # must precede spectator_joined, so that the full map is sent
+            # in a form the new watcher understands
+            self._update_binary_maps()
+            self._send_frame_dictionary(watcher)
             self._fresh_watchers.add(watcher)
             self.conn.send_message('{"msg":"spectator_joined"}')
 
+    def remove_watcher(self, watcher):
+        super(CrawlProcessHandler, self).remove_watcher(watcher)
+        self._update_binary_maps()
+
+    def _send_frame_dictionary(self, receiver):
+        if self._frame_dictionary and receiver.shared_frames:
+            receiver.send_message("frame_dictionary",
+                                  dictionary=to_unicode(self._frame_dictionary))
+
     def handle_input(self, msg): # type: (str) -> None
         obj = json_decode(msg)
 
@@ -1191,6 +1284,10 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
                     self.exit_message = msgobj["message"]
                 else:
                     self.exit_message = None
+            elif msgobj["msg"] == "frame_dictionary":
+                self._frame_dictionary = utf8(msgobj["dictionary"])
+                for receiver in self._receivers:
+                    self._send_frame_dictionary(receiver)
             elif msgobj["msg"] == "milestone":
                 # milestone/whereis update: milestone fields are right in the
                 # message
@@ -1209,7 +1306,10 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
                 # want that to reset idle time.
                 self.note_activity()
 
-            self.handle_process_message(msg, not self.queue_messages)
+            if msg.startswith("#"):
+                self.handle_process_binary(msg)
+            else:
+                self.handle_process_message(msg, not self.queue_messages)
 
 
 
@@ -315,6 +315,8 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
         self.failed_on_messages = 0 # messages from webtiles
 
         self.subprotocol = None
+        self.binary_maps = False
+        self.shared_frames = False
 
         self.chat_hidden = False
 
@@ -328,6 +330,7 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             "forget_login_cookie": self.forget_login_cookie,
             "play": self.start_crawl,
             "pong": self.pong,
+            "set_binary_maps": self.set_binary_maps,
             "watch": self.watch,
             "chat_msg": self.post_chat_message,
             "register": self.register,
@@ -404,6 +407,12 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             self.deflate = False
             self.subprotocol = "no-compression"
             return "no-compression"
+        if "shared-frames" in subprotocols and config.get('shared_frames'):
+            # compressed frames are prefixed with how they were compressed,
+            # so that the client can tell shared frames from its own stream
+            self.shared_frames = True
+            self.subprotocol = "shared-frames"
+            return "shared-frames"
         return None
 
     def open(self):
@@ -418,6 +427,10 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             if any(s.endswith("deflate-frame") for s in self.get_extensions()):
                 self.deflate = False
                 compression = "deflate-frame extension"
+        if not self.deflate:
+            self.shared_frames = False
+        elif self.shared_frames:
+            compression = "on, shared frames"
 
         self.logger.info("Socket opened from ip %s (fd%s, compression: %s).",
                          self.request.remote_ip,
@@ -1354,6 +1367,12 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
                                     exc_info=True)
             self.failed_on_messages += 1
 
+    def set_binary_maps(self):
+        # Old Websocket versions don't support binary messages
+        if not isinstance(self.ws_connection,
+                          getattr(tornado.websocket, "WebSocketProtocol76", ())):
+            self.binary_maps = True
+
     def _encode_for_send(self, msg, deflate):
         try:
             binmsg = utf8(msg)
@@ -1366,6 +1385,8 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
                 compressed = self._compressobj.compress(binmsg)
                 compressed += self._compressobj.flush(zlib.Z_SYNC_FLUSH)
                 compressed = compressed[:-4]
+                if self.shared_frames:
+                    compressed = b"\x01" + compressed
                 return MessageBundle(binmsg, compressed)
             else:
                 return MessageBundle(binmsg, None)
@@ -1377,23 +1398,27 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
 
 
     # send a single message batch, encoding and compressing it if necessary
-    def _send_raw_message(self, msg):
+    def _send_raw_message(self, msg, binary=False, shared=False):
         if self.client_closed or not msg:
             return False
 
-        bundle = self._encode_for_send(msg, self.deflate)
+        if shared:
+            # already compressed by the game
+            bundle = MessageBundle(msg, msg)
+        else:
+            bundle = self._encode_for_send(msg, self.deflate)
         if not bundle:
             self.failed_messages += 1
             return False
 
         try:
             self.total_message_bytes += len(bundle.binmsg)
-            if self.deflate:
+            if self.deflate or shared:
                 self.compressed_bytes_sent += len(bundle.compressed)
                 f = self.write_message(bundle.compressed, binary=True)
             else:
                 self.uncompressed_bytes_sent += len(bundle.binmsg)
-                f = self.write_message(bundle.binmsg)
+                f = self.write_message(bundle.binmsg, binary=binary)
 
             import traceback
             cur_stack = traceback.format_stack()
@@ -1474,6 +1499,23 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             return self.flush_messages()
         return False
 
+    def append_binary(self, data):
+        # type: (bytes) -> bool
+        """Sends a binary map frame, after anything already queued."""
+        if self.client_closed:
+            return False
+        self.flush_messages()
+        return self._send_raw_message(data, binary=True)
+
+    def append_shared(self, data):
+        # type: (bytes) -> bool
+        """Sends a frame compressed by the game, after anything already
+        queued."""
+        if self.client_closed:
+            return False
+        self.flush_messages()
+        return self._send_raw_message(data, shared=True)
+
     def send_message(self, msg, **data):
         # type: (str, Any) -> bool
         """Sends a JSON message to the client."""
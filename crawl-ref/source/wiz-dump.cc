@@ -157,9 +157,8 @@ static void _apply_randart_properties(item_def &item,
                                       const string &name,
                                       const string &props)
 {
-    CrawlVector &rap = item.props[ARTEFACT_PROPS_KEY].get_vector();
-    for (vec_size i = 0; i < ART_PROPERTIES; i++)
-        rap[i] = static_cast<short>(0);
+    item.artprops.init(0);
+    item.has_artprops = true;
 
     set_artefact_name(item, name);
 
@@ -192,26 +191,26 @@ static void _apply_randart_properties(item_def &item,
             for (short j = 1; j < 9; j++)
             {
                 item_def copy = item;
-                copy.props[ARTEFACT_PROPS_KEY].get_vector()[i] = j;
+                copy.artprops[i] = j;
                 string ins_with_prop = ins.length()
                     ? ins + " " + brand_name
                     : brand_name;
                 if (artefact_inscription(copy) == ins_with_prop)
                 {
-                    rap[i] = j;
+                    item.artprops[i] = j;
                     break;
                 }
             }
             for (short j = -1; j > -8; j--)
             {
                 item_def copy = item;
-                copy.props[ARTEFACT_PROPS_KEY].get_vector()[i] = j;
+                copy.artprops[i] = j;
                 string ins_with_prop = ins.length()
                     ? ins + " " + brand_name
                     : brand_name;
                 if (artefact_inscription(copy) == ins_with_prop)
                 {
-                    rap[i] = j;
+                    item.artprops[i] = j;
                     break;
                 }
             }
@@ -401,7 +401,7 @@ void wizard_tweak_object()
         int64_t new_val = strtoll(specs, &end, hex ? 16 : 0);
 
         if (keyin == 'e' && new_val & ISFLAG_ARTEFACT_MASK
-            && !you.inv[item].props.exists(ARTEFACT_PROPS_KEY))
+            && !you.inv[item].has_artprops)
         {
             mpr("You can't set this flag on a non-artefact.");
             continue;
@@ -593,6 +593,7 @@ void wizard_make_object_randart()
         item.unrand_idx = 0;
         item.flags  &= ~ISFLAG_RANDART;
         item.props.clear();
+        item.has_artprops = false;
     }
 
     mprf(MSGCH_PROMPT, "Fake item as gift from which god (ENTER to leave alone): ");
@@ -104,7 +104,12 @@ namespace worley
            But this wastes a lot of time working on cubes which are known to be
            too far away to matter! So we can use a more complex testing method
            that avoids this needless testing of distant cubes. This doubles the
-           speed of the algorithm. */
+           speed of the algorithm.
+
+           Nor does evaluating runs of nearby points together help: sharing
+           the feature points of their common cubes saves next to nothing,
+           since almost all of the time goes on the pruned merge below, which
+           each point still needs for itself to give the same answers. */
 
         /* Test the central cube for closest point(s). */
         AddSamples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);